@@ -11,6 +11,7 @@ LocalSyncOPCCLient::LocalSyncOPCCLient()
     p_host_ = nullptr;
     p_opc_server_ = nullptr;
     is_env_ready = false;
+    executor_ = nullptr;
 
 } // LocalSyncOPCCLient::LocalSyncOPCCLient
 
@@ -23,20 +24,38 @@ LocalSyncOPCCLient::~LocalSyncOPCCLient()
 
 bool LocalSyncOPCCLient::Init()
 {
-    COPCClient::init();
+    if (!executor_)
+    {
+        executor_ = new COPCExecutor();
+    }
     return true;
 
 } // LocalSyncOPCCLient::Init
 
 bool LocalSyncOPCCLient::Stop()
 {
-    COPCClient::stop();
+    if (executor_)
+    {
+        DisConnect();
+        delete executor_;
+        executor_ = nullptr;
+    } // if
     return true;
 
 } // LocalSyncOPCCLient::Stop
 
 bool LocalSyncOPCCLient::Connect(std::string serverName)
 {
+    if (!executor_)
+    {
+        return false;
+    }
+
+    if (!executor_->isExecutorThread())
+    {
+        return executor_->submit([this, serverName] { return Connect(serverName); }).get();
+    }
+
     // check if opc service runing
     if (!DetectService("OpcEnum"))
     {
@@ -85,7 +104,6 @@ bool LocalSyncOPCCLient::Connect(std::string serverName)
         return false;
     } // if
 
-    VariantInit(&read_tmp_variant_);
     return true;
 
 } // LocalSyncOPCCLient::Connect
@@ -121,6 +139,16 @@ bool LocalSyncOPCCLient::DisConnect()
 
 bool LocalSyncOPCCLient::IsOPCRuning()
 {
+    if (!executor_)
+    {
+        return false;
+    }
+
+    if (!executor_->isExecutorThread())
+    {
+        return executor_->submit([this] { return IsOPCRuning(); }).get();
+    }
+
     if (!p_opc_server_)
     {
         return false;
@@ -185,10 +213,22 @@ bool LocalSyncOPCCLient::ItemNameFilter(std::string item_name)
 
 } // LocalSyncOPCCLient::ItemNameFilter
 
+COPCItem *LocalSyncOPCCLient::FindItem(const std::string &item_name)
+{
+    // the map is only modified while connecting, lookups from several threads are safe
+    auto iter = name_item_map_.find(COPCHost::S2WS(item_name));
+    if (iter == name_item_map_.end())
+    {
+        throw OPCException(L"LocalSyncOPCCLient::FindItem: unknown item");
+    }
+    return iter->second;
+
+} // LocalSyncOPCCLient::FindItem
+
 bool LocalSyncOPCCLient::SyncReadItem(std::string item_name, VARIANT *var)
 {
-    static OPCItemData data; // pretty dangerous design..
-    name_item_map_[COPCHost::S2WS(item_name)]->readSync(data, OPC_DS_DEVICE);
+    // concurrent reads of the group are merged into one server call by the executor
+    OPCItemData data = executor_->read(FindItem(item_name), OPC_DS_DEVICE).get();
     VariantCopy(var, &data.vDataValue);
     return true;
 
@@ -196,20 +236,21 @@ bool LocalSyncOPCCLient::SyncReadItem(std::string item_name, VARIANT *var)
 
 bool LocalSyncOPCCLient::SyncWriteItem(std::string item_name, VARIANT *var)
 {
-    return name_item_map_[COPCHost::S2WS(item_name)]->writeSync(*var);
+    return executor_->write(FindItem(item_name), *var).get();
 
 } // LocalSyncOPCCLient::SyncWriteItem
 
 bool LocalSyncOPCCLient::ReadBool(std::string item_name)
 {
-    SyncReadItem(item_name, &read_tmp_variant_);
-    return read_tmp_variant_.boolVal;
+    CComVariant var;
+    SyncReadItem(item_name, &var);
+    return var.boolVal;
 
 } // LocalSyncOPCCLient::ReadBool
 
 bool LocalSyncOPCCLient::WriteBool(std::string item_name, bool item_value)
 {
-    static VARIANT var;
+    VARIANT var;
     var.vt = VT_BOOL;
     var.boolVal = item_value;
     return SyncWriteItem(item_name, &var);
@@ -218,14 +259,15 @@ bool LocalSyncOPCCLient::WriteBool(std::string item_name, bool item_value)
 
 float LocalSyncOPCCLient::ReadFloat(std::string item_name)
 {
-    SyncReadItem(item_name, &read_tmp_variant_);
-    return read_tmp_variant_.fltVal;
+    CComVariant var;
+    SyncReadItem(item_name, &var);
+    return var.fltVal;
 
 } // LocalSyncOPCCLient::ReadFloat
 
 bool LocalSyncOPCCLient::WriteFloat(std::string item_name, float item_value)
 {
-    static VARIANT var;
+    VARIANT var;
     var.vt = VT_R4;
     var.fltVal = item_value;
     return SyncWriteItem(item_name, &var);
@@ -234,14 +276,15 @@ bool LocalSyncOPCCLient::WriteFloat(std::string item_name, float item_value)
 
 uint16_t LocalSyncOPCCLient::ReadUint16(std::string item_name)
 {
-    SyncReadItem(item_name, &read_tmp_variant_);
-    return read_tmp_variant_.uiVal;
+    CComVariant var;
+    SyncReadItem(item_name, &var);
+    return var.uiVal;
 
 } // LocalSyncOPCCLient::ReadUint16
 
 bool LocalSyncOPCCLient::WriteUint16(std::string item_name, uint16_t item_value)
 {
-    static VARIANT var;
+    VARIANT var;
     var.vt = VT_UI2;
     var.uiVal = item_value;
     return SyncWriteItem(item_name, &var);
@@ -295,21 +338,33 @@ bool LocalSyncOPCCLient::WriteUint16Array(std::string item_name, uint16_t *item_
 
 bool LocalSyncOPCCLient::CleanOPCMember()
 {
-    if (IsOPCRuning()) // delete heap if connected
+    // the members live on the executor thread, without it there is nothing left to clean
+    if (!executor_)
     {
-        for (auto iter = name_item_map_.begin(); iter != name_item_map_.end(); ++iter)
-        {
-            delete iter->second;
-        }
+        return true;
+    }
 
-        name_item_map_.clear();
+    if (!executor_->isExecutorThread())
+    {
+        return executor_->submit([this] { return CleanOPCMember(); }).get();
+    }
 
+    if (IsOPCRuning()) // delete heap if connected
+    {
+        // the group removes all its items with one call, deleting them afterwards costs no round trip
         if (p_group_)
         {
             delete p_group_;
             p_group_ = nullptr;
         } // if
 
+        for (auto iter = name_item_map_.begin(); iter != name_item_map_.end(); ++iter)
+        {
+            delete iter->second;
+        }
+
+        name_item_map_.clear();
+
         if (p_host_)
         {
             delete p_host_;
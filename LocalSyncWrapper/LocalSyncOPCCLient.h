@@ -10,12 +10,14 @@
 #include <locale>
 
 #include "../OPCClientToolKit/OPCClient.h"
+#include "../OPCClientToolKit/OPCExecutor.h"
 #include "../OPCClientToolKit/OPCGroup.h"
 #include "../OPCClientToolKit/OPCHost.h"
 #include "../OPCClientToolKit/OPCItem.h"
 #include "../OPCClientToolKit/OPCServer.h"
 #include "../OPCClientToolKit/opcda.h"
 
+// all COM calls run on the client's executor thread, so one client may be shared by any threads
 class LocalSyncOPCCLient
 {
   public:
@@ -70,11 +72,12 @@ class LocalSyncOPCCLient
     COPCHost *p_host_;
     COPCServer *p_opc_server_;
     bool is_env_ready;
+    COPCExecutor *executor_;
 
     bool CleanOPCMember();
 
     bool DetectService(std::string ServiceName);
 
-    VARIANT read_tmp_variant_;
+    COPCItem *FindItem(const std::string &item_name);
 
 }; // LocalSyncOPCCLient
@@ -0,0 +1,762 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#include "FakeOPCServer.h"
+
+#include <algorithm>
+
+#include "opcerror.h"
+
+// what a call on a server whose process is gone returns
+static const HRESULT FAKE_DISCONNECTED = RPC_E_DISCONNECTED;
+
+template <typename T> static T *ComAlloc(DWORD count)
+{
+    T *memory = static_cast<T *>(CoTaskMemAlloc((std::max)(count, 1UL) * sizeof(T)));
+    if (memory)
+    {
+        memset(memory, 0, (std::max)(count, 1UL) * sizeof(T));
+    }
+    return memory;
+}
+
+static LPWSTR ComString(const std::wstring &text)
+{
+    LPWSTR copy = ComAlloc<WCHAR>(static_cast<DWORD>(text.size() + 1));
+    if (copy)
+    {
+        wcscpy_s(copy, text.size() + 1, text.c_str());
+    }
+    return copy;
+}
+
+CFakeServerState::CFakeServerState(const std::wstring &progID, LONG itemValue)
+    : ProgID(progID), running(true), value(itemValue), connects(0), liveGroups(0), liveItems(0)
+{
+} // CFakeServerState::CFakeServerState
+
+void CFakeServerState::attach(CFakeOPCServer *session)
+{
+    std::lock_guard<std::mutex> lock(Lock);
+    Sessions.push_back(session);
+
+} // CFakeServerState::attach
+
+void CFakeServerState::detach(CFakeOPCServer *session)
+{
+    std::lock_guard<std::mutex> lock(Lock);
+    Sessions.erase(std::remove(Sessions.begin(), Sessions.end(), session), Sessions.end());
+
+} // CFakeServerState::detach
+
+void CFakeServerState::shutdown(const std::wstring &reason)
+{
+    std::vector<ATL::CComPtr<IOPCShutdown>> sinks;
+    {
+        std::lock_guard<std::mutex> lock(Lock);
+        for (auto session : Sessions)
+        {
+            session->shutdownSinks(sinks);
+        }
+    }
+    // outside the lock, a client may close the session from within the callback
+    for (auto &sink : sinks)
+    {
+        sink->ShutdownRequest(reason.c_str());
+    }
+
+} // CFakeServerState::shutdown
+
+CFakeOPCGroup::CFakeOPCGroup() : NextItem(0), ClientGroup(0), ServerGroup(0), UpdateRate(0), Active(FALSE)
+{
+} // CFakeOPCGroup::CFakeOPCGroup
+
+void CFakeOPCGroup::init(const std::shared_ptr<CFakeServerState> &state, const std::wstring &name, BOOL active,
+                         DWORD updateRate, OPCHANDLE clientGroup, OPCHANDLE serverGroup)
+{
+    State = state;
+    Name = name;
+    Active = active;
+    UpdateRate = updateRate;
+    ClientGroup = clientGroup;
+    ServerGroup = serverGroup;
+    ++State->liveGroups;
+
+} // CFakeOPCGroup::init
+
+void CFakeOPCGroup::FinalRelease()
+{
+    if (State)
+    {
+        State->liveItems -= static_cast<int>(Items.size());
+        --State->liveGroups;
+    }
+
+} // CFakeOPCGroup::FinalRelease
+
+STDMETHODIMP CFakeOPCGroup::GetState(DWORD *pUpdateRate, BOOL *pActive, LPWSTR *ppName, LONG *pTimeBias,
+                                     FLOAT *pPercentDeadband, DWORD *pLCID, OPCHANDLE *phClientGroup,
+                                     OPCHANDLE *phServerGroup)
+{
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    if (pUpdateRate)
+    {
+        *pUpdateRate = UpdateRate;
+    }
+    if (pActive)
+    {
+        *pActive = Active;
+    }
+    if (ppName)
+    {
+        *ppName = ComString(Name);
+    }
+    if (pTimeBias)
+    {
+        *pTimeBias = 0;
+    }
+    if (pPercentDeadband)
+    {
+        *pPercentDeadband = 0;
+    }
+    if (pLCID)
+    {
+        *pLCID = 0;
+    }
+    if (phClientGroup)
+    {
+        *phClientGroup = ClientGroup;
+    }
+    if (phServerGroup)
+    {
+        *phServerGroup = ServerGroup;
+    }
+    return S_OK;
+
+} // CFakeOPCGroup::GetState
+
+STDMETHODIMP CFakeOPCGroup::SetState(DWORD *pRequestedUpdateRate, DWORD *pRevisedUpdateRate, BOOL *pActive,
+                                     LONG *pTimeBias, FLOAT *pPercentDeadband, DWORD *pLCID,
+                                     OPCHANDLE *phClientGroup)
+{
+    (void)pTimeBias;
+    (void)pPercentDeadband;
+    (void)pLCID;
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    if (pRequestedUpdateRate)
+    {
+        UpdateRate = *pRequestedUpdateRate;
+    }
+    if (pRevisedUpdateRate)
+    {
+        *pRevisedUpdateRate = UpdateRate;
+    }
+    if (pActive)
+    {
+        Active = *pActive;
+    }
+    if (phClientGroup)
+    {
+        ClientGroup = *phClientGroup;
+    }
+    return S_OK;
+
+} // CFakeOPCGroup::SetState
+
+STDMETHODIMP CFakeOPCGroup::SetName(LPCWSTR szName)
+{
+    Name = szName ? szName : L"";
+    return S_OK;
+
+} // CFakeOPCGroup::SetName
+
+STDMETHODIMP CFakeOPCGroup::CloneGroup(LPCWSTR szName, REFIID riid, LPUNKNOWN *ppUnk)
+{
+    (void)szName;
+    (void)riid;
+    (void)ppUnk;
+    return E_NOTIMPL;
+
+} // CFakeOPCGroup::CloneGroup
+
+STDMETHODIMP CFakeOPCGroup::Read(OPCDATASOURCE dwSource, DWORD dwCount, OPCHANDLE *phServer,
+                                 OPCITEMSTATE **ppItemValues, HRESULT **ppErrors)
+{
+    (void)dwSource;
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    OPCITEMSTATE *states = ComAlloc<OPCITEMSTATE>(dwCount);
+    HRESULT *errors = ComAlloc<HRESULT>(dwCount);
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    HRESULT result = S_OK;
+    std::lock_guard<std::mutex> lock(ItemsLock);
+    for (DWORD i = 0; i < dwCount; ++i)
+    {
+        const auto item = Items.find(phServer[i]);
+        VariantInit(&states[i].vDataValue);
+        if (item == Items.end())
+        {
+            errors[i] = OPC_E_INVALIDHANDLE;
+            result = S_FALSE;
+            continue;
+        }
+        states[i].hClient = item->second.client;
+        states[i].ftTimeStamp = now;
+        states[i].wQuality = OPC_QUALITY_GOOD;
+        states[i].vDataValue.vt = VT_I4;
+        states[i].vDataValue.lVal = State->value;
+        errors[i] = S_OK;
+    }
+    *ppItemValues = states;
+    *ppErrors = errors;
+    return result;
+
+} // CFakeOPCGroup::Read
+
+STDMETHODIMP CFakeOPCGroup::Write(DWORD dwCount, OPCHANDLE *phServer, VARIANT *pItemValues, HRESULT **ppErrors)
+{
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    HRESULT *errors = ComAlloc<HRESULT>(dwCount);
+    HRESULT result = S_OK;
+    std::lock_guard<std::mutex> lock(ItemsLock);
+    for (DWORD i = 0; i < dwCount; ++i)
+    {
+        ATL::CComVariant value;
+        if (Items.find(phServer[i]) == Items.end())
+        {
+            errors[i] = OPC_E_INVALIDHANDLE;
+        }
+        else if (FAILED(value.ChangeType(VT_I4, &pItemValues[i])))
+        {
+            errors[i] = OPC_E_BADTYPE;
+        }
+        else
+        {
+            State->value = value.lVal;
+            errors[i] = S_OK;
+        }
+        if (FAILED(errors[i]))
+        {
+            result = S_FALSE;
+        }
+    }
+    *ppErrors = errors;
+    return result;
+
+} // CFakeOPCGroup::Write
+
+STDMETHODIMP CFakeOPCGroup::Read(DWORD dwCount, OPCHANDLE *phServer, DWORD dwTransactionID, DWORD *pdwCancelID,
+                                 HRESULT **ppErrors)
+{
+    (void)dwCount;
+    (void)phServer;
+    (void)dwTransactionID;
+    (void)pdwCancelID;
+    (void)ppErrors;
+    return E_NOTIMPL;
+
+} // CFakeOPCGroup::Read
+
+STDMETHODIMP CFakeOPCGroup::Write(DWORD dwCount, OPCHANDLE *phServer, VARIANT *pItemValues, DWORD dwTransactionID,
+                                  DWORD *pdwCancelID, HRESULT **ppErrors)
+{
+    (void)dwCount;
+    (void)phServer;
+    (void)pItemValues;
+    (void)dwTransactionID;
+    (void)pdwCancelID;
+    (void)ppErrors;
+    return E_NOTIMPL;
+
+} // CFakeOPCGroup::Write
+
+STDMETHODIMP CFakeOPCGroup::Refresh2(OPCDATASOURCE dwSource, DWORD dwTransactionID, DWORD *pdwCancelID)
+{
+    (void)dwSource;
+    (void)dwTransactionID;
+    (void)pdwCancelID;
+    return E_NOTIMPL;
+
+} // CFakeOPCGroup::Refresh2
+
+STDMETHODIMP CFakeOPCGroup::Cancel2(DWORD dwCancelID)
+{
+    (void)dwCancelID;
+    return E_NOTIMPL;
+
+} // CFakeOPCGroup::Cancel2
+
+STDMETHODIMP CFakeOPCGroup::SetEnable(BOOL bEnable)
+{
+    (void)bEnable;
+    return S_OK;
+
+} // CFakeOPCGroup::SetEnable
+
+STDMETHODIMP CFakeOPCGroup::GetEnable(BOOL *pbEnable)
+{
+    *pbEnable = TRUE;
+    return S_OK;
+
+} // CFakeOPCGroup::GetEnable
+
+HRESULT CFakeOPCGroup::checkItems(DWORD count, OPCITEMDEF *itemArray, bool add, OPCITEMRESULT **results,
+                                  HRESULT **errors)
+{
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    OPCITEMRESULT *itemResults = ComAlloc<OPCITEMRESULT>(count);
+    HRESULT *itemErrors = ComAlloc<HRESULT>(count);
+    HRESULT result = S_OK;
+    std::lock_guard<std::mutex> lock(ItemsLock);
+    for (DWORD i = 0; i < count; ++i)
+    {
+        // every non-empty id names an item of the namespace
+        if (!itemArray[i].szItemID || !*itemArray[i].szItemID)
+        {
+            itemErrors[i] = OPC_E_INVALIDITEMID;
+            result = S_FALSE;
+            continue;
+        }
+        itemResults[i].vtCanonicalDataType = VT_I4;
+        itemResults[i].dwAccessRights = OPC_READABLE | OPC_WRITEABLE;
+        if (add)
+        {
+            itemResults[i].hServer = ++NextItem;
+            Items[NextItem] = FakeItem{itemArray[i].szItemID, itemArray[i].hClient, itemArray[i].bActive};
+            ++State->liveItems;
+        }
+        itemErrors[i] = S_OK;
+    }
+    *results = itemResults;
+    *errors = itemErrors;
+    return result;
+
+} // CFakeOPCGroup::checkItems
+
+STDMETHODIMP CFakeOPCGroup::AddItems(DWORD dwCount, OPCITEMDEF *pItemArray, OPCITEMRESULT **ppAddResults,
+                                     HRESULT **ppErrors)
+{
+    return checkItems(dwCount, pItemArray, true, ppAddResults, ppErrors);
+
+} // CFakeOPCGroup::AddItems
+
+STDMETHODIMP CFakeOPCGroup::ValidateItems(DWORD dwCount, OPCITEMDEF *pItemArray, BOOL bBlobUpdate,
+                                          OPCITEMRESULT **ppValidationResults, HRESULT **ppErrors)
+{
+    (void)bBlobUpdate;
+    return checkItems(dwCount, pItemArray, false, ppValidationResults, ppErrors);
+
+} // CFakeOPCGroup::ValidateItems
+
+STDMETHODIMP CFakeOPCGroup::RemoveItems(DWORD dwCount, OPCHANDLE *phServer, HRESULT **ppErrors)
+{
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    HRESULT *errors = ComAlloc<HRESULT>(dwCount);
+    HRESULT result = S_OK;
+    std::lock_guard<std::mutex> lock(ItemsLock);
+    for (DWORD i = 0; i < dwCount; ++i)
+    {
+        if (Items.erase(phServer[i]) == 0)
+        {
+            errors[i] = OPC_E_INVALIDHANDLE;
+            result = S_FALSE;
+            continue;
+        }
+        --State->liveItems;
+        errors[i] = S_OK;
+    }
+    *ppErrors = errors;
+    return result;
+
+} // CFakeOPCGroup::RemoveItems
+
+STDMETHODIMP CFakeOPCGroup::SetActiveState(DWORD dwCount, OPCHANDLE *phServer, BOOL bActive, HRESULT **ppErrors)
+{
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    HRESULT *errors = ComAlloc<HRESULT>(dwCount);
+    HRESULT result = S_OK;
+    std::lock_guard<std::mutex> lock(ItemsLock);
+    for (DWORD i = 0; i < dwCount; ++i)
+    {
+        const auto item = Items.find(phServer[i]);
+        if (item == Items.end())
+        {
+            errors[i] = OPC_E_INVALIDHANDLE;
+            result = S_FALSE;
+            continue;
+        }
+        item->second.active = bActive;
+        errors[i] = S_OK;
+    }
+    *ppErrors = errors;
+    return result;
+
+} // CFakeOPCGroup::SetActiveState
+
+STDMETHODIMP CFakeOPCGroup::SetClientHandles(DWORD dwCount, OPCHANDLE *phServer, OPCHANDLE *phClient,
+                                             HRESULT **ppErrors)
+{
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    HRESULT *errors = ComAlloc<HRESULT>(dwCount);
+    HRESULT result = S_OK;
+    std::lock_guard<std::mutex> lock(ItemsLock);
+    for (DWORD i = 0; i < dwCount; ++i)
+    {
+        const auto item = Items.find(phServer[i]);
+        if (item == Items.end())
+        {
+            errors[i] = OPC_E_INVALIDHANDLE;
+            result = S_FALSE;
+            continue;
+        }
+        item->second.client = phClient[i];
+        errors[i] = S_OK;
+    }
+    *ppErrors = errors;
+    return result;
+
+} // CFakeOPCGroup::SetClientHandles
+
+STDMETHODIMP CFakeOPCGroup::SetDatatypes(DWORD dwCount, OPCHANDLE *phServer, VARTYPE *pRequestedDatatypes,
+                                         HRESULT **ppErrors)
+{
+    (void)phServer;
+    (void)pRequestedDatatypes;
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    *ppErrors = ComAlloc<HRESULT>(dwCount);
+    return S_OK;
+
+} // CFakeOPCGroup::SetDatatypes
+
+STDMETHODIMP CFakeOPCGroup::CreateEnumerator(REFIID riid, LPUNKNOWN *ppUnk)
+{
+    (void)riid;
+    (void)ppUnk;
+    return E_NOTIMPL;
+
+} // CFakeOPCGroup::CreateEnumerator
+
+CFakeOPCServer::CFakeOPCServer() : NextGroup(0)
+{
+} // CFakeOPCServer::CFakeOPCServer
+
+void CFakeOPCServer::init(const std::shared_ptr<CFakeServerState> &state)
+{
+    State = state;
+    State->attach(this);
+
+} // CFakeOPCServer::init
+
+void CFakeOPCServer::FinalRelease()
+{
+    if (State)
+    {
+        State->detach(this);
+    }
+    std::lock_guard<std::mutex> lock(GroupsLock);
+    Groups.clear();
+
+} // CFakeOPCServer::FinalRelease
+
+void CFakeOPCServer::shutdownSinks(std::vector<ATL::CComPtr<IOPCShutdown>> &sinks)
+{
+    Lock();
+    for (int i = 0; i < m_vec.GetSize(); ++i)
+    {
+        // the connection point keeps the interface it asked the sink for
+        IUnknown *sink = m_vec.GetAt(i);
+        if (sink)
+        {
+            sinks.push_back(reinterpret_cast<IOPCShutdown *>(sink));
+        }
+    }
+    Unlock();
+
+} // CFakeOPCServer::shutdownSinks
+
+STDMETHODIMP CFakeOPCServer::AddGroup(LPCWSTR szName, BOOL bActive, DWORD dwRequestedUpdateRate,
+                                      OPCHANDLE hClientGroup, LONG *pTimeBias, FLOAT *pPercentDeadband, DWORD dwLCID,
+                                      OPCHANDLE *phServerGroup, DWORD *pRevisedUpdateRate, REFIID riid,
+                                      LPUNKNOWN *ppUnk)
+{
+    (void)pTimeBias;
+    (void)pPercentDeadband;
+    (void)dwLCID;
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    ATL::CComObject<CFakeOPCGroup> *group = nullptr;
+    HRESULT result = ATL::CComObject<CFakeOPCGroup>::CreateInstance(&group);
+    if (FAILED(result))
+    {
+        return result;
+    }
+    ATL::CComPtr<IUnknown> unknown(group->GetUnknown());
+    std::lock_guard<std::mutex> lock(GroupsLock);
+    const OPCHANDLE handle = ++NextGroup;
+    group->init(State, szName ? szName : L"", bActive, dwRequestedUpdateRate, hClientGroup, handle);
+    result = unknown->QueryInterface(riid, reinterpret_cast<void **>(ppUnk));
+    if (FAILED(result))
+    {
+        return result;
+    }
+    Groups[handle] = unknown;
+    *phServerGroup = handle;
+    *pRevisedUpdateRate = dwRequestedUpdateRate;
+    return S_OK;
+
+} // CFakeOPCServer::AddGroup
+
+STDMETHODIMP CFakeOPCServer::GetErrorString(HRESULT dwError, LCID dwLocale, LPWSTR *ppString)
+{
+    (void)dwLocale;
+    wchar_t text[32];
+    swprintf_s(text, L"fake error 0x%08X", static_cast<unsigned>(dwError));
+    *ppString = ComString(text);
+    return S_OK;
+
+} // CFakeOPCServer::GetErrorString
+
+STDMETHODIMP CFakeOPCServer::GetGroupByName(LPCWSTR szName, REFIID riid, LPUNKNOWN *ppUnk)
+{
+    (void)szName;
+    (void)riid;
+    (void)ppUnk;
+    return E_NOTIMPL;
+
+} // CFakeOPCServer::GetGroupByName
+
+STDMETHODIMP CFakeOPCServer::GetStatus(OPCSERVERSTATUS **ppServerStatus)
+{
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    OPCSERVERSTATUS *status = ComAlloc<OPCSERVERSTATUS>(1);
+    GetSystemTimeAsFileTime(&status->ftCurrentTime);
+    status->ftStartTime = status->ftCurrentTime;
+    status->ftLastUpdateTime = status->ftCurrentTime;
+    status->dwServerState = OPC_STATUS_RUNNING;
+    status->dwGroupCount = static_cast<DWORD>(State->liveGroups.load());
+    status->wMajorVersion = 2;
+    status->szVendorInfo = ComString(State->ProgID);
+    *ppServerStatus = status;
+    return S_OK;
+
+} // CFakeOPCServer::GetStatus
+
+STDMETHODIMP CFakeOPCServer::RemoveGroup(OPCHANDLE hServerGroup, BOOL bForce)
+{
+    (void)bForce;
+    if (!State->running)
+    {
+        return FAKE_DISCONNECTED;
+    }
+    ATL::CComPtr<IUnknown> group;
+    {
+        std::lock_guard<std::mutex> lock(GroupsLock);
+        const auto found = Groups.find(hServerGroup);
+        if (found == Groups.end())
+        {
+            return E_INVALIDARG;
+        }
+        group = found->second;
+        Groups.erase(found);
+    }
+    // released outside the lock, the client may still hold the group
+    group.Release();
+    return S_OK;
+
+} // CFakeOPCServer::RemoveGroup
+
+STDMETHODIMP CFakeOPCServer::CreateGroupEnumerator(OPCENUMSCOPE dwScope, REFIID riid, LPUNKNOWN *ppUnk)
+{
+    (void)dwScope;
+    (void)riid;
+    (void)ppUnk;
+    return E_NOTIMPL;
+
+} // CFakeOPCServer::CreateGroupEnumerator
+
+STDMETHODIMP CFakeOPCServer::QueryOrganization(OPCNAMESPACETYPE *pNameSpaceType)
+{
+    *pNameSpaceType = OPC_NS_FLAT;
+    return S_OK;
+
+} // CFakeOPCServer::QueryOrganization
+
+STDMETHODIMP CFakeOPCServer::ChangeBrowsePosition(OPCBROWSEDIRECTION dwBrowseDirection, LPCWSTR szString)
+{
+    (void)dwBrowseDirection;
+    (void)szString;
+    return E_NOTIMPL;
+
+} // CFakeOPCServer::ChangeBrowsePosition
+
+STDMETHODIMP CFakeOPCServer::BrowseOPCItemIDs(OPCBROWSETYPE dwBrowseFilterType, LPCWSTR szFilterCriteria,
+                                              VARTYPE vtDataTypeFilter, DWORD dwAccessRightsFilter,
+                                              LPENUMSTRING *ppIEnumString)
+{
+    (void)dwBrowseFilterType;
+    (void)szFilterCriteria;
+    (void)vtDataTypeFilter;
+    (void)dwAccessRightsFilter;
+    (void)ppIEnumString;
+    return E_NOTIMPL;
+
+} // CFakeOPCServer::BrowseOPCItemIDs
+
+STDMETHODIMP CFakeOPCServer::GetItemID(LPWSTR szItemDataID, LPWSTR *szItemID)
+{
+    *szItemID = ComString(szItemDataID ? szItemDataID : L"");
+    return S_OK;
+
+} // CFakeOPCServer::GetItemID
+
+STDMETHODIMP CFakeOPCServer::BrowseAccessPaths(LPCWSTR szItemID, LPENUMSTRING *ppIEnumString)
+{
+    (void)szItemID;
+    (void)ppIEnumString;
+    return E_NOTIMPL;
+
+} // CFakeOPCServer::BrowseAccessPaths
+
+STDMETHODIMP CFakeOPCServer::QueryAvailableProperties(LPWSTR szItemID, DWORD *pdwCount, DWORD **ppPropertyIDs,
+                                                      LPWSTR **ppDescriptions, VARTYPE **ppvtDataTypes)
+{
+    (void)szItemID;
+    (void)pdwCount;
+    (void)ppPropertyIDs;
+    (void)ppDescriptions;
+    (void)ppvtDataTypes;
+    return E_NOTIMPL;
+
+} // CFakeOPCServer::QueryAvailableProperties
+
+STDMETHODIMP CFakeOPCServer::GetItemProperties(LPWSTR szItemID, DWORD dwCount, DWORD *pdwPropertyIDs,
+                                               VARIANT **ppvData, HRESULT **ppErrors)
+{
+    (void)szItemID;
+    (void)dwCount;
+    (void)pdwPropertyIDs;
+    (void)ppvData;
+    (void)ppErrors;
+    return E_NOTIMPL;
+
+} // CFakeOPCServer::GetItemProperties
+
+STDMETHODIMP CFakeOPCServer::LookupItemIDs(LPWSTR szItemID, DWORD dwCount, DWORD *pdwPropertyIDs,
+                                           LPWSTR **ppszNewItemIDs, HRESULT **ppErrors)
+{
+    (void)szItemID;
+    (void)dwCount;
+    (void)pdwPropertyIDs;
+    (void)ppszNewItemIDs;
+    (void)ppErrors;
+    return E_NOTIMPL;
+
+} // CFakeOPCServer::LookupItemIDs
+
+CFakeHost::CFakeHost(const std::vector<std::shared_ptr<CFakeServerState>> &servers) : Servers(servers)
+{
+} // CFakeHost::CFakeHost
+
+void CFakeHost::getListOfDAServers(CATID cid, std::vector<std::wstring> &listOfProgIDs,
+                                   std::vector<CLSID> &listOfClassIDs)
+{
+    (void)cid;
+    for (auto &server : Servers)
+    {
+        listOfProgIDs.push_back(server->ProgID);
+        listOfClassIDs.push_back(CLSID_NULL);
+    }
+
+} // CFakeHost::getListOfDAServers
+
+CLSID CFakeHost::getCLSID(const std::wstring &serverProgID)
+{
+    (void)serverProgID;
+    throw OPCException(L"CFakeHost::getCLSID: fake servers have no class id");
+
+} // CFakeHost::getCLSID
+
+COPCServer *CFakeHost::connectDAServer(const std::wstring &serverProgID)
+{
+    for (auto &server : Servers)
+    {
+        if (server->ProgID != serverProgID)
+        {
+            continue;
+        }
+        if (!server->running)
+        {
+            throw OPCException(L"CFakeHost::connectDAServer: server is not running");
+        }
+        ATL::CComObject<CFakeOPCServer> *session = nullptr;
+        HRESULT result = ATL::CComObject<CFakeOPCServer>::CreateInstance(&session);
+        if (FAILED(result))
+        {
+            throw OPCException(L"CFakeHost::connectDAServer: FAILED to create the server", result);
+        }
+        ATL::CComPtr<IUnknown> unknown(session->GetUnknown());
+        session->init(server);
+        ATL::CComPtr<IOPCServer> iServer;
+        unknown->QueryInterface(IID_IOPCServer, reinterpret_cast<void **>(&iServer));
+        ++server->connects;
+        return new COPCServer(iServer);
+    }
+    throw OPCException(L"CFakeHost::connectDAServer: unknown server");
+
+} // CFakeHost::connectDAServer
+
+COPCServer *CFakeHost::connectDAServer(const CLSID &clsid)
+{
+    (void)clsid;
+    throw OPCException(L"CFakeHost::connectDAServer: fake servers have no class id");
+
+} // CFakeHost::connectDAServer
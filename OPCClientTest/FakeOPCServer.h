@@ -0,0 +1,250 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#pragma once
+
+#include <atlbase.h>
+#include <atlcom.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "OPCHost.h"
+#include "OPCServer.h"
+#include "opccomn.h"
+#include "opcda.h"
+
+class CFakeOPCServer;
+
+/**
+ * One in-process OPC DA server, shared by all sessions connected to it. Every item of its namespace exists and
+ * reads as value, while running is false every call fails like a lost connection.
+ */
+class CFakeServerState
+{
+  private:
+    std::mutex Lock;
+    std::vector<CFakeOPCServer *> Sessions;
+
+  public:
+    const std::wstring ProgID;
+    std::atomic<bool> running;
+    std::atomic<LONG> value;
+    // sessions opened, groups and items that were added and not removed yet
+    std::atomic<int> connects;
+    std::atomic<int> liveGroups;
+    std::atomic<int> liveItems;
+
+    CFakeServerState(const std::wstring &progID, LONG itemValue);
+
+    void attach(CFakeOPCServer *session);
+    void detach(CFakeOPCServer *session);
+
+    /**
+     * send IOPCShutdown::ShutdownRequest to every advised client, on the caller's thread
+     */
+    void shutdown(const std::wstring &reason);
+
+}; // CFakeServerState
+
+/**
+ * group of a fake server: item management, synchronous I/O and the data callback connection point
+ */
+class ATL_NO_VTABLE CFakeOPCGroup : public ATL::CComObjectRootEx<ATL::CComMultiThreadModel>,
+                                    public IOPCGroupStateMgt,
+                                    public IOPCSyncIO,
+                                    public IOPCAsyncIO2,
+                                    public IOPCItemMgt,
+                                    public ATL::IConnectionPointContainerImpl<CFakeOPCGroup>,
+                                    public ATL::IConnectionPointImpl<CFakeOPCGroup, &IID_IOPCDataCallback>
+{
+  private:
+    struct FakeItem
+    {
+        std::wstring name;
+        OPCHANDLE client;
+        BOOL active;
+    };
+
+    std::shared_ptr<CFakeServerState> State;
+    std::mutex ItemsLock;
+    std::map<OPCHANDLE, FakeItem> Items;
+    OPCHANDLE NextItem;
+    std::wstring Name;
+    OPCHANDLE ClientGroup;
+    OPCHANDLE ServerGroup;
+    DWORD UpdateRate;
+    BOOL Active;
+
+    HRESULT checkItems(DWORD count, OPCITEMDEF *itemArray, bool add, OPCITEMRESULT **results, HRESULT **errors);
+
+  public:
+    BEGIN_COM_MAP(CFakeOPCGroup)
+    COM_INTERFACE_ENTRY_IID(IID_IOPCGroupStateMgt, IOPCGroupStateMgt)
+    COM_INTERFACE_ENTRY_IID(IID_IOPCSyncIO, IOPCSyncIO)
+    COM_INTERFACE_ENTRY_IID(IID_IOPCAsyncIO2, IOPCAsyncIO2)
+    COM_INTERFACE_ENTRY_IID(IID_IOPCItemMgt, IOPCItemMgt)
+    COM_INTERFACE_ENTRY(IConnectionPointContainer)
+    END_COM_MAP()
+
+    BEGIN_CONNECTION_POINT_MAP(CFakeOPCGroup)
+    CONNECTION_POINT_ENTRY(IID_IOPCDataCallback)
+    END_CONNECTION_POINT_MAP()
+
+    CFakeOPCGroup();
+
+    void init(const std::shared_ptr<CFakeServerState> &state, const std::wstring &name, BOOL active,
+              DWORD updateRate, OPCHANDLE clientGroup, OPCHANDLE serverGroup);
+
+    void FinalRelease();
+
+    // IOPCGroupStateMgt
+    STDMETHODIMP GetState(DWORD *pUpdateRate, BOOL *pActive, LPWSTR *ppName, LONG *pTimeBias,
+                          FLOAT *pPercentDeadband, DWORD *pLCID, OPCHANDLE *phClientGroup,
+                          OPCHANDLE *phServerGroup);
+    STDMETHODIMP SetState(DWORD *pRequestedUpdateRate, DWORD *pRevisedUpdateRate, BOOL *pActive, LONG *pTimeBias,
+                          FLOAT *pPercentDeadband, DWORD *pLCID, OPCHANDLE *phClientGroup);
+    STDMETHODIMP SetName(LPCWSTR szName);
+    STDMETHODIMP CloneGroup(LPCWSTR szName, REFIID riid, LPUNKNOWN *ppUnk);
+
+    // IOPCSyncIO
+    STDMETHODIMP Read(OPCDATASOURCE dwSource, DWORD dwCount, OPCHANDLE *phServer, OPCITEMSTATE **ppItemValues,
+                      HRESULT **ppErrors);
+    STDMETHODIMP Write(DWORD dwCount, OPCHANDLE *phServer, VARIANT *pItemValues, HRESULT **ppErrors);
+
+    // IOPCAsyncIO2, not served
+    STDMETHODIMP Read(DWORD dwCount, OPCHANDLE *phServer, DWORD dwTransactionID, DWORD *pdwCancelID,
+                      HRESULT **ppErrors);
+    STDMETHODIMP Write(DWORD dwCount, OPCHANDLE *phServer, VARIANT *pItemValues, DWORD dwTransactionID,
+                       DWORD *pdwCancelID, HRESULT **ppErrors);
+    STDMETHODIMP Refresh2(OPCDATASOURCE dwSource, DWORD dwTransactionID, DWORD *pdwCancelID);
+    STDMETHODIMP Cancel2(DWORD dwCancelID);
+    STDMETHODIMP SetEnable(BOOL bEnable);
+    STDMETHODIMP GetEnable(BOOL *pbEnable);
+
+    // IOPCItemMgt
+    STDMETHODIMP AddItems(DWORD dwCount, OPCITEMDEF *pItemArray, OPCITEMRESULT **ppAddResults, HRESULT **ppErrors);
+    STDMETHODIMP ValidateItems(DWORD dwCount, OPCITEMDEF *pItemArray, BOOL bBlobUpdate,
+                               OPCITEMRESULT **ppValidationResults, HRESULT **ppErrors);
+    STDMETHODIMP RemoveItems(DWORD dwCount, OPCHANDLE *phServer, HRESULT **ppErrors);
+    STDMETHODIMP SetActiveState(DWORD dwCount, OPCHANDLE *phServer, BOOL bActive, HRESULT **ppErrors);
+    STDMETHODIMP SetClientHandles(DWORD dwCount, OPCHANDLE *phServer, OPCHANDLE *phClient, HRESULT **ppErrors);
+    STDMETHODIMP SetDatatypes(DWORD dwCount, OPCHANDLE *phServer, VARTYPE *pRequestedDatatypes, HRESULT **ppErrors);
+    STDMETHODIMP CreateEnumerator(REFIID riid, LPUNKNOWN *ppUnk);
+
+}; // CFakeOPCGroup
+
+/**
+ * one session of a fake server: groups, status and the shutdown connection point. Browsing and properties are not
+ * served
+ */
+class ATL_NO_VTABLE CFakeOPCServer : public ATL::CComObjectRootEx<ATL::CComMultiThreadModel>,
+                                     public IOPCServer,
+                                     public IOPCBrowseServerAddressSpace,
+                                     public IOPCItemProperties,
+                                     public ATL::IConnectionPointContainerImpl<CFakeOPCServer>,
+                                     public ATL::IConnectionPointImpl<CFakeOPCServer, &IID_IOPCShutdown>
+{
+  private:
+    std::shared_ptr<CFakeServerState> State;
+    std::mutex GroupsLock;
+    std::map<OPCHANDLE, ATL::CComPtr<IUnknown>> Groups;
+    OPCHANDLE NextGroup;
+
+  public:
+    BEGIN_COM_MAP(CFakeOPCServer)
+    COM_INTERFACE_ENTRY_IID(IID_IOPCServer, IOPCServer)
+    COM_INTERFACE_ENTRY_IID(IID_IOPCBrowseServerAddressSpace, IOPCBrowseServerAddressSpace)
+    COM_INTERFACE_ENTRY_IID(IID_IOPCItemProperties, IOPCItemProperties)
+    COM_INTERFACE_ENTRY(IConnectionPointContainer)
+    END_COM_MAP()
+
+    BEGIN_CONNECTION_POINT_MAP(CFakeOPCServer)
+    CONNECTION_POINT_ENTRY(IID_IOPCShutdown)
+    END_CONNECTION_POINT_MAP()
+
+    CFakeOPCServer();
+
+    void init(const std::shared_ptr<CFakeServerState> &state);
+
+    void FinalRelease();
+
+    /**
+     * the IOPCShutdown sinks advised on this session
+     */
+    void shutdownSinks(std::vector<ATL::CComPtr<IOPCShutdown>> &sinks);
+
+    // IOPCServer
+    STDMETHODIMP AddGroup(LPCWSTR szName, BOOL bActive, DWORD dwRequestedUpdateRate, OPCHANDLE hClientGroup,
+                          LONG *pTimeBias, FLOAT *pPercentDeadband, DWORD dwLCID, OPCHANDLE *phServerGroup,
+                          DWORD *pRevisedUpdateRate, REFIID riid, LPUNKNOWN *ppUnk);
+    STDMETHODIMP GetErrorString(HRESULT dwError, LCID dwLocale, LPWSTR *ppString);
+    STDMETHODIMP GetGroupByName(LPCWSTR szName, REFIID riid, LPUNKNOWN *ppUnk);
+    STDMETHODIMP GetStatus(OPCSERVERSTATUS **ppServerStatus);
+    STDMETHODIMP RemoveGroup(OPCHANDLE hServerGroup, BOOL bForce);
+    STDMETHODIMP CreateGroupEnumerator(OPCENUMSCOPE dwScope, REFIID riid, LPUNKNOWN *ppUnk);
+
+    // IOPCBrowseServerAddressSpace, a flat namespace that cannot be browsed
+    STDMETHODIMP QueryOrganization(OPCNAMESPACETYPE *pNameSpaceType);
+    STDMETHODIMP ChangeBrowsePosition(OPCBROWSEDIRECTION dwBrowseDirection, LPCWSTR szString);
+    STDMETHODIMP BrowseOPCItemIDs(OPCBROWSETYPE dwBrowseFilterType, LPCWSTR szFilterCriteria,
+                                  VARTYPE vtDataTypeFilter, DWORD dwAccessRightsFilter, LPENUMSTRING *ppIEnumString);
+    STDMETHODIMP GetItemID(LPWSTR szItemDataID, LPWSTR *szItemID);
+    STDMETHODIMP BrowseAccessPaths(LPCWSTR szItemID, LPENUMSTRING *ppIEnumString);
+
+    // IOPCItemProperties, not served
+    STDMETHODIMP QueryAvailableProperties(LPWSTR szItemID, DWORD *pdwCount, DWORD **ppPropertyIDs,
+                                          LPWSTR **ppDescriptions, VARTYPE **ppvtDataTypes);
+    STDMETHODIMP GetItemProperties(LPWSTR szItemID, DWORD dwCount, DWORD *pdwPropertyIDs, VARIANT **ppvData,
+                                   HRESULT **ppErrors);
+    STDMETHODIMP LookupItemIDs(LPWSTR szItemID, DWORD dwCount, DWORD *pdwPropertyIDs, LPWSTR **ppszNewItemIDs,
+                               HRESULT **ppErrors);
+
+}; // CFakeOPCServer
+
+/**
+ * host of fake servers, found by their prog id. Stands in for COPCClient::makeHost through
+ * OPCManager::setHostFactory()
+ */
+class CFakeHost : public COPCHost
+{
+  private:
+    std::vector<std::shared_ptr<CFakeServerState>> Servers;
+
+  public:
+    CFakeHost(const std::vector<std::shared_ptr<CFakeServerState>> &servers);
+
+    void getListOfDAServers(CATID cid, std::vector<std::wstring> &listOfProgIDs, std::vector<CLSID> &listOfClassIDs);
+
+    CLSID getCLSID(const std::wstring &serverProgID);
+
+    /**
+     * open a new session of the server, fails while it is not running
+     * @returns COPCServer owned by caller
+     */
+    COPCServer *connectDAServer(const std::wstring &serverProgID);
+
+    COPCServer *connectDAServer(const CLSID &clsid);
+
+}; // CFakeHost
@@ -0,0 +1,213 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "FakeOPCServer.h"
+#include "OPCApiEx.h"
+
+// the fake servers are ATL objects, the module counts them. Not an exe module, that one would make the main thread
+// a single threaded apartment
+class COPCClientTestModule : public ATL::CAtlModuleT<COPCClientTestModule>
+{
+};
+
+COPCClientTestModule _AtlModule;
+
+static int Failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        ++Failures;
+    }
+}
+
+static bool waitFor(const function<bool()> &condition, int timeout_ms = 10000)
+{
+    const auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout_ms);
+    while (!condition())
+    {
+        if (chrono::steady_clock::now() >= deadline)
+        {
+            return false;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return true;
+}
+
+static LONG readValue(OPCManager &manager, int id)
+{
+    OPCItemData value;
+    if (manager.read(id, value, OPCDATASOURCE::OPC_DS_DEVICE) != 0 || value.vDataValue.vt != VT_I4)
+    {
+        return -1;
+    }
+    return value.vDataValue.lVal;
+}
+
+static OPCJson makeConfig(bool redundant, int items)
+{
+    OPCJson json = {};
+    json.host = L"fake";
+    json.server = L"Primary";
+    if (redundant)
+    {
+        json.secondaryHost = L"fake";
+        json.secondaryServer = L"Secondary";
+    }
+    json.addItemsChunkSize = 100;
+    json.addItemsConcurrency = 1;
+    json.statusInterval = 50;
+    json.sessions = 1;
+    OPCJsonGroup group = {};
+    group.name = L"g";
+    group.updateRate = 1000;
+    for (int id = 1; id <= items; ++id)
+    {
+        group.items.push_back(OPCJsonItem{id, L"Tag." + to_wstring(id), 0, false});
+    }
+    json.groups.push_back(group);
+    return json;
+}
+
+static void useFakeServers(OPCManager &manager, const vector<shared_ptr<CFakeServerState>> &servers)
+{
+    manager.setHostFactory([servers](const wstring &hostName) -> COPCHost * {
+        (void)hostName;
+        return new CFakeHost(servers);
+    });
+}
+
+/**
+ * the primary goes away: the watchdog switches to the standby on the secondary, which already holds every item
+ */
+static void testFailover()
+{
+    printf("testFailover\n");
+    auto primary = make_shared<CFakeServerState>(L"Primary", 1000);
+    auto secondary = make_shared<CFakeServerState>(L"Secondary", 2000);
+    {
+        OPCManager manager("");
+        useFakeServers(manager, {primary, secondary});
+        COPCClient::init(OPCOLEInitMode::MULTITHREADED);
+        check(manager.start(makeConfig(true, 3)), "connect the primary");
+        check(readValue(manager, 1) == 1000, "read from the primary");
+        check(waitFor([&]() { return secondary->liveItems == 3; }), "standby built on the secondary");
+        // the standby is published under SessionLock once its items are added, give the watchdog a few passes
+        this_thread::sleep_for(chrono::milliseconds(500));
+
+        primary->running = false;
+        check(waitFor([&]() { return manager.getSwitchovers() == 1; }), "switch over to the standby");
+        check(waitFor([&]() { return readValue(manager, 1) == 2000; }), "read from the secondary");
+        check(readValue(manager, 3) == 2000, "every item moved to the secondary");
+        check(manager.getHealth().state == OPCManagerStatus::CONNECTED, "connected after the switchover");
+        check(secondary->connects == 1, "no new session opened for the switchover");
+        manager.close();
+    }
+    check(secondary->liveGroups == 0 && secondary->liveItems == 0, "groups of the secondary removed on close");
+}
+
+/**
+ * a reload changes the live layout: the standby built before it is dropped and rebuilt with the new item
+ */
+static void testStandbyFollowsLayout()
+{
+    printf("testStandbyFollowsLayout\n");
+    auto primary = make_shared<CFakeServerState>(L"Primary", 1000);
+    auto secondary = make_shared<CFakeServerState>(L"Secondary", 2000);
+    {
+        OPCManager manager("");
+        useFakeServers(manager, {primary, secondary});
+        COPCClient::init(OPCOLEInitMode::MULTITHREADED);
+        check(manager.start(makeConfig(true, 3)), "connect the primary");
+        check(waitFor([&]() { return secondary->liveItems == 3; }), "standby built on the secondary");
+        this_thread::sleep_for(chrono::milliseconds(500));
+
+        manager.reload(makeConfig(true, 4));
+        check(readValue(manager, 4) == 1000, "reloaded item read from the primary");
+        check(waitFor([&]() { return secondary->liveItems == 4; }), "standby rebuilt with the reloaded item");
+        this_thread::sleep_for(chrono::milliseconds(500));
+
+        primary->running = false;
+        check(waitFor([&]() { return manager.getSwitchovers() == 1; }), "switch over to the standby");
+        check(waitFor([&]() { return readValue(manager, 4) == 2000; }), "reloaded item read from the secondary");
+        manager.close();
+    }
+}
+
+/**
+ * the server announces its shutdown: the callback only hands it to the watchdog, which reconnects the session
+ */
+static void testShutdownReconnect()
+{
+    printf("testShutdownReconnect\n");
+    auto server = make_shared<CFakeServerState>(L"Primary", 1000);
+    {
+        OPCManager manager("");
+        useFakeServers(manager, {server});
+        COPCClient::init(OPCOLEInitMode::MULTITHREADED);
+        check(manager.start(makeConfig(false, 3)), "connect the server");
+        check(readValue(manager, 1) == 1000, "read before the shutdown");
+
+        // the request comes in on a thread of the server, as it would on a COM worker thread
+        const auto startTime = chrono::steady_clock::now();
+        thread notifier([server]() {
+            CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+            server->shutdown(L"maintenance");
+            CoUninitialize();
+        });
+        notifier.join();
+        check(chrono::steady_clock::now() - startTime < chrono::seconds(1), "shutdown callback returns at once");
+
+        check(waitFor([&]() { return server->connects == 2; }), "session reconnected by the watchdog");
+        check(waitFor([&]() { return manager.getHealth().state == OPCManagerStatus::CONNECTED; }),
+              "connected after the shutdown");
+        check(waitFor([&]() { return readValue(manager, 3) == 1000; }), "read after the reconnect");
+        manager.close();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    COPCClient::init(OPCOLEInitMode::MULTITHREADED);
+
+    testFailover();
+    testStandbyFollowsLayout();
+    testShutdownReconnect();
+
+    COPCClient::stop();
+    if (Failures > 0)
+    {
+        printf("%d checks FAILED\n", Failures);
+        return 1;
+    }
+    printf("all tests passed\n");
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "OPCApi.h"
+#include "OPCBrowseCrawler.h"
 #include "OPCItem.h"
+#include "OPCPropertyService.h"
 #include <map>
 
 bool init(OPCOLEInitMode mode)
@@ -105,7 +107,9 @@ StringList get_server_items(COPCServer *server)
     std::vector<std::wstring> _opcItemNames;
     try
     {
-        if (!server->getItemNames(_opcItemNames))
+        // DA 3.0 servers are crawled by several threads when the caller is in the multithreaded apartment
+        COPCBrowseCrawler crawler;
+        if (!crawler.crawl(*server, BrowseOptions(), _opcItemNames))
         {
             return list;
         }
@@ -125,6 +129,78 @@ StringList get_server_items(COPCServer *server)
     return list;
 }
 
+StringList crawl_server_items(COPCHost *host, const char *serverName, int threads, double *itemsPerSecond)
+{
+    StringList list = {-1};
+    if (!host || !serverName)
+    {
+        return list;
+    }
+    std::vector<std::wstring> _opcItemNames;
+    std::wstring _serverName = COPCHost::S2WS(serverName);
+    COPCBrowseCrawler crawler(threads > 0 ? threads : 1);
+    try
+    {
+        // each thread browses through a session of its own
+        if (!crawler.crawl([host, &_serverName] { return host->connectDAServer(_serverName); }, BrowseOptions(),
+                           _opcItemNames))
+        {
+            return list;
+        }
+    }
+    catch (OPCException variable)
+    {
+        printf("OPCException: %ws\n", variable.reasonString().c_str());
+        return list;
+    }
+    if (itemsPerSecond)
+    {
+        *itemsPerSecond = crawler.getItemsPerSecond();
+    }
+    list.count = _opcItemNames.size();
+    list.data = new char *[list.count];
+    for (int i = 0; i < list.count; ++i)
+    {
+        list.data[i] = strdup(COPCHost::WS2S(_opcItemNames[i]).c_str());
+    }
+    return list;
+}
+
+bool stream_server_items(COPCServer *server, int chunkSize, BrowseChunkCallbackFunction callback,
+                         const void *cb_closure)
+{
+    if (!server || !callback)
+    {
+        return false;
+    }
+    BrowseOptions options;
+    if (chunkSize > 0)
+    {
+        options.blockSize = static_cast<ULONG>(chunkSize);
+    }
+    // one buffer is reused for every chunk
+    std::string names;
+    try
+    {
+        return server->streamItemNames(
+            [&names, callback, cb_closure](std::vector<std::wstring> &itemIds) {
+                names.clear();
+                for (const std::wstring &itemId : itemIds)
+                {
+                    names += COPCHost::WS2S(itemId);
+                    names += '\0';
+                }
+                return callback(names.data(), static_cast<int>(itemIds.size()), cb_closure);
+            },
+            options);
+    }
+    catch (OPCException variable)
+    {
+        printf("OPCException: %ws\n", variable.reasonString().c_str());
+        return false;
+    }
+}
+
 COPCGroup *add_group(COPCServer *server, const char *groupName, bool active, unsigned long reqUpdateRate_ms,
                      unsigned long &revisedUpdateRate_ms, float deadBand)
 {
@@ -270,33 +346,79 @@ COPCItemPropertyValueList get_item_properties(COPCItem *item)
         return list;
     }
     std::vector<CPropertyDescription> propDesc;
-    CAutoPtrArray<SPropertyValue> propVals;
+    std::vector<std::vector<CComVariant>> propVals;
     try
     {
-        if (!item->getSupportedProperties(propDesc))
+        // descriptions are cached per data type and values for a while, repeated queries stay in memory
+        COPCPropertyService &service = item->getGroup().getServer().getPropertyService();
+        if (!service.getSupportedProperties(*item, propDesc))
         {
             return list;
         }
-        list.count = propDesc.size();
-        if (!item->getProperties(propDesc, propVals))
+        std::vector<DWORD> propIds;
+        for (auto &desc : propDesc)
         {
-            return list;
+            propIds.push_back(desc.id);
         }
+        service.getProperties(std::vector<std::wstring>(1, item->getName()), propIds, propVals);
     }
     catch (OPCException variable)
     {
         printf("OPCException: %ws\n", variable.reasonString().c_str());
         return list;
     }
+    list.count = propDesc.size();
     list.data = new COPCItemPropertyValue[list.count];
     for (int i = 0; i < list.count; ++i)
     {
-        // printf("%d: %ws %d\n", propVals[i]->propDesc.id, propVals[i]->propDesc.desc.c_str(),
-        // propVals[i]->propDesc.type);
-        list.data[i].id = propVals[i]->propDesc.id;
-        list.data[i].desc = strdup(COPCHost::WS2S(propVals[i]->propDesc.desc).c_str());
-        list.data[i].type = propVals[i]->propDesc.type;
-        list.data[i].value = propVals[i]->value;
+        list.data[i].id = propDesc[i].id;
+        list.data[i].desc = strdup(COPCHost::WS2S(propDesc[i].desc).c_str());
+        list.data[i].type = propDesc[i].type;
+        VariantInit(&list.data[i].value);
+        VariantCopy(&list.data[i].value, &propVals[0][i]);
+    }
+    return list;
+}
+
+COPCItemPropertiesList get_items_properties(COPCServer *server, StringList itemIds, const DWORD *propertyIds,
+                                            int propertyCount)
+{
+    COPCItemPropertiesList list = {-1};
+    if (!server || itemIds.count < 0 || !propertyIds || propertyCount <= 0)
+    {
+        return list;
+    }
+    std::vector<std::wstring> ids;
+    for (int i = 0; i < itemIds.count; i++)
+    {
+        ids.push_back(COPCHost::S2WS(itemIds.data[i]));
+    }
+    std::vector<DWORD> propIds(propertyIds, propertyIds + propertyCount);
+    std::vector<std::vector<CComVariant>> propVals;
+    try
+    {
+        server->getPropertyService().getProperties(ids, propIds, propVals);
+    }
+    catch (OPCException variable)
+    {
+        printf("OPCException: %ws\n", variable.reasonString().c_str());
+        return list;
+    }
+    list.count = itemIds.count;
+    list.data = new COPCItemPropertyValueList[list.count];
+    for (int i = 0; i < list.count; ++i)
+    {
+        list.data[i].count = propertyCount;
+        list.data[i].data = new COPCItemPropertyValue[propertyCount];
+        for (int p = 0; p < propertyCount; ++p)
+        {
+            COPCItemPropertyValue &value = list.data[i].data[p];
+            value.id = propIds[p];
+            value.desc = nullptr;
+            value.type = propVals[i][p].vt;
+            VariantInit(&value.value);
+            VariantCopy(&value.value, &propVals[i][p]);
+        }
     }
     return list;
 }
@@ -323,6 +445,28 @@ OPCItemData read_sync(COPCItem *item, OPCDATASOURCE source)
     return data;
 }
 
+OPCItemData read_max_age(COPCItem *item, unsigned long maxAge_ms)
+{
+    if (!item)
+    {
+        return nullptr;
+    }
+    OPCItemData data;
+    try
+    {
+        if (!item->readMaxAge(data, maxAge_ms))
+        {
+            return nullptr;
+        }
+    }
+    catch (OPCException variable)
+    {
+        printf("OPCException: %ws\n", variable.reasonString().c_str());
+        return nullptr;
+    }
+    return data;
+}
+
 OPCItemDataList multi_read_sync(COPCGroup *group, COPCItemList items, OPCDATASOURCE source)
 {
     OPCItemDataList list = {-1};
@@ -391,6 +535,62 @@ bool write_sync(COPCItem *item, VARIANT data)
     }
 }
 
+OPCItemDataList read_items(COPCServer *server, StringList itemIds, unsigned long maxAge_ms)
+{
+    OPCItemDataList list = {-1};
+    if (!server || itemIds.count < 0)
+    {
+        return list;
+    }
+    std::vector<std::wstring> ids;
+    for (int i = 0; i < itemIds.count; i++)
+    {
+        ids.push_back(COPCHost::S2WS(itemIds.data[i]));
+    }
+    std::vector<OPCItemData> itemsData;
+    try
+    {
+        server->readItems(ids, itemsData, maxAge_ms);
+    }
+    catch (OPCException variable)
+    {
+        printf("OPCException: %ws\n", variable.reasonString().c_str());
+        return list;
+    }
+    list.count = itemsData.size();
+    list.data = new OPCItemData[list.count];
+    for (int i = 0; i < list.count; ++i)
+    {
+        list.data[i] = itemsData[i];
+    }
+    return list;
+}
+
+int write_items(COPCServer *server, StringList itemIds, const VARIANT *values)
+{
+    if (!server || itemIds.count < 0 || !values)
+    {
+        return -1;
+    }
+    std::vector<std::wstring> ids;
+    std::vector<CComVariant> itemValues;
+    for (int i = 0; i < itemIds.count; i++)
+    {
+        ids.push_back(COPCHost::S2WS(itemIds.data[i]));
+        itemValues.push_back(values[i]);
+    }
+    std::vector<HRESULT> errors;
+    try
+    {
+        return server->writeItems(ids, itemValues, errors);
+    }
+    catch (OPCException variable)
+    {
+        printf("OPCException: %ws\n", variable.reasonString().c_str());
+        return -1;
+    }
+}
+
 class AsyncDataCallback : public IAsyncDataCallback
 {
   private:
@@ -603,6 +803,29 @@ Transaction refresh_async(COPCGroup *group, OPCDATASOURCE source, TransactionCom
     }
 }
 
+Transaction refresh_changes_async(COPCGroup *group, OPCDATASOURCE source,
+                                  TransactionCompleteCallbackFunction transactionCB, const void *cb_closure)
+{
+    if (!group)
+    {
+        return Transaction{};
+    }
+    TransactionCompleteCallback *callback = new TransactionCompleteCallback{transactionCB, cb_closure};
+    try
+    {
+        CTransaction *trans = group->refreshChanges(source, callback);
+        return Transaction{
+            trans,
+            callback,
+        };
+    }
+    catch (OPCException variable)
+    {
+        printf("OPCException: %ws\n", variable.reasonString().c_str());
+        return Transaction{};
+    }
+}
+
 Transaction write_async(COPCItem *item, VARIANT data, TransactionCompleteCallbackFunction transactionCB,
                         const void *cb_closure)
 {
@@ -43,6 +43,12 @@ struct OPCDACLIENT_API COPCItemPropertyValueList
     int count;
     COPCItemPropertyValue *data;
 };
+// properties of several items, data[i] holds those of the i-th item asked for
+struct OPCDACLIENT_API COPCItemPropertiesList
+{
+    int count;
+    COPCItemPropertyValueList *data;
+};
 struct OPCDACLIENT_API AsyncCallbackData
 {
     char *groupName;
@@ -61,6 +67,8 @@ struct OPCDACLIENT_API Transaction
 };
 typedef void (*AsyncDataCallbackFunction)(AsyncCallbackData changed, const void *cb_closure);
 typedef void (*TransactionCompleteCallbackFunction)(CTransaction *transaction, const void *cb_closure);
+// names holds count NUL terminated item ids back to back, valid during the call only. return false to stop browsing
+typedef bool (*BrowseChunkCallbackFunction)(const char *names, int count, const void *cb_closure);
 extern "C"
 {
     OPCDACLIENT_API bool init(OPCOLEInitMode mode = APARTMENTTHREADED);
@@ -75,6 +83,12 @@ extern "C"
 
     OPCDACLIENT_API StringList get_server_items(COPCServer *server);
 
+    OPCDACLIENT_API StringList crawl_server_items(COPCHost *host, const char *serverName, int threads,
+                                                  double *itemsPerSecond);
+
+    OPCDACLIENT_API bool stream_server_items(COPCServer *server, int chunkSize, BrowseChunkCallbackFunction callback,
+                                             const void *cb_closure);
+
     OPCDACLIENT_API COPCGroup *add_group(COPCServer *server, const char *groupName, bool active,
                                          unsigned long reqUpdateRate_ms, unsigned long &revisedUpdateRate_ms,
                                          float deadBand);
@@ -91,12 +105,25 @@ extern "C"
 
     OPCDACLIENT_API COPCItemPropertyValueList get_item_properties(COPCItem *item);
 
+    // values of propertyIds for many items, fetched in batches and cached by the server. desc is not set
+    OPCDACLIENT_API COPCItemPropertiesList get_items_properties(COPCServer *server, StringList itemIds,
+                                                                const DWORD *propertyIds, int propertyCount);
+
     OPCDACLIENT_API OPCItemData read_sync(COPCItem *item, OPCDATASOURCE source);
 
+    // reads the device only if the cached value is older than maxAge_ms
+    OPCDACLIENT_API OPCItemData read_max_age(COPCItem *item, unsigned long maxAge_ms);
+
     OPCDACLIENT_API OPCItemDataList multi_read_sync(COPCGroup *group, COPCItemList items, OPCDATASOURCE source);
 
     OPCDACLIENT_API bool write_sync(COPCItem *item, VARIANT data);
 
+    // reads items by id without a group, the values have no item
+    OPCDACLIENT_API OPCItemDataList read_items(COPCServer *server, StringList itemIds, unsigned long maxAge_ms);
+
+    // writes one value per item id without a group, returns the number of failed items or -1
+    OPCDACLIENT_API int write_items(COPCServer *server, StringList itemIds, const VARIANT *values);
+
     OPCDACLIENT_API AsyncDataCallback *enable_async(COPCGroup *group, AsyncDataCallbackFunction callback,
                                                     const void *cb_closure);
 
@@ -113,6 +140,10 @@ extern "C"
                                               TransactionCompleteCallbackFunction transactionCB,
                                               const void *cb_closure);
 
+    OPCDACLIENT_API Transaction refresh_changes_async(COPCGroup *group, OPCDATASOURCE source,
+                                                      TransactionCompleteCallbackFunction transactionCB,
+                                                      const void *cb_closure);
+
     OPCDACLIENT_API Transaction write_async(COPCItem *item, VARIANT data,
                                             TransactionCompleteCallbackFunction transactionCB, const void *cb_closure);
 
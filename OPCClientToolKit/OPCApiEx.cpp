@@ -2,172 +2,18 @@
 
 #include "OPCApiEx.h"
 
+#include "OPCConfig.h"
 #include "OPCServer.h"
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
 #include <mutex>
-#include <nlohmann/json.hpp>
-using Json = nlohmann::json;
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
-struct OPCJsonItem
-{
-    int id;
-    string name;
-
-    // NLOHMANN_DEFINE_TYPE_INTRUSIVE(OPCJsonItem, id, name)
-};
-struct OPCJsonGroup
-{
-    string name;
-    unsigned long updateRate;
-    float deadBand;
-    bool subscribe;
-    vector<OPCJsonItem> items;
-
-    // NLOHMANN_DEFINE_TYPE_INTRUSIVE(OPCJsonGroup, name, subscribe, items)
-};
-struct OPCJson
-{
-    string host;
-    string server;
-    vector<OPCJsonGroup> groups;
-
-    // NLOHMANN_DEFINE_TYPE_INTRUSIVE(OPCJson, host, server)
-};
-OPCJson readOPCJson(const string &jsonFile)
-{
-    ifstream ifs(jsonFile);
-    if (!ifs.is_open())
-    {
-        throw OPCException(L"Json file open failed!");
-    }
-    // OPCJson data = Json::parse(ifs);
-    Json json = Json::parse(ifs);
-    if (!json.is_object())
-    {
-        throw OPCException(L"json is not object");
-    }
-    Json hostKey = json.at("Host");
-    if (!hostKey.is_string())
-    {
-        throw OPCException(L"Host field is not string type");
-    }
-    OPCJson data;
-    hostKey.get_to(data.host);
-    if (data.host.empty())
-    {
-        data.host = "localhost";
-    }
-    Json serverKey = json.at("Server");
-    if (!serverKey.is_string())
-    {
-        throw OPCException(L"Server field is not string type");
-    }
-    serverKey.get_to(data.server);
-    if (data.server.empty())
-    {
-        throw OPCException(L"Server field is empty");
-    }
-    Json groups = json.at("Groups");
-    if (!groups.is_array())
-    {
-        throw OPCException(L"Groups field is not array");
-    }
-    for (int i = 0; i < groups.size(); ++i)
-    {
-        OPCJsonGroup _group;
-
-        Json group = groups[i];
-        Json groupNameKey = group.at("Group");
-        if (!groupNameKey.is_string())
-        {
-            throw OPCException(L"Group field is not string type");
-        }
-        groupNameKey.get_to(_group.name);
-        if (_group.name.empty())
-        {
-            throw OPCException(L"Group field is empty");
-        }
-        Json items = group.at("Variables");
-        if (!items.is_array())
-        {
-            throw OPCException(L"Variables field is not array");
-        }
-        for (int j = 0; j < items.size(); ++j)
-        {
-            OPCJsonItem _item;
-
-            Json item = items[j];
-            if (!item.is_object())
-            {
-                throw OPCException(L"Variable field is not object");
-            }
-            Json itemIdKey = item.at("Id");
-            if (!itemIdKey.is_number_integer())
-            {
-                throw OPCException(L"Variable Id field is not int type");
-            }
-            itemIdKey.get_to(_item.id);
-            Json itemNameKey = item.at("Name");
-            if (!itemNameKey.is_string())
-            {
-                throw OPCException(L"Variable Name field is not string type");
-            }
-            itemNameKey.get_to(_item.name);
-            if (_item.name.empty())
-            {
-                throw OPCException(L"Variable Name field is empty");
-            }
-
-            _group.items.push_back(_item);
-        }
-        Json updateRateKey = group.at("UpdateRate");
-        if (updateRateKey.is_null())
-        {
-            _group.updateRate = 1000;
-        }
-        else
-        {
-            if (!updateRateKey.is_number_unsigned())
-            {
-                throw OPCException(L"Group UpdateRate field is not ulong type");
-            }
-            updateRateKey.get_to(_group.updateRate);
-            if (_group.updateRate < 100)
-            {
-                _group.updateRate = 100;
-            }
-        }
-        Json deadBandKey = group.at("DeadZone");
-        if (deadBandKey.is_null())
-        {
-            _group.deadBand = 0.0;
-        }
-        else
-        {
-            if (!deadBandKey.is_number())
-            {
-                throw OPCException(L"Group DeadZone field is not float type");
-            }
-            deadBandKey.get_to(_group.deadBand);
-        }
-        Json subscribeKey = group.at("IsSubscribe");
-        if (subscribeKey.is_null())
-        {
-            _group.subscribe = false;
-        }
-        else
-        {
-            if (!subscribeKey.is_boolean())
-            {
-                throw OPCException(L"Group IsSubscribe field is not bool type");
-            }
-            subscribeKey.get_to(_group.subscribe);
-        }
-
-        data.groups.push_back(_group);
-    }
-    return data;
-}
 // 116444736000000000: 1601110:0:0:0001970110:0:0:000ʱ(λ100ns)
 const uint64_t DATETIMEDIFF = 116444736000000000;
 /// <summary>
@@ -460,418 +306,2783 @@ static bool ConvertByteArrayToOPCData(uint8_t *byteArray, VARIANT *value) noexce
     return false;
 }
 
-void OPCManager::connect()
+/// <summary>
+/// result of registering the items of one group
+/// </summary>
+struct OPCAddItemsResult
 {
-    Status = OPCManagerStatus::CONNECTING;
-
-    OPCJson json = readOPCJson(JsonFile);
-    printf("host: %s, server: %s\n", json.host.c_str(), json.server.c_str());
-
-    COPCClient::init(OPCOLEInitMode::MULTITHREADED);
-
-    Host = COPCClient::makeHost(COPCHost::S2WS(json.host));
-    Server = Host->connectDAServer(COPCHost::S2WS(json.server));
-    if (!Server)
+    vector<pair<int, COPCItem *>> added;
+    size_t invalid = 0;
+    size_t failed = 0;
+};
+/// <summary>
+/// apply the SamplingRate and Buffered options of the items just added to a group, one call each per chunk
+/// </summary>
+static void applyItemSampling(COPCGroup *group, const OPCJsonGroup &groupJson, const vector<size_t> &pending,
+                              size_t first, vector<COPCItem *> &itemsCreated)
+{
+    vector<COPCItem *> sampled;
+    vector<DWORD> samplingRates;
+    vector<COPCItem *> buffered;
+    for (size_t k = 0; k < itemsCreated.size(); ++k)
     {
-        throw OPCException(L"connect opc server failed");
+        const OPCJsonItem &itemJson = groupJson.items[pending[first + k]];
+        if (!itemsCreated[k])
+        {
+            continue;
+        }
+        if (itemJson.samplingRate > 0)
+        {
+            sampled.push_back(itemsCreated[k]);
+            samplingRates.push_back(itemJson.samplingRate);
+        }
+        if (itemJson.buffered)
+        {
+            buffered.push_back(itemsCreated[k]);
+        }
     }
-    Sleep(1000);
-    ServerStatus status;
-    if (!Server->getStatus(status))
+    if (sampled.empty() && buffered.empty())
     {
-        throw OPCException(L"opc server status has error");
+        return;
     }
-    printf("server status: %d\n", status.dwServerState);
-    if (status.dwServerState == tagOPCSERVERSTATE::OPC_STATUS_FAILED)
+    if (!group->hasSamplingManagement())
     {
-        throw OPCException(L"opc server not running");
+        printf("opc group %ws has no item sampling, %d items sampled at the update rate\n", groupJson.name.c_str(),
+               static_cast<int>((std::max)(sampled.size(), buffered.size())));
+        return;
     }
-    if (status.dwServerState == tagOPCSERVERSTATE::OPC_STATUS_COMM_FAULT)
+    try
     {
-        throw OPCException(L"opc server not running");
+        vector<DWORD> revisedRates;
+        vector<HRESULT> errors;
+        if (!sampled.empty() && group->setItemsSamplingRate(sampled, samplingRates, revisedRates, errors) > 0)
+        {
+            printf("opc group %ws sampling rate failed for some items\n", groupJson.name.c_str());
+        }
+        if (!buffered.empty() && group->setItemsBuffered(buffered, true, errors) > 0)
+        {
+            printf("opc group %ws buffering failed for some items\n", groupJson.name.c_str());
+        }
     }
-    for (auto &groupJson : json.groups)
+    catch (OPCException ex)
+    {
+        printf("opc item sampling failed: %ws %ws\n", groupJson.name.c_str(), ex.reasonString().c_str());
+    }
+}
+/// <summary>
+/// an item kept by a reload whose SamplingRate or Buffered option changed, live is its entry in the config applied
+/// before
+/// </summary>
+struct OPCSamplingChange
+{
+    COPCItem *item;
+    OPCJsonItem live;
+    OPCJsonItem config;
+};
+/// <summary>
+/// apply the changed SamplingRate and Buffered options of kept items, one call of each kind per group
+/// </summary>
+static void changeItemSampling(const vector<OPCSamplingChange> &changes)
+{
+    struct GroupChanges
+    {
+        vector<COPCItem *> sampled;
+        vector<DWORD> samplingRates;
+        vector<COPCItem *> cleared;
+        vector<COPCItem *> bufferedOn;
+        vector<COPCItem *> bufferedOff;
+    };
+    unordered_map<COPCGroup *, GroupChanges> groups;
+    for (auto &change : changes)
     {
-        unsigned long revisedUpdateRate_ms;
-        COPCGroup *group = Server->makeGroup(COPCHost::S2WS(groupJson.name), true, groupJson.updateRate,
-                                             revisedUpdateRate_ms, groupJson.deadBand);
-        if (!group)
+        GroupChanges &group = groups[&change.item->getGroup()];
+        if (change.config.samplingRate != change.live.samplingRate)
         {
-            throw OPCException(L"opc client make group failed");
+            // a rate of 0 samples at the update rate of the group again
+            if (change.config.samplingRate > 0)
+            {
+                group.sampled.push_back(change.item);
+                group.samplingRates.push_back(change.config.samplingRate);
+            }
+            else
+            {
+                group.cleared.push_back(change.item);
+            }
         }
-        if (groupJson.subscribe)
+        if (change.config.buffered != change.live.buffered)
         {
-            SubscribeGroups.push_back(group);
+            (change.config.buffered ? group.bufferedOn : group.bufferedOff).push_back(change.item);
         }
-        int errorCount = groupJson.items.size();
-        vector<std::wstring> itemNames;
-        for (auto &itemJson : groupJson.items)
+    }
+    for (auto &entry : groups)
+    {
+        COPCGroup *group = entry.first;
+        GroupChanges &items = entry.second;
+        if (!group->hasSamplingManagement())
         {
-            // printf("opc client add item: %s\n", itemJson.name.c_str());
-            itemNames.push_back(COPCHost::S2WS(itemJson.name));
+            printf("opc group %ws has no item sampling, %d items sampled at the update rate\n",
+                   group->getName().c_str(), static_cast<int>(items.sampled.size() + items.bufferedOn.size()));
+            continue;
         }
-        int maxRetry = 100;
-        while (errorCount > 0 && maxRetry > 0)
+        try
         {
-            std::vector<COPCItem *> itemsCreated;
-            std::vector<HRESULT> errors;
-            errorCount = group->addItems(itemNames, itemsCreated, errors, true);
-            if (errorCount > 0)
+            vector<DWORD> revisedRates;
+            vector<HRESULT> errors;
+            int failed = 0;
+            if (!items.sampled.empty())
             {
-                printf("opc client add items has error: %s %d\n", groupJson.name.c_str(), errorCount);
-                // throw OPCException(L"opc client add items has error");
-                Sleep(1000);
-                itemNames.clear();
+                failed += group->setItemsSamplingRate(items.sampled, items.samplingRates, revisedRates, errors);
             }
-            for (size_t j = 0; j < itemsCreated.size(); j++)
+            if (!items.cleared.empty())
             {
-                OPCJsonItem itemJson = groupJson.items.at(j);
-                COPCItem *item = itemsCreated.at(j);
-                if (item)
-                {
-                    ItemMap.SetAt(itemJson.id, item);
-                    ItemRevoteMap.SetAt(item->getHandle(), itemJson.id);
-                }
-                else
-                {
-                    itemNames.push_back(COPCHost::S2WS(itemJson.name));
-                }
+                failed += group->clearItemsSamplingRate(items.cleared, errors);
+            }
+            if (!items.bufferedOn.empty())
+            {
+                failed += group->setItemsBuffered(items.bufferedOn, true, errors);
+            }
+            if (!items.bufferedOff.empty())
+            {
+                failed += group->setItemsBuffered(items.bufferedOff, false, errors);
+            }
+            if (failed > 0)
+            {
+                printf("opc group %ws sampling change failed for %d items\n", group->getName().c_str(), failed);
             }
-            maxRetry--;
         }
-        if (errorCount > 0)
+        catch (OPCException ex)
         {
-            printf("opc client add items has error: %s %d, and skipped error items until 100 max retry\n",
-                   groupJson.name.c_str(), errorCount);
+            printf("opc item sampling failed: %ws %ws\n", group->getName().c_str(), ex.reasonString().c_str());
         }
     }
-
-    Status = OPCManagerStatus::CONNECTED;
-}
-std::mutex mtx;
-void OPCManager::reconnect()
-{
-    if (Status == OPCManagerStatus::STOP)
-    {
-        return;
-    }
-    if (Status == OPCManagerStatus::CONNECTED)
-    {
-        return;
-    }
-    if (Status == OPCManagerStatus::CONNECTING)
-    {
-        Sleep(1000);
-        return;
-    }
-    std::lock_guard<std::mutex> lock(mtx);
-
-    Status = OPCManagerStatus::CONNECTING;
-
-    try
-    {
-        COPCClient::stop();
-    }
-    catch (...)
-    {
-        printf("opc close failed\n");
-    }
-    SubscribeGroups.clear();
-    ItemMap.RemoveAll();
-    ItemRevoteMap.RemoveAll();
-
-    unsubscribe();
-    connect();
-    subscribe();
-
-    printf("SubscribeGroups: %d, Items: %d, %d\n", SubscribeGroups.size(), ItemMap.GetCount(),
-           ItemRevoteMap.GetCount());
-
-    Status = OPCManagerStatus::CONNECTED;
 }
-bool OPCManager::checkServerStatus(bool retryConnect)
+/// <summary>
+/// add the items of one group chunk by chunk, retry transient failures with backoff and drop names the server
+/// reports as permanently invalid through ValidateItems
+/// </summary>
+static void addGroupItems(COPCGroup *group, const OPCJsonGroup &groupJson, size_t first, size_t count, bool active,
+                          size_t chunkSize, OPCAddItemsResult &result)
 {
-    if (Status == OPCManagerStatus::STOP)
-    {
-        return false;
-    }
-    if (Status == OPCManagerStatus::CONNECTING)
+    vector<size_t> pending(count);
+    for (size_t i = 0; i < pending.size(); ++i)
     {
-        Sleep(1000);
+        pending[i] = first + i;
     }
-    ServerStatus status;
-    if (Status == OPCManagerStatus::DISCONNECTED)
+    DWORD backoff_ms = 100;
+    int maxRetry = 100;
+    while (!pending.empty() && maxRetry > 0)
     {
-        if (retryConnect)
+        vector<size_t> retry;
+        for (size_t first = 0; first < pending.size(); first += chunkSize)
         {
-            Sleep(1000);
-            try
+            const size_t last = (std::min)(first + chunkSize, pending.size());
+            vector<std::wstring> names;
+            names.reserve(last - first);
+            for (size_t k = first; k < last; ++k)
             {
-                reconnect();
+                names.push_back(groupJson.items[pending[k]].name);
             }
-            catch (OPCException ex2)
+            vector<COPCItem *> itemsCreated;
+            vector<HRESULT> errors;
+            try
             {
-                printf("opc server reconnect failed: %ws\n", ex2.reasonString().c_str());
-                Status = OPCManagerStatus::DISCONNECTED;
-                return false;
+                group->addItems(names, itemsCreated, errors, active);
             }
-            catch (...)
+            catch (OPCException ex)
             {
-                printf("opc server reconnect failed\n");
-                Status = OPCManagerStatus::DISCONNECTED;
-                return false;
+                printf("opc client add items failed: %ws %ws\n", groupJson.name.c_str(), ex.reasonString().c_str());
+                retry.insert(retry.end(), pending.begin() + first, pending.begin() + last);
+                continue;
             }
-            for (size_t i = 0; i < 5; i++)
+            applyItemSampling(group, groupJson, pending, first, itemsCreated);
+            vector<size_t> failedIndexes;
+            vector<std::wstring> failedNames;
+            for (size_t k = 0; k < itemsCreated.size(); ++k)
             {
-                Sleep(1000);
-                try
+                const OPCJsonItem &itemJson = groupJson.items[pending[first + k]];
+                if (itemsCreated[k])
                 {
-                    if (!Server->getStatus(status))
-                    {
-                        throw OPCException(L"opc server status has error");
-                    }
-                    printf("server status: %d\n", status.dwServerState);
-                    if (status.dwServerState != tagOPCSERVERSTATE::OPC_STATUS_RUNNING)
-                    {
-                        throw OPCException(L"opc server not running");
-                    }
-                    Status = OPCManagerStatus::CONNECTED;
-                    return true;
+                    result.added.emplace_back(itemJson.id, itemsCreated[k]);
                 }
-                catch (OPCException ex1)
+                else if (COPCGroup::isPermanentItemError(errors[k]))
                 {
-                    printf("opc reconnect error: %ws\n", ex1.reasonString().c_str());
+                    printf("opc client item invalid: %ws %ws 0x%08x\n", groupJson.name.c_str(), itemJson.name.c_str(),
+                           errors[k]);
+                    ++result.invalid;
                 }
-                catch (...)
+                else
                 {
-                    printf("opc reconnect error\n");
+                    failedIndexes.push_back(pending[first + k]);
+                    failedNames.push_back(std::move(names[k]));
                 }
             }
-        }
-        Status = OPCManagerStatus::DISCONNECTED;
-        return false;
-    }
-    try
-    {
-        if (!Server->getStatus(status))
-        {
-            throw OPCException(L"opc server status has error");
-        }
-        printf("server status: %d\n", status.dwServerState);
-        if (status.dwServerState != tagOPCSERVERSTATE::OPC_STATUS_RUNNING)
-        {
-            throw OPCException(L"opc server not running");
-        }
-        Status = OPCManagerStatus::CONNECTED;
-        return true;
-    }
-    catch (OPCException ex)
-    {
-        printf("opc get status error: %ws\n", ex.reasonString().c_str());
-        if (retryConnect)
-        {
-            Sleep(1000);
-            try
+            if (failedNames.empty())
             {
-                reconnect();
+                continue;
             }
-            catch (OPCException ex2)
+            vector<HRESULT> validation;
+            try
             {
-                printf("opc server reconnect failed: %ws\n", ex2.reasonString().c_str());
-                Status = OPCManagerStatus::DISCONNECTED;
-                return false;
+                group->validateItems(failedNames, validation);
             }
-            catch (...)
+            catch (OPCException)
             {
-                printf("opc server reconnect failed\n");
-                Status = OPCManagerStatus::DISCONNECTED;
-                return false;
+                validation.assign(failedNames.size(), S_OK);
             }
-            for (size_t i = 0; i < 5; i++)
+            for (size_t k = 0; k < failedIndexes.size(); ++k)
             {
-                Sleep(1000);
-                try
-                {
-                    if (!Server->getStatus(status))
-                    {
-                        throw OPCException(L"opc server status has error");
-                    }
-                    printf("server status: %d\n", status.dwServerState);
-                    if (status.dwServerState != tagOPCSERVERSTATE::OPC_STATUS_RUNNING)
-                    {
-                        throw OPCException(L"opc server not running");
-                    }
-                    Status = OPCManagerStatus::CONNECTED;
-                    return true;
-                }
-                catch (OPCException ex1)
+                if (COPCGroup::isPermanentItemError(validation[k]))
                 {
-                    printf("opc reconnect error: %ws\n", ex1.reasonString().c_str());
+                    printf("opc client item invalid: %ws %ws 0x%08x\n", groupJson.name.c_str(),
+                           groupJson.items[failedIndexes[k]].name.c_str(), validation[k]);
+                    ++result.invalid;
                 }
-                catch (...)
+                else
                 {
-                    printf("opc reconnect error\n");
+                    retry.push_back(failedIndexes[k]);
                 }
             }
         }
-        Status = OPCManagerStatus::DISCONNECTED;
-        return false;
+        pending.swap(retry);
+        maxRetry--;
+        if (!pending.empty() && maxRetry > 0)
+        {
+            printf("opc client add items has error: %ws %d, retry in %d ms\n", groupJson.name.c_str(),
+                   static_cast<int>(pending.size()), static_cast<int>(backoff_ms));
+            Sleep(backoff_ms);
+            backoff_ms = (std::min)(backoff_ms * 2, static_cast<DWORD>(1000));
+        }
     }
+    result.failed = pending.size();
 }
-
-void OPCManager::read(const vector<int> &itemIds, vector<OPCItemData> &data)
+/// <summary>
+/// items [first, first + count) of groupJson to register in one server group
+/// </summary>
+struct OPCAddItemsJob
 {
-    if (Status == OPCManagerStatus::STOP)
+    COPCGroup *group;
+    const OPCJsonGroup *groupJson;
+    size_t first;
+    size_t count;
+    bool active;
+    OPCAddItemsResult result;
+};
+/// <summary>
+/// run the jobs on up to concurrency threads, the interfaces were obtained in the MTA so any MTA thread may use them.
+/// returns the number of added items
+/// </summary>
+static size_t addItemsConcurrently(vector<OPCAddItemsJob> &jobs, size_t chunkSize, size_t concurrency)
+{
+    const auto startTime = chrono::steady_clock::now();
+    atomic<size_t> nextJob(0);
+    auto addItemsWorker = [&]() {
+        const HRESULT initResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        try
+        {
+            for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+            {
+                addGroupItems(jobs[i].group, *jobs[i].groupJson, jobs[i].first, jobs[i].count, jobs[i].active,
+                              chunkSize, jobs[i].result);
+            }
+        }
+        catch (...)
+        {
+            printf("opc client add items worker failed\n");
+        }
+        if (SUCCEEDED(initResult))
+        {
+            CoUninitialize();
+        }
+    };
+    const size_t nbrWorkers = (std::min)(concurrency, jobs.size());
+    vector<thread> workers;
+    for (size_t i = 1; i < nbrWorkers; ++i)
     {
-        throw OPCException(L"opc stopped");
+        workers.emplace_back(addItemsWorker);
     }
-    if (Status == OPCManagerStatus::CONNECTING || Status == OPCManagerStatus::DISCONNECTED)
+    addItemsWorker();
+    for (auto &worker : workers)
     {
-        throw OPCException(L"opc disconnected");
+        worker.join();
     }
-    for (auto &itemId : itemIds)
+
+    size_t addedCount = 0;
+    size_t invalidCount = 0;
+    size_t failedCount = 0;
+    for (auto &job : jobs)
     {
-        COPCItem *item;
-        if (ItemMap.Lookup(itemId, item))
+        if (job.result.failed > 0)
         {
-            OPCItemData value;
-            try
-            {
-                if (item->readSync(value, OPCDATASOURCE::OPC_DS_DEVICE))
-                {
-                    data.push_back(value);
-                    continue;
-                }
-            }
-            catch (OPCException ex)
-            {
-                printf("opc read failed: %ws %ws\n", item->getName().c_str(), ex.reasonString().c_str());
-            }
+            printf("opc client add items has error: %ws %d, and skipped error items until 100 max retry\n",
+                   job.group->getName().c_str(), static_cast<int>(job.result.failed));
+        }
+        addedCount += job.result.added.size();
+        invalidCount += job.result.invalid;
+        failedCount += job.result.failed;
+    }
+    const auto elapsed_ms =
+        chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime).count();
+    printf("opc client added %d items (%d invalid, %d failed) in %d ms, %.0f items/s\n", static_cast<int>(addedCount),
+           static_cast<int>(invalidCount), static_cast<int>(failedCount), static_cast<int>(elapsed_ms),
+           elapsed_ms > 0 ? addedCount * 1000.0 / elapsed_ms : static_cast<double>(addedCount));
+    return addedCount;
+}
+/// <summary>
+/// server group name of shard index of a logical group, the first shard keeps the configured name
+/// </summary>
+static wstring ShardName(const wstring &name, size_t index)
+{
+    return index == 0 ? name : name + L"#" + to_wstring(index + 1);
+}
+/// <summary>
+/// a pooled server session and the number of items its groups hold or are about to get
+/// </summary>
+struct OPCSessionLoad
+{
+    COPCServer *server;
+    size_t items;
+};
+static vector<OPCSessionLoad> SessionLoads(const vector<COPCServer *> &sessions, const CAtlMap<int, COPCItem *> &items)
+{
+    vector<OPCSessionLoad> loads;
+    for (auto session : sessions)
+    {
+        loads.push_back(OPCSessionLoad{session, 0});
+    }
+    if (loads.size() < 2)
+    {
+        return loads;
+    }
+    POSITION pos = items.GetStartPosition();
+    while (pos)
+    {
+        const COPCServer *owner = &items.GetNextValue(pos)->getGroup().getServer();
+        for (auto &load : loads)
+        {
+            if (load.server == owner)
+            {
+                ++load.items;
+                break;
+            }
+        }
+    }
+    return loads;
+}
+/// <summary>
+/// session a new group goes to, the one with the fewest items. Equal sessions are taken in turn
+/// </summary>
+static OPCSessionLoad &LeastLoaded(vector<OPCSessionLoad> &sessions)
+{
+    return *min_element(sessions.begin(), sessions.end(),
+                        [](const OPCSessionLoad &a, const OPCSessionLoad &b) { return a.items < b.items; });
+}
+/// <summary>
+/// spread the items of a logical group over its shards, existing shards (shardItems[s] items each) are filled up to
+/// maxGroupItems before new shards are made with the update rate and dead band of groupJson on the least loaded
+/// session. A group always has at least one shard. returns the number of shards made
+/// </summary>
+static size_t addShardJobs(vector<OPCSessionLoad> &sessions, const OPCJsonGroup &groupJson, const OPCJsonGroup &items,
+                           size_t maxGroupItems, bool active, vector<COPCGroup *> &shards, vector<size_t> &shardItems,
+                           vector<OPCAddItemsJob> &jobs)
+{
+    size_t created = 0;
+    size_t next = 0;
+    const size_t count = items.items.size();
+    for (size_t s = 0; next < count || shards.empty(); ++s)
+    {
+        if (s == shards.size())
+        {
+            unsigned long revisedUpdateRate_ms;
+            COPCGroup *shard = LeastLoaded(sessions).server->makeGroup(
+                ShardName(groupJson.name, s), true, groupJson.updateRate, revisedUpdateRate_ms, groupJson.deadBand);
+            if (!shard)
+            {
+                throw OPCException(L"opc client make group failed");
+            }
+            shards.push_back(shard);
+            shardItems.push_back(0);
+            ++created;
+        }
+        size_t room = count - next;
+        if (maxGroupItems > 0)
+        {
+            room = shardItems[s] < maxGroupItems ? (std::min)(room, maxGroupItems - shardItems[s]) : 0;
+        }
+        if (room == 0)
+        {
+            continue;
+        }
+        jobs.push_back(OPCAddItemsJob{shards[s], &items, next, room, active});
+        for (auto &load : sessions)
+        {
+            if (load.server == &shards[s]->getServer())
+            {
+                load.items += room;
+                break;
+            }
+        }
+        shardItems[s] += room;
+        next += room;
+    }
+    return created;
+}
+
+static int64_t SteadyNow_ms() noexcept
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+// server readiness is polled from SERVER_READY_POLL_MS, doubling up to SERVER_READY_POLL_MAX_MS
+static const DWORD SERVER_READY_POLL_MS = 50;
+static const DWORD SERVER_READY_POLL_MAX_MS = 1000;
+static const int64_t SERVER_READY_TIMEOUT_MS = 5000;
+// pause after a failed reconnect, doubling up to RECONNECT_BACKOFF_MAX_MS
+static const DWORD RECONNECT_BACKOFF_MIN_MS = 500;
+static const DWORD RECONNECT_BACKOFF_MAX_MS = 30000;
+// longest wait of a caller for a connect attempt running on another thread
+static const DWORD RECONNECT_WAIT_MS = 60000;
+
+void OPCManager::setStatus(OPCManagerStatus status)
+{
+    {
+        lock_guard<mutex> lock(ReconnectLock);
+        Status = status;
+        OPCServerHealth health = Health.load();
+        health.state = static_cast<uint16_t>(status);
+        Health.store(health);
+    }
+    ReconnectSignal.notify_all();
+}
+void OPCManager::publishHealth(const OPCServerHealth &health)
+{
+    lock_guard<mutex> lock(ReconnectLock);
+    OPCServerHealth published = health;
+    published.state = static_cast<uint16_t>(Status);
+    Health.store(published);
+}
+void OPCManager::connectServer(const wstring &hostName, const wstring &serverName, size_t sessionCount,
+                               bool requireRunning, COPCHost *&host, vector<COPCServer *> &sessions,
+                               OPCServerHealth &health)
+{
+    auto openSession = [&]() {
+        COPCServer *session = host->connectDAServer(serverName);
+        if (!session)
+        {
+            throw OPCException(L"connect opc server failed");
+        }
+        sessions.push_back(session);
+        try
+        {
+            session->enableShutdownNotification(&ShutdownHandler);
+        }
+        catch (OPCException ex)
+        {
+            printf("opc server shutdown notification not available: %ws\n", ex.reasonString().c_str());
+        }
+    };
+    host = HostFactory(hostName);
+    openSession();
+    ServerStatus status;
+    DWORD poll_ms = SERVER_READY_POLL_MS;
+    const int64_t deadline_ms = SteadyNow_ms() + SERVER_READY_TIMEOUT_MS;
+    while (true)
+    {
+        const auto startTime = chrono::steady_clock::now();
+        if (!sessions.front()->getStatus(status))
+        {
+            throw OPCException(L"opc server status has error");
+        }
+        health.rtt_us = static_cast<uint32_t>(
+            chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime).count());
+        if (status.dwServerState == tagOPCSERVERSTATE::OPC_STATUS_RUNNING || SteadyNow_ms() >= deadline_ms)
+        {
+            break;
+        }
+        unique_lock<mutex> lock(ReconnectLock);
+        if (ReconnectSignal.wait_for(lock, chrono::milliseconds(poll_ms),
+                                     [this]() { return Status == OPCManagerStatus::STOP; }))
+        {
+            throw OPCException(L"opc stopped");
+        }
+        poll_ms = (std::min)(poll_ms * 2, SERVER_READY_POLL_MAX_MS);
+    }
+    printf("server status: %ws %d\n", serverName.c_str(), status.dwServerState);
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    health.lastCheck = ConvertFiletimeToLong(now);
+    health.serverState = static_cast<uint16_t>(status.dwServerState);
+    if (status.dwServerState == tagOPCSERVERSTATE::OPC_STATUS_FAILED)
+    {
+        throw OPCException(L"opc server not running");
+    }
+    if (status.dwServerState == tagOPCSERVERSTATE::OPC_STATUS_COMM_FAULT)
+    {
+        throw OPCException(L"opc server not running");
+    }
+    if (requireRunning && status.dwServerState != tagOPCSERVERSTATE::OPC_STATUS_RUNNING)
+    {
+        throw OPCException(L"opc server not running");
+    }
+    // the pool connects to the running server
+    while (sessions.size() < sessionCount)
+    {
+        openSession();
+    }
+    if (sessions.size() > 1)
+    {
+        printf("opc server sessions: %d\n", static_cast<int>(sessions.size()));
+    }
+}
+void OPCManager::openServer(const OPCJson &json, bool requireRunning)
+{
+    OPCServerHealth health = {};
+    try
+    {
+        connectServer(OnSecondary ? json.secondaryHost : json.host, OnSecondary ? json.secondaryServer : json.server,
+                      json.sessions, requireRunning, Host, Sessions, health);
+    }
+    catch (...)
+    {
+        Server = Sessions.empty() ? nullptr : Sessions.front();
+        if (health.lastCheck > 0)
+        {
+            publishHealth(health);
+        }
+        throw;
+    }
+    Server = Sessions.front();
+    publishHealth(health);
+}
+OPCJson OPCManager::loadConfig()
+{
+    vector<OPCJson> configs = readOPCConfig(JsonFile, TagTableFile);
+    if (ServerIndex >= configs.size())
+    {
+        throw OPCException(L"server entry is missing from the config");
+    }
+    return std::move(configs[ServerIndex]);
+}
+void OPCManager::connect()
+{
+    setStatus(OPCManagerStatus::CONNECTING);
+    COPCClient::init(OPCOLEInitMode::MULTITHREADED);
+    connect(loadConfig());
+}
+void OPCManager::connect(OPCJson json)
+{
+    setStatus(OPCManagerStatus::CONNECTING);
+    printf("host: %ws, server: %ws\n", json.host.c_str(), json.server.c_str());
+    {
+        lock_guard<mutex> lock(DemandLock);
+        IdleTimeout_ms = json.itemIdleTimeout;
+    }
+
+    StatusInterval_ms = json.statusInterval;
+    Redundant = !json.secondaryServer.empty();
+    // a redundant pair starts on the primary, or on the secondary if the primary does not answer
+    OnSecondary = false;
+    try
+    {
+        openServer(json, false);
+    }
+    catch (OPCException ex)
+    {
+        if (!Redundant)
+        {
+            throw;
+        }
+        printf("opc primary server unavailable: %ws, connect the secondary\n", ex.reasonString().c_str());
+        destroySession(false);
+        OnSecondary = true;
+        openServer(json, false);
+    }
+    ++SessionVersion;
+    vector<OPCAddItemsJob> jobs;
+    vector<OPCSessionLoad> sessions = SessionLoads(Sessions, ItemMap);
+    for (auto &groupJson : json.groups)
+    {
+        // with an idle timeout items stay inactive until they are read or their group streams
+        Groups.push_back(OPCManagerGroup());
+        vector<size_t> shardItems;
+        addShardJobs(sessions, groupJson, groupJson, json.maxGroupItems, json.itemIdleTimeout == 0,
+                     Groups.back().shards, shardItems, jobs);
+        if (groupJson.subscribe)
+        {
+            SubscribeGroups.insert(SubscribeGroups.end(), Groups.back().shards.begin(), Groups.back().shards.end());
+        }
+        if (Groups.back().shards.size() > 1)
+        {
+            printf("opc group %ws split into %d groups\n", groupJson.name.c_str(),
+                   static_cast<int>(Groups.back().shards.size()));
+        }
+    }
+
+    addItemsConcurrently(jobs, json.addItemsChunkSize, json.addItemsConcurrency);
+    for (auto &job : jobs)
+    {
+        mapItems(job.result.added, job.active);
+    }
+    RateControl = json.maxUpdateRate > 0;
+    setConfig(std::move(json));
+    if (IdleTimeout_ms > 0)
+    {
+        startDemandThread();
+    }
+    if (RateControl)
+    {
+        startRateThread();
+    }
+
+    setStatus(OPCManagerStatus::CONNECTED);
+    startWatchdog();
+}
+bool OPCManager::start(OPCJson json)
+{
+    bool connected = false;
+    {
+        std::lock_guard<std::mutex> lock(SessionLock);
+        try
+        {
+            connect(std::move(json));
+            connected = true;
+        }
+        catch (OPCException ex)
+        {
+            printf("opc server connect failed: %ws, retried by the watchdog\n", ex.reasonString().c_str());
+        }
+        catch (...)
+        {
+            printf("opc server connect failed, retried by the watchdog\n");
+        }
+        if (!connected)
+        {
+            destroySession(false);
+            setStatus(OPCManagerStatus::DISCONNECTED);
+        }
+    }
+    startWatchdog();
+    return connected;
+}
+void OPCManager::destroySession(bool serverAlive)
+{
+    dropStandby(serverAlive);
+    vector<COPCItem *> items;
+    {
+        unique_lock<shared_timed_mutex> itemLock(ItemLock);
+        lock_guard<mutex> demandLock(DemandLock);
+        POSITION pos = ItemMap.GetStartPosition();
+        while (pos)
+        {
+            items.push_back(ItemMap.GetNextValue(pos));
+        }
+        ItemMap.RemoveAll();
+        ItemRevoteMap.RemoveAll();
+        Demand.clear();
+        ActivateQueue.clear();
+    }
+    // a group removes all its items with one call and is removed with a second one, or with none if abandoned
+    for (auto &group : Groups)
+    {
+        for (auto shards : {&group.shards, &group.fastShards})
+        {
+            for (auto shard : *shards)
+            {
+                try
+                {
+                    if (!serverAlive)
+                    {
+                        shard->abandon();
+                    }
+                    delete shard;
+                }
+                catch (...)
+                {
+                    printf("opc remove group failed\n");
+                }
+            }
+        }
+    }
+    // detached by their groups, deleting the items makes no COM call
+    for (auto item : items)
+    {
+        delete item;
+    }
+    Groups.clear();
+    SubscribeGroups.clear();
+    ShardRates.clear();
+    {
+        lock_guard<mutex> statsLock(StatsLock);
+        ShardStats.clear();
+        ItemChanges.clear();
+    }
+    for (auto session : Sessions)
+    {
+        if (!serverAlive)
+        {
+            session->abandon();
+        }
+        delete session;
+    }
+    Sessions.clear();
+    Server = nullptr;
+    delete Host;
+    Host = nullptr;
+}
+void OPCManager::reconnect(bool replay)
+{
+    if (Status != OPCManagerStatus::DISCONNECTED)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(SessionLock);
+    if (Status != OPCManagerStatus::DISCONNECTED)
+    {
+        return;
+    }
+    reconnectSession(replay);
+}
+void OPCManager::reconnectSession(bool replay, OPCJson *config)
+{
+    setStatus(OPCManagerStatus::CONNECTING);
+
+    const auto startTime = chrono::steady_clock::now();
+    const bool replayed = replay && !Groups.empty();
+    try
+    {
+        // a session exists only after a complete connect, a failed replay leaves the previous one in place
+        if (replayed)
+        {
+            // a redundant pair switches to its standby, replaying the plan is the fallback
+            if (!Standby || !switchover())
+            {
+                OPCSessionPlan plan;
+                capturePlan(plan);
+                replayPlan(plan);
+            }
+        }
+        else
+        {
+            destroySession(!replay);
+            try
+            {
+                COPCClient::stop();
+            }
+            catch (...)
+            {
+                printf("opc close failed\n");
+            }
+
+            unsubscribe();
+            try
+            {
+                if (config)
+                {
+                    COPCClient::init(OPCOLEInitMode::MULTITHREADED);
+                    connect(std::move(*config));
+                }
+                else
+                {
+                    connect();
+                }
+            }
+            catch (...)
+            {
+                destroySession(false);
+                throw;
+            }
+            subscribe();
+        }
+    }
+    catch (...)
+    {
+        // the next replay goes to the other server of a redundant pair
+        if (replayed && Redundant)
+        {
+            OnSecondary = !OnSecondary;
+        }
+        if (Status != OPCManagerStatus::STOP)
+        {
+            setStatus(OPCManagerStatus::DISCONNECTED);
+        }
+        throw;
+    }
+
+    printf("SubscribeGroups: %d, Items: %d, %d, reconnected in %d ms\n", static_cast<int>(SubscribeGroups.size()),
+           static_cast<int>(ItemMap.GetCount()), static_cast<int>(ItemRevoteMap.GetCount()),
+           static_cast<int>(
+               chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime).count()));
+
+    if (Status != OPCManagerStatus::STOP)
+    {
+        setStatus(OPCManagerStatus::CONNECTED);
+    }
+}
+void OPCManager::capturePlan(OPCSessionPlan &plan)
+{
+    // only holders of SessionLock change the item maps
+    unordered_map<const COPCGroup *, vector<pair<int, COPCItem *>>> shardMembers;
+    POSITION pos = ItemMap.GetStartPosition();
+    while (pos)
+    {
+        const CAtlMap<int, COPCItem *>::CPair *pair = ItemMap.GetNext(pos);
+        shardMembers[&pair->m_value->getGroup()].emplace_back(pair->m_key, pair->m_value);
+    }
+    const unordered_set<const COPCGroup *> streaming(SubscribeGroups.begin(), SubscribeGroups.end());
+
+    lock_guard<mutex> demandLock(DemandLock);
+    plan.subscribed = Subscribed;
+    for (size_t g = 0; g < Groups.size(); ++g)
+    {
+        const OPCJsonGroup &groupJson = Config.groups[g];
+        for (const bool fast : {false, true})
+        {
+            for (auto shard : fast ? Groups[g].fastShards : Groups[g].shards)
+            {
+                const vector<pair<int, COPCItem *>> &members = shardMembers[shard];
+                if (fast && members.empty())
+                {
+                    continue;
+                }
+                OPCPlanShard planShard;
+                planShard.group = g;
+                planShard.fast = fast;
+                planShard.json.name = shard->getName();
+                const auto current = ShardRates.find(shard);
+                planShard.rateAdjusted = current != ShardRates.end();
+                planShard.json.updateRate = planShard.rateAdjusted ? current->second
+                                                                   : (fast ? Config.minUpdateRate : groupJson.updateRate);
+                planShard.json.deadBand = groupJson.deadBand;
+                planShard.json.subscribe = streaming.count(shard) > 0;
+                // active items first, they are added active and the rest inactive
+                vector<OPCJsonItem> inactive;
+                for (auto &member : members)
+                {
+                    const auto demand = Demand.find(member.second);
+                    if (IdleTimeout_ms == 0 || (demand != Demand.end() && demand->second.active))
+                    {
+                        planShard.json.items.push_back(jsonItem(member.first, member.second));
+                    }
+                    else
+                    {
+                        inactive.push_back(jsonItem(member.first, member.second));
+                    }
+                }
+                planShard.activeItems = planShard.json.items.size();
+                planShard.json.items.insert(planShard.json.items.end(), inactive.begin(), inactive.end());
+                plan.shards.push_back(std::move(planShard));
+            }
+        }
+    }
+}
+void OPCManager::setConfig(OPCJson &&config)
+{
+    Config = std::move(config);
+    SampledItems.clear();
+    for (auto &group : Config.groups)
+    {
+        for (auto &item : group.items)
+        {
+            if (item.samplingRate > 0 || item.buffered)
+            {
+                SampledItems[item.id] = item;
+            }
+        }
+    }
+}
+OPCJsonItem OPCManager::jsonItem(int id, const COPCItem *item) const
+{
+    const auto sampled = SampledItems.find(id);
+    if (sampled != SampledItems.end())
+    {
+        return sampled->second;
+    }
+    return OPCJsonItem{id, item->getName()};
+}
+void OPCManager::replayPlan(const OPCSessionPlan &plan)
+{
+    // detach the old session from the lost server, readers keep failing on its items instead of missing their ids
+    vector<OPCManagerGroup> oldGroups;
+    vector<COPCGroup *> oldSubscribeGroups;
+    unordered_map<COPCGroup *, DWORD> oldShardRates;
+    oldGroups.swap(Groups);
+    oldSubscribeGroups.swap(SubscribeGroups);
+    oldShardRates.swap(ShardRates);
+    vector<COPCServer *> oldSessions;
+    oldSessions.swap(Sessions);
+    COPCHost *oldHost = Host;
+    COPCServer *oldServer = Server;
+    Host = nullptr;
+    Server = nullptr;
+    for (auto session : oldSessions)
+    {
+        session->abandon();
+    }
+    for (auto &group : oldGroups)
+    {
+        for (auto shards : {&group.shards, &group.fastShards})
+        {
+            for (auto shard : *shards)
+            {
+                shard->abandon();
+            }
+        }
+    }
+
+    vector<OPCAddItemsJob> jobs;
+    try
+    {
+        openServer(Config, true);
+        Groups.resize(Config.groups.size());
+        // the old items still mapped belong to the old sessions, the new ones start empty
+        vector<OPCSessionLoad> sessions = SessionLoads(Sessions, ItemMap);
+        for (auto &planShard : plan.shards)
+        {
+            unsigned long revisedUpdateRate_ms;
+            OPCSessionLoad &session = LeastLoaded(sessions);
+            session.items += planShard.json.items.size();
+            COPCGroup *shard = session.server->makeGroup(planShard.json.name, true, planShard.json.updateRate,
+                                                         revisedUpdateRate_ms, planShard.json.deadBand);
+            if (!shard)
+            {
+                throw OPCException(L"opc client make group failed");
+            }
+            (planShard.fast ? Groups[planShard.group].fastShards : Groups[planShard.group].shards).push_back(shard);
+            if (planShard.json.subscribe)
+            {
+                SubscribeGroups.push_back(shard);
+            }
+            if (planShard.rateAdjusted)
+            {
+                ShardRates[shard] = revisedUpdateRate_ms;
+            }
+            const size_t count = planShard.json.items.size();
+            if (planShard.activeItems > 0)
+            {
+                jobs.push_back(OPCAddItemsJob{shard, &planShard.json, 0, planShard.activeItems, true});
+            }
+            if (count > planShard.activeItems)
+            {
+                jobs.push_back(
+                    OPCAddItemsJob{shard, &planShard.json, planShard.activeItems, count - planShard.activeItems, false});
+            }
+        }
+        addItemsConcurrently(jobs, Config.addItemsChunkSize, Config.addItemsConcurrency);
+    }
+    catch (...)
+    {
+        // nothing of the new session is mapped yet
+        for (auto &group : Groups)
+        {
+            for (auto shards : {&group.shards, &group.fastShards})
+            {
+                for (auto shard : *shards)
+                {
+                    delete shard;
+                }
+            }
+        }
+        for (auto &job : jobs)
+        {
+            for (auto &added : job.result.added)
+            {
+                delete added.second;
+            }
+        }
+        for (auto session : Sessions)
+        {
+            delete session;
+        }
+        delete Host;
+        Groups.swap(oldGroups);
+        SubscribeGroups.swap(oldSubscribeGroups);
+        ShardRates.swap(oldShardRates);
+        Sessions.swap(oldSessions);
+        Host = oldHost;
+        Server = oldServer;
+        throw;
+    }
+
+    vector<pair<int, COPCItem *>> added;
+    vector<bool> active;
+    for (auto &job : jobs)
+    {
+        added.insert(added.end(), job.result.added.begin(), job.result.added.end());
+        active.insert(active.end(), job.result.added.size(), job.active);
+    }
+    vector<COPCItem *> previous;
+    replaceItems(added, active, previous);
+    {
+        lock_guard<mutex> statsLock(StatsLock);
+        ShardStats.clear();
+        ItemChanges.clear();
+    }
+    // unreachable now, and detached: no COM call
+    for (auto &group : oldGroups)
+    {
+        for (auto shards : {&group.shards, &group.fastShards})
+        {
+            for (auto shard : *shards)
+            {
+                delete shard;
+            }
+        }
+    }
+    for (auto item : previous)
+    {
+        delete item;
+    }
+    for (auto session : oldSessions)
+    {
+        delete session;
+    }
+    delete oldHost;
+    ++SessionVersion;
+
+    if (plan.subscribed)
+    {
+        subscribe();
+    }
+    printf("opc session replayed: %d groups, %d items\n", static_cast<int>(plan.shards.size()),
+           static_cast<int>(added.size()));
+}
+void OPCManager::replaceItems(const vector<pair<int, COPCItem *>> &items, const vector<bool> &active,
+                              vector<COPCItem *> &previous)
+{
+    unique_lock<shared_timed_mutex> itemLock(ItemLock);
+    lock_guard<mutex> demandLock(DemandLock);
+    POSITION pos = ItemMap.GetStartPosition();
+    while (pos)
+    {
+        previous.push_back(ItemMap.GetNextValue(pos));
+    }
+    ItemMap.RemoveAll();
+    ItemRevoteMap.RemoveAll();
+    Demand.clear();
+    ActivateQueue.clear();
+    const int64_t now_ms = SteadyNow_ms();
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        ItemMap.SetAt(items[i].first, items[i].second);
+        ItemRevoteMap.SetAt(items[i].second, items[i].first);
+        if (IdleTimeout_ms > 0)
+        {
+            Demand[items[i].second] = OPCItemDemand{now_ms, active[i], false, false};
+        }
+    }
+}
+/// <summary>
+/// delete a standby that is not live, like destroySession does with the live one
+/// </summary>
+static void DestroyStandby(OPCStandbySession *standby, bool serverAlive)
+{
+    for (auto &group : standby->groups)
+    {
+        for (auto shards : {&group.shards, &group.fastShards})
+        {
+            for (auto shard : *shards)
+            {
+                try
+                {
+                    if (!serverAlive)
+                    {
+                        shard->abandon();
+                    }
+                    delete shard;
+                }
+                catch (...)
+                {
+                    printf("opc remove standby group failed\n");
+                }
+            }
+        }
+    }
+    for (auto &item : standby->items)
+    {
+        delete item.second;
+    }
+    for (auto session : standby->sessions)
+    {
+        if (!serverAlive)
+        {
+            session->abandon();
+        }
+        delete session;
+    }
+    delete standby->host;
+    delete standby;
+}
+void OPCManager::dropStandby(bool serverAlive)
+{
+    if (Standby)
+    {
+        DestroyStandby(Standby, serverAlive);
+        Standby = nullptr;
+    }
+}
+void OPCManager::buildStandby()
+{
+    OPCStandbySession *standby = new OPCStandbySession();
+    standby->host = nullptr;
+    OPCJson endpoint;
+    uint64_t version;
+    {
+        lock_guard<mutex> lock(SessionLock);
+        if (Status != OPCManagerStatus::CONNECTED || Standby || Config.secondaryServer.empty())
+        {
+            delete standby;
+            return;
+        }
+        capturePlan(standby->plan);
+        version = SessionVersion;
+        // the other server of the pair, and the tuning of the live session
+        endpoint.host = OnSecondary ? Config.host : Config.secondaryHost;
+        endpoint.server = OnSecondary ? Config.server : Config.secondaryServer;
+        endpoint.sessions = Config.sessions;
+        endpoint.addItemsChunkSize = Config.addItemsChunkSize;
+        endpoint.addItemsConcurrency = Config.addItemsConcurrency;
+    }
+
+    const auto startTime = chrono::steady_clock::now();
+    vector<OPCAddItemsJob> jobs;
+    try
+    {
+        OPCServerHealth health = {};
+        connectServer(endpoint.host, endpoint.server, endpoint.sessions, true, standby->host, standby->sessions,
+                      health);
+        const size_t groupCount = standby->plan.shards.empty() ? 0 : standby->plan.shards.back().group + 1;
+        standby->groups.resize(groupCount);
+        vector<OPCSessionLoad> sessions = SessionLoads(standby->sessions, CAtlMap<int, COPCItem *>());
+        for (auto &planShard : standby->plan.shards)
+        {
+            // inactive until the switchover, the server neither polls nor sends anything for it
+            unsigned long revisedUpdateRate_ms;
+            OPCSessionLoad &session = LeastLoaded(sessions);
+            session.items += planShard.json.items.size();
+            COPCGroup *shard = session.server->makeGroup(planShard.json.name, false, planShard.json.updateRate,
+                                                         revisedUpdateRate_ms, planShard.json.deadBand);
+            if (!shard)
+            {
+                throw OPCException(L"opc client make group failed");
+            }
+            standby->shards.push_back(shard);
+            (planShard.fast ? standby->groups[planShard.group].fastShards : standby->groups[planShard.group].shards)
+                .push_back(shard);
+            if (planShard.json.subscribe)
+            {
+                standby->subscribeGroups.push_back(shard);
+            }
+            if (planShard.rateAdjusted)
+            {
+                standby->shardRates[shard] = revisedUpdateRate_ms;
+            }
+            const size_t count = planShard.json.items.size();
+            if (planShard.activeItems > 0)
+            {
+                jobs.push_back(OPCAddItemsJob{shard, &planShard.json, 0, planShard.activeItems, true});
+            }
+            if (count > planShard.activeItems)
+            {
+                jobs.push_back(
+                    OPCAddItemsJob{shard, &planShard.json, planShard.activeItems, count - planShard.activeItems, false});
+            }
+        }
+        addItemsConcurrently(jobs, endpoint.addItemsChunkSize, endpoint.addItemsConcurrency);
+    }
+    catch (...)
+    {
+        for (auto &job : jobs)
+        {
+            for (auto &added : job.result.added)
+            {
+                standby->items.push_back(added);
+            }
+        }
+        DestroyStandby(standby, true);
+        throw;
+    }
+    for (auto &job : jobs)
+    {
+        standby->items.insert(standby->items.end(), job.result.added.begin(), job.result.added.end());
+        standby->active.insert(standby->active.end(), job.result.added.size(), job.active);
+    }
+
+    lock_guard<mutex> lock(SessionLock);
+    if (Status != OPCManagerStatus::CONNECTED || Standby || version != SessionVersion)
+    {
+        // the live session changed meanwhile, the next watchdog pass builds from the new plan
+        DestroyStandby(standby, true);
+        return;
+    }
+    Standby = standby;
+    printf("opc standby ready on %ws: %d groups, %d items in %d ms\n", endpoint.server.c_str(),
+           static_cast<int>(standby->shards.size()), static_cast<int>(standby->items.size()),
+           static_cast<int>(
+               chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime).count()));
+}
+bool OPCManager::switchover()
+{
+    const auto startTime = chrono::steady_clock::now();
+    OPCStandbySession *standby = Standby;
+    Standby = nullptr;
+    OPCServerHealth health = {};
+    try
+    {
+        ServerStatus status;
+        if (!standby->sessions.front()->getStatus(status) ||
+            status.dwServerState != tagOPCSERVERSTATE::OPC_STATUS_RUNNING)
+        {
+            throw OPCException(L"opc standby server not running");
+        }
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        health.lastCheck = ConvertFiletimeToLong(now);
+        health.rtt_us = static_cast<uint32_t>(
+            chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime).count());
+        health.serverState = static_cast<uint16_t>(status.dwServerState);
+        // activation in bulk, one SetState per group, the items are registered already
+        for (size_t i = 0; i < standby->shards.size(); ++i)
+        {
+            const OPCJsonGroup &groupJson = standby->plan.shards[i].json;
+            DWORD revisedUpdateRate_ms;
+            standby->shards[i]->setState(groupJson.updateRate, revisedUpdateRate_ms, groupJson.deadBand, TRUE);
+        }
+    }
+    catch (OPCException ex)
+    {
+        printf("opc standby dropped: %ws\n", ex.reasonString().c_str());
+        DestroyStandby(standby, false);
+        return false;
+    }
+
+    // detach the lost session, readers keep failing on its items until the standby's replace them
+    for (auto session : Sessions)
+    {
+        session->abandon();
+    }
+    for (auto &group : Groups)
+    {
+        for (auto shards : {&group.shards, &group.fastShards})
+        {
+            for (auto shard : *shards)
+            {
+                shard->abandon();
+            }
+        }
+    }
+    vector<OPCManagerGroup> oldGroups;
+    vector<COPCServer *> oldSessions;
+    COPCHost *oldHost = Host;
+    oldGroups.swap(Groups);
+    oldSessions.swap(Sessions);
+    Groups.swap(standby->groups);
+    Sessions.swap(standby->sessions);
+    SubscribeGroups.swap(standby->subscribeGroups);
+    ShardRates.swap(standby->shardRates);
+    Host = standby->host;
+    Server = Sessions.front();
+    vector<COPCItem *> previous;
+    replaceItems(standby->items, standby->active, previous);
+    {
+        lock_guard<mutex> statsLock(StatsLock);
+        ShardStats.clear();
+        ItemChanges.clear();
+    }
+    OnSecondary = !OnSecondary;
+    ++SessionVersion;
+    // the groups, items and sessions moved to the live session, the rest is the plan
+    standby->host = nullptr;
+    standby->items.clear();
+    DestroyStandby(standby, false);
+
+    // abandoned and unreachable now: no COM call
+    for (auto &group : oldGroups)
+    {
+        for (auto shards : {&group.shards, &group.fastShards})
+        {
+            for (auto shard : *shards)
+            {
+                delete shard;
+            }
+        }
+    }
+    for (auto item : previous)
+    {
+        delete item;
+    }
+    for (auto session : oldSessions)
+    {
+        delete session;
+    }
+    delete oldHost;
+
+    if (Subscribed)
+    {
+        subscribe();
+    }
+    publishHealth(health);
+    const uint32_t elapsed_us = static_cast<uint32_t>(
+        chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime).count());
+    Switchover_us = elapsed_us;
+    ++Switchovers;
+    printf("opc switchover to %ws: %d groups, %d items in %.3f ms\n",
+           (OnSecondary ? Config.secondaryServer : Config.server).c_str(), static_cast<int>(Groups.size()),
+           static_cast<int>(ItemMap.GetCount()), elapsed_us / 1000.0);
+    return true;
+}
+bool OPCManager::tryReconnect()
+{
+    {
+        lock_guard<mutex> lock(ReconnectLock);
+        if (SteadyNow_ms() < NextReconnect_ms)
+        {
+            return false;
+        }
+    }
+    bool failed = false;
+    try
+    {
+        reconnect();
+    }
+    catch (OPCException ex)
+    {
+        printf("opc server reconnect failed: %ws\n", ex.reasonString().c_str());
+        failed = true;
+    }
+    catch (...)
+    {
+        printf("opc server reconnect failed\n");
+        failed = true;
+    }
+    lock_guard<mutex> lock(ReconnectLock);
+    if (failed)
+    {
+        ReconnectBackoff_ms = ReconnectBackoff_ms == 0 ? RECONNECT_BACKOFF_MIN_MS
+                                                       : (std::min)(ReconnectBackoff_ms * 2, RECONNECT_BACKOFF_MAX_MS);
+        NextReconnect_ms = SteadyNow_ms() + ReconnectBackoff_ms;
+        printf("opc server reconnect retry in %d ms\n", static_cast<int>(ReconnectBackoff_ms));
+        return false;
+    }
+    ReconnectBackoff_ms = 0;
+    NextReconnect_ms = 0;
+    return Status == OPCManagerStatus::CONNECTED;
+}
+void OPCManager::reload()
+{
+    reload(loadConfig());
+}
+void OPCManager::reload(OPCJson config, const OPCReloadScope *scope)
+{
+    if (Status == OPCManagerStatus::STOP)
+    {
+        throw OPCException(L"opc stopped");
+    }
+    if (Status != OPCManagerStatus::CONNECTED)
+    {
+        throw OPCException(L"opc disconnected");
+    }
+    std::lock_guard<std::mutex> lock(SessionLock);
+    if (Status != OPCManagerStatus::CONNECTED)
+    {
+        throw OPCException(L"opc disconnected");
+    }
+    if (config.host != Config.host || config.server != Config.server || config.sessions != Config.sessions ||
+        config.secondaryHost != Config.secondaryHost || config.secondaryServer != Config.secondaryServer ||
+        (config.itemIdleTimeout > 0) != (Config.itemIdleTimeout > 0))
+    {
+        // under the same SessionLock hold as the status change, a watchdog reconnect waiting for the lock finds the
+        // session connected again and cannot replay the old config over the new one
+        printf("opc config servers, sessions or item activation changed, reconnect\n");
+        setStatus(OPCManagerStatus::DISCONNECTED);
+        reconnectSession(false, &config);
+        return;
+    }
+    const auto startTime = chrono::steady_clock::now();
+    {
+        lock_guard<mutex> demandLock(DemandLock);
+        IdleTimeout_ms = config.itemIdleTimeout;
+    }
+    RateControl = config.maxUpdateRate > 0;
+    if (RateControl)
+    {
+        startRateThread();
+    }
+
+    // live items by logical group and the number of items in each shard, only the reload changes the item maps so
+    // no lock is needed to read them here
+    unordered_map<COPCGroup *, size_t> shardOwner;
+    unordered_map<COPCGroup *, size_t> shardItems;
+    for (size_t j = 0; j < Groups.size(); ++j)
+    {
+        for (auto shard : Groups[j].shards)
+        {
+            shardOwner[shard] = j;
+            shardItems[shard] = 0;
+        }
+        for (auto shard : Groups[j].fastShards)
+        {
+            shardOwner[shard] = j;
+            shardItems[shard] = 0;
+        }
+    }
+    vector<unordered_map<int, COPCItem *>> liveItems(Groups.size());
+    POSITION pos = ItemMap.GetStartPosition();
+    while (pos)
+    {
+        const int id = ItemMap.GetKeyAt(pos);
+        COPCItem *item = ItemMap.GetNextValue(pos);
+        const auto owner = shardOwner.find(&item->getGroup());
+        if (owner != shardOwner.end())
+        {
+            liveItems[owner->second][id] = item;
+            ++shardItems[owner->first];
+        }
+    }
+
+    // groups are matched by name, match[i] is the index of config.groups[i] in Config.groups
+    const size_t noMatch = static_cast<size_t>(-1);
+    vector<size_t> match(config.groups.size(), noMatch);
+    vector<bool> kept(Groups.size(), false);
+    for (size_t i = 0; i < config.groups.size(); ++i)
+    {
+        for (size_t j = 0; j < Groups.size(); ++j)
+        {
+            if (!kept[j] && !Groups[j].shards.empty() && Config.groups[j].name == config.groups[i].name)
+            {
+                match[i] = j;
+                kept[j] = true;
+                break;
+            }
+        }
+    }
+    auto isStreaming = [&](size_t j) { return Subscribed && Config.groups[j].subscribe; };
+
+    // an item is kept when it stays in the same group under the same name, anything else is removed and added again
+    vector<COPCItem *> removedItems;
+    vector<COPCGroup *> removedGroups;
+    vector<COPCGroup *> stopStreaming;
+    size_t removedCount = 0;
+    for (size_t j = 0; j < Groups.size(); ++j)
+    {
+        if (kept[j])
+        {
+            continue;
+        }
+        ++removedCount;
+        for (auto &live : liveItems[j])
+        {
+            removedItems.push_back(live.second);
+        }
+        for (auto shard : Groups[j].shards)
+        {
+            removedGroups.push_back(shard);
+        }
+        removedGroups.insert(removedGroups.end(), Groups[j].fastShards.begin(), Groups[j].fastShards.end());
+        if (isStreaming(j))
+        {
+            stopStreaming.insert(stopStreaming.end(), Groups[j].shards.begin(), Groups[j].shards.end());
+            stopStreaming.insert(stopStreaming.end(), Groups[j].fastShards.begin(), Groups[j].fastShards.end());
+        }
+    }
+    vector<OPCManagerGroup> groups(config.groups.size());
+    vector<OPCJsonGroup> additions(config.groups.size());
+    vector<OPCSamplingChange> resampled;
+    size_t updatedGroups = 0;
+    for (size_t i = 0; i < config.groups.size(); ++i)
+    {
+        const OPCJsonGroup &groupJson = config.groups[i];
+        additions[i].name = groupJson.name;
+        if (match[i] == noMatch)
+        {
+            additions[i].items = groupJson.items;
+            continue;
+        }
+        const OPCJsonGroup &liveJson = Config.groups[match[i]];
+        groups[i] = Groups[match[i]];
+        auto &live = liveItems[match[i]];
+        unordered_set<int> keptIds;
+        for (auto &itemJson : groupJson.items)
+        {
+            const auto found = live.find(itemJson.id);
+            const bool isLive = found != live.end() && found->second->getName() == itemJson.name;
+            const bool affected = scope && scope->add.count(itemJson.name) > 0;
+            if (scope && scope->remove.count(itemJson.name) > 0)
+            {
+                continue;
+            }
+            if (isLive && !affected)
+            {
+                keptIds.insert(itemJson.id);
+                const OPCJsonItem liveItem = jsonItem(itemJson.id, found->second);
+                if (liveItem.samplingRate != itemJson.samplingRate || liveItem.buffered != itemJson.buffered)
+                {
+                    resampled.push_back(OPCSamplingChange{found->second, liveItem, itemJson});
+                }
+            }
+            else if (!scope || affected)
+            {
+                additions[i].items.push_back(itemJson);
+            }
+        }
+        for (auto &item : live)
+        {
+            if (keptIds.find(item.first) == keptIds.end())
+            {
+                removedItems.push_back(item.second);
+                --shardItems[&item.second->getGroup()];
+            }
+        }
+        if (isStreaming(match[i]) && !groupJson.subscribe)
+        {
+            stopStreaming.insert(stopStreaming.end(), groups[i].shards.begin(), groups[i].shards.end());
+            stopStreaming.insert(stopStreaming.end(), groups[i].fastShards.begin(), groups[i].fastShards.end());
+        }
+        if (liveJson.updateRate != groupJson.updateRate || liveJson.deadBand != groupJson.deadBand)
+        {
+            // the base tier restarts from the configured rate, the controller adapts it again from there
+            for (auto shard : groups[i].shards)
+            {
+                ShardRates.erase(shard);
+                try
+                {
+                    DWORD revisedUpdateRate_ms;
+                    shard->setState(groupJson.updateRate, revisedUpdateRate_ms, groupJson.deadBand, TRUE);
+                    printf("opc group %ws update rate %d ms, dead band %f\n", shard->getName().c_str(),
+                           static_cast<int>(revisedUpdateRate_ms), groupJson.deadBand);
+                }
+                catch (OPCException ex)
+                {
+                    printf("opc reload set group state failed: %ws %ws\n", shard->getName().c_str(),
+                           ex.reasonString().c_str());
+                }
+            }
+            // the fast tier keeps the rate the controller gave it and only takes the new dead band
+            for (auto shard : groups[i].fastShards)
+            {
+                const auto current = ShardRates.find(shard);
+                try
+                {
+                    DWORD revisedUpdateRate_ms;
+                    shard->setState(current != ShardRates.end() ? current->second : config.minUpdateRate,
+                                    revisedUpdateRate_ms, groupJson.deadBand, TRUE);
+                }
+                catch (OPCException ex)
+                {
+                    printf("opc reload set group state failed: %ws %ws\n", shard->getName().c_str(),
+                           ex.reasonString().c_str());
+                }
+            }
+            ++updatedGroups;
+        }
+    }
+
+    changeItemSampling(resampled);
+
+    // unmap first, readers and the subscription callback no longer reach the items once the exclusive lock is
+    // released, and nobody holds one of them any more
+    unmapItems(removedItems);
+    for (auto group : stopStreaming)
+    {
+        try
+        {
+            group->disableAsync();
+        }
+        catch (OPCException ex)
+        {
+            printf("opc unsubscribe failed: %ws %ws\n", group->getName().c_str(), ex.reasonString().c_str());
+        }
+    }
+    pinGroupItems(stopStreaming, false);
+    unordered_map<COPCGroup *, vector<COPCItem *>> removals;
+    for (auto item : removedItems)
+    {
+        removals[&item->getGroup()].push_back(item);
+    }
+    const unordered_set<COPCGroup *> droppedGroups(removedGroups.begin(), removedGroups.end());
+    for (auto &removal : removals)
+    {
+        // a removed group takes its remaining items out with the group teardown
+        if (droppedGroups.count(removal.first))
+        {
+            continue;
+        }
+        try
+        {
+            vector<HRESULT> errors;
+            removal.first->removeItems(removal.second, errors);
+        }
+        catch (OPCException ex)
+        {
+            printf("opc reload remove items failed: %ws %ws\n", removal.first->getName().c_str(),
+                   ex.reasonString().c_str());
+        }
+    }
+    for (auto group : removedGroups)
+    {
+        printf("opc reload removed group: %ws\n", group->getName().c_str());
+        ShardRates.erase(group);
+        delete group;
+        for (auto item : removals[group])
+        {
+            delete item;
+        }
+    }
+
+    // new items fill the shards of their group up to MaxGroupItems before new shards are made. Items joining a
+    // streaming group are added inactive and activated once mapped, so their initial update is not dropped by the
+    // callback. With an idle timeout all new items start inactive
+    vector<OPCAddItemsJob> jobs;
+    vector<size_t> advisedShards(config.groups.size(), 0);
+    vector<OPCSessionLoad> sessions = SessionLoads(Sessions, ItemMap);
+    size_t addedGroups = 0;
+    for (size_t i = 0; i < config.groups.size(); ++i)
+    {
+        const bool streaming = match[i] != noMatch && isStreaming(match[i]) && config.groups[i].subscribe;
+        if (streaming)
+        {
+            advisedShards[i] = groups[i].shards.size();
+        }
+        vector<size_t> counts;
+        for (auto shard : groups[i].shards)
+        {
+            counts.push_back(shardItems[shard]);
+        }
+        try
+        {
+            const size_t created = addShardJobs(sessions, config.groups[i], additions[i], config.maxGroupItems,
+                                                IdleTimeout_ms == 0 && !streaming, groups[i].shards, counts, jobs);
+            if (match[i] == noMatch && created > 0)
+            {
+                ++addedGroups;
+            }
+        }
+        catch (OPCException ex)
+        {
+            printf("opc reload make group failed: %ws %ws\n", config.groups[i].name.c_str(),
+                   ex.reasonString().c_str());
+        }
+    }
+    size_t addedCount = 0;
+    if (!jobs.empty())
+    {
+        addedCount = addItemsConcurrently(jobs, config.addItemsChunkSize, config.addItemsConcurrency);
+    }
+    for (auto &job : jobs)
+    {
+        mapItems(job.result.added, job.active);
+    }
+    vector<COPCGroup *> streamingGroups;
+    for (size_t i = 0; i < config.groups.size(); ++i)
+    {
+        if (Subscribed && config.groups[i].subscribe)
+        {
+            streamingGroups.insert(streamingGroups.end(), groups[i].shards.begin(), groups[i].shards.end());
+            streamingGroups.insert(streamingGroups.end(), groups[i].fastShards.begin(), groups[i].fastShards.end());
+        }
+    }
+    pinGroupItems(streamingGroups, true);
+    if (IdleTimeout_ms == 0)
+    {
+        vector<COPCItem *> activate;
+        for (auto &job : jobs)
+        {
+            if (!job.active)
+            {
+                for (auto &added : job.result.added)
+                {
+                    activate.push_back(added.second);
+                }
+            }
+        }
+        vector<COPCItem *> failed;
+        setItemsActive(activate, true, failed);
+    }
+
+    SubscribeGroups.clear();
+    for (size_t i = 0; i < config.groups.size(); ++i)
+    {
+        if (!config.groups[i].subscribe)
+        {
+            continue;
+        }
+        for (size_t s = 0; s < groups[i].shards.size(); ++s)
+        {
+            COPCGroup *shard = groups[i].shards[s];
+            SubscribeGroups.push_back(shard);
+            if (Subscribed && s >= advisedShards[i])
+            {
+                try
+                {
+                    shard->enableAsync(Callback);
+                }
+                catch (OPCException ex)
+                {
+                    printf("opc subscribe failed: %ws %ws\n", shard->getName().c_str(), ex.reasonString().c_str());
+                }
+            }
+        }
+        for (auto shard : groups[i].fastShards)
+        {
+            SubscribeGroups.push_back(shard);
+            if (Subscribed && advisedShards[i] == 0)
+            {
+                try
+                {
+                    shard->enableAsync(Callback);
+                }
+                catch (OPCException ex)
+                {
+                    printf("opc subscribe failed: %ws %ws\n", shard->getName().c_str(), ex.reasonString().c_str());
+                }
+            }
+        }
+    }
+    Groups = std::move(groups);
+    setConfig(std::move(config));
+    if (addedCount > 0 || !removedItems.empty() || addedGroups > 0 || removedCount > 0 || updatedGroups > 0 ||
+        !resampled.empty())
+    {
+        // the standby no longer mirrors the live session, the watchdog builds a new one
+        dropStandby(true);
+        ++SessionVersion;
+    }
+
+    const auto elapsed_ms =
+        chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime).count();
+    printf("opc config reloaded in %d ms: %d items added, %d removed, %d groups added, %d removed, %d updated\n",
+           static_cast<int>(elapsed_ms), static_cast<int>(addedCount), static_cast<int>(removedItems.size()),
+           static_cast<int>(addedGroups), static_cast<int>(removedCount), static_cast<int>(updatedGroups));
+}
+void OPCManager::reload(const NameSpaceDiff &diff)
+{
+    if (diff.empty())
+    {
+        return;
+    }
+    OPCReloadScope scope;
+    for (auto &item : diff.added)
+    {
+        scope.add.insert(item.itemId);
+    }
+    for (auto &change : diff.typeChanged)
+    {
+        scope.add.insert(change.itemId);
+    }
+    for (auto &item : diff.removed)
+    {
+        scope.remove.insert(item.itemId);
+    }
+    OPCJson config;
+    {
+        std::lock_guard<std::mutex> lock(SessionLock);
+        config = Config;
+    }
+    printf("opc namespace changed: %d items added, %d removed, %d changed type\n", static_cast<int>(diff.added.size()),
+           static_cast<int>(diff.removed.size()), static_cast<int>(diff.typeChanged.size()));
+    reload(std::move(config), &scope);
+}
+NameSpaceDiff OPCManager::reloadNameSpace(COPCNameSpaceSnapshot &snapshot)
+{
+    wstring hostName;
+    wstring serverName;
+    uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(SessionLock);
+        if (Status != OPCManagerStatus::CONNECTED || !Server)
+        {
+            throw OPCException(L"opc disconnected");
+        }
+        hostName = OnSecondary ? Config.secondaryHost : Config.host;
+        serverName = OnSecondary ? Config.secondaryServer : Config.server;
+        version = SessionVersion;
+    }
+    // the browse of a large namespace takes long, it runs on a session of its own so that reads, reloads and the
+    // watchdog go on meanwhile
+    COPCNameSpaceSnapshot current;
+    {
+        unique_ptr<COPCHost> host(HostFactory(hostName));
+        unique_ptr<COPCServer> server(host->connectDAServer(serverName));
+        if (!server || !current.capture(*server))
+        {
+            throw OPCException(L"opc browse failed");
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(SessionLock);
+        if (Status != OPCManagerStatus::CONNECTED || version != SessionVersion)
+        {
+            // the snapshot may be of the other server of the pair, the caller tries again
+            throw OPCException(L"opc session changed during the browse");
+        }
+    }
+    NameSpaceDiff diff;
+    const bool first = snapshot.size() == 0;
+    COPCNameSpaceSnapshot::diff(snapshot, current, diff);
+    snapshot = std::move(current);
+    if (!first)
+    {
+        reload(diff);
+    }
+    return diff;
+}
+bool OPCManager::checkServerStatus(bool retryConnect)
+{
+    if (Status == OPCManagerStatus::STOP)
+    {
+        return false;
+    }
+    if (retryConnect)
+    {
+        unique_lock<mutex> lock(WatchdogLock);
+        const uint64_t request = ++CheckRequests;
+        WatchdogSignal.notify_all();
+        WatchdogSignal.wait_for(lock, chrono::milliseconds(RECONNECT_WAIT_MS),
+                                [this, request]() { return WatchdogStop || ChecksDone >= request; });
+    }
+    const OPCServerHealth health = Health.load();
+    return health.state == OPCManagerStatus::CONNECTED &&
+           health.serverState == tagOPCSERVERSTATE::OPC_STATUS_RUNNING;
+}
+void OPCManager::startWatchdog()
+{
+    if (WatchdogThread.joinable())
+    {
+        return;
+    }
+    WatchdogStop = false;
+    WatchdogThread = thread(&OPCManager::watchdogWorker, this);
+}
+void OPCManager::stopWatchdog()
+{
+    if (!WatchdogThread.joinable())
+    {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(WatchdogLock);
+        WatchdogStop = true;
+    }
+    WatchdogSignal.notify_all();
+    WatchdogThread.join();
+}
+void OPCManager::watchdogWorker()
+{
+    const HRESULT initResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    unique_lock<mutex> watchdogLock(WatchdogLock);
+    while (!WatchdogStop)
+    {
+        // a check is due every StatusInterval_ms, or right away when a caller asks for one
+        WatchdogSignal.wait_for(watchdogLock, chrono::milliseconds(StatusInterval_ms),
+                                [this]() { return WatchdogStop || ChecksDone != CheckRequests; });
+        if (WatchdogStop)
+        {
+            break;
+        }
+        const uint64_t requests = CheckRequests;
+        vector<const COPCServer *> shutdowns;
+        shutdowns.swap(ShutdownRequests);
+        watchdogLock.unlock();
+        try
+        {
+            if (!shutdowns.empty())
+            {
+                handleShutdown(shutdowns);
+            }
+            checkHealth();
+        }
+        catch (...)
+        {
+            printf("opc watchdog check failed\n");
+        }
+        watchdogLock.lock();
+        ChecksDone = requests;
+        WatchdogSignal.notify_all();
+    }
+    // callers waiting for a check see WatchdogStop
+    WatchdogSignal.notify_all();
+    watchdogLock.unlock();
+    if (SUCCEEDED(initResult))
+    {
+        CoUninitialize();
+    }
+}
+void OPCManager::checkHealth()
+{
+    if (Status == OPCManagerStatus::CONNECTED)
+    {
+        // a reload or reconnect holding SessionLock may swap the server, the next pass checks again
+        unique_lock<mutex> lock(SessionLock, try_to_lock);
+        if (!lock.owns_lock())
+        {
+            return;
+        }
+        OPCServerHealth health = Health.load();
+        const auto startTime = chrono::steady_clock::now();
+        try
+        {
+            ServerStatus status;
+            if (!Server->getStatus(status))
+            {
+                throw OPCException(L"opc server status has error");
+            }
+            FILETIME now;
+            GetSystemTimeAsFileTime(&now);
+            health.lastCheck = ConvertFiletimeToLong(now);
+            health.rtt_us = static_cast<uint32_t>(
+                chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime).count());
+            health.serverState = static_cast<uint16_t>(status.dwServerState);
+            publishHealth(health);
+            if (status.dwServerState != tagOPCSERVERSTATE::OPC_STATUS_RUNNING)
+            {
+                printf("server status: %d\n", status.dwServerState);
+                setStatus(OPCManagerStatus::DISCONNECTED);
+            }
+        }
+        catch (OPCException ex)
+        {
+            printf("opc get status error: %ws\n", ex.reasonString().c_str());
+            setStatus(OPCManagerStatus::DISCONNECTED);
+        }
+    }
+    if (Status == OPCManagerStatus::DISCONNECTED)
+    {
+        tryReconnect();
+    }
+    // keep a hot standby ready on the other server of a redundant pair
+    if (Redundant && Status == OPCManagerStatus::CONNECTED && SteadyNow_ms() >= NextStandby_ms)
+    {
+        try
+        {
+            buildStandby();
+            StandbyBackoff_ms = 0;
+        }
+        catch (OPCException ex)
+        {
+            printf("opc standby build failed: %ws\n", ex.reasonString().c_str());
+            StandbyBackoff_ms = StandbyBackoff_ms == 0 ? RECONNECT_BACKOFF_MIN_MS
+                                                       : (std::min)(StandbyBackoff_ms * 2, RECONNECT_BACKOFF_MAX_MS);
+            NextStandby_ms = SteadyNow_ms() + StandbyBackoff_ms;
+        }
+    }
+}
+
+void OPCManager::read(const vector<int> &itemIds, vector<OPCItemData> &data)
+{
+    if (Status == OPCManagerStatus::STOP)
+    {
+        throw OPCException(L"opc stopped");
+    }
+    if (Status == OPCManagerStatus::CONNECTING || Status == OPCManagerStatus::DISCONNECTED)
+    {
+        throw OPCException(L"opc disconnected");
+    }
+    shared_lock<shared_timed_mutex> lock(ItemLock);
+    for (auto &itemId : itemIds)
+    {
+        COPCItem *item;
+        if (ItemMap.Lookup(itemId, item))
+        {
+            touchItem(item);
+            OPCItemData value;
+            try
+            {
+                if (item->readSync(value, OPCDATASOURCE::OPC_DS_DEVICE))
+                {
+                    data.push_back(value);
+                    continue;
+                }
+            }
+            catch (OPCException ex)
+            {
+                printf("opc read failed: %ws %ws\n", item->getName().c_str(), ex.reasonString().c_str());
+            }
         }
         throw OPCException(L"opc read failed");
     }
 }
 
-int OPCManager::read(int itemId, OPCItemData &value, OPCDATASOURCE source)
+int OPCManager::read(int itemId, OPCItemData &value, OPCDATASOURCE source)
+{
+    return readMaxAge(itemId, value, source == OPCDATASOURCE::OPC_DS_DEVICE ? 0 : COPCGroup::MAX_AGE_CACHE);
+}
+
+int OPCManager::readMaxAge(int itemId, OPCItemData &value, DWORD maxAge_ms)
+{
+    if (Status == OPCManagerStatus::STOP)
+    {
+        return -1;
+    }
+    if (Status == OPCManagerStatus::CONNECTING || Status == OPCManagerStatus::DISCONNECTED)
+    {
+        return -2;
+    }
+    shared_lock<shared_timed_mutex> lock(ItemLock);
+    COPCItem *item;
+    if (ItemMap.Lookup(itemId, item))
+    {
+        // the cache of an item that is not active yet holds no value, its first read goes to the device
+        if (!touchItem(item))
+        {
+            maxAge_ms = 0;
+        }
+        try
+        {
+            if (item->readMaxAge(value, maxAge_ms))
+            {
+                return 0;
+            }
+        }
+        catch (OPCException ex)
+        {
+            printf("opc read failed: %ws %ws\n", item->getName().c_str(), ex.reasonString().c_str());
+        }
+        return -2;
+    }
+    return -1;
+}
+
+int OPCManager::write(int itemId, VARIANT data)
+{
+    if (Status == OPCManagerStatus::STOP)
+    {
+        return -1;
+    }
+    if (Status == OPCManagerStatus::CONNECTING || Status == OPCManagerStatus::DISCONNECTED)
+    {
+        return -2;
+    }
+    shared_lock<shared_timed_mutex> lock(ItemLock);
+    COPCItem *item;
+    if (ItemMap.Lookup(itemId, item))
+    {
+        try
+        {
+            if (item->writeSync(data))
+            {
+                return 0;
+            }
+            else
+            {
+                return -1;
+            }
+        }
+        catch (OPCException ex)
+        {
+            printf("opc write failed: %ws %ws\n", item->getName().c_str(), ex.reasonString().c_str());
+        }
+        return -2;
+    }
+    return -1;
+}
+
+void ShutdownCallback::OnShutdown(COPCServer &server, const wstring &reason)
 {
-    if (Status == OPCManagerStatus::STOP)
+    if (Manager)
     {
-        return -1;
+        Manager->onServerShutdown(server, reason);
+    }
+}
+void OPCManager::onServerShutdown(COPCServer &server, const wstring &reason)
+{
+    printf("opc server shutdown request: %ws\n", reason.c_str());
+    // called on a COM thread, Sessions is only read by the watchdog under SessionLock
+    {
+        lock_guard<mutex> lock(WatchdogLock);
+        ShutdownRequests.push_back(&server);
+        ++CheckRequests;
+    }
+    WatchdogSignal.notify_all();
+}
+void OPCManager::handleShutdown(const vector<const COPCServer *> &servers)
+{
+    std::lock_guard<std::mutex> lock(SessionLock);
+    if (Status != OPCManagerStatus::CONNECTED)
+    {
+        return;
+    }
+    for (auto server : servers)
+    {
+        if (find(Sessions.begin(), Sessions.end(), server) != Sessions.end())
+        {
+            // reads fail fast from now on instead of waiting on the dying server
+            setStatus(OPCManagerStatus::DISCONNECTED);
+            return;
+        }
+    }
+}
+void SubscribeCallback::OnDataChange(COPCGroup &group, COPCItemDataMap &changes)
+{
+    if (!Callback)
+    {
+        return;
+    }
+    Manager->recordChanges(group, changes);
+    unique_lock<mutex> streamLock;
+    if (StreamLock)
+    {
+        streamLock = unique_lock<mutex>(*StreamLock);
+    }
+    POSITION pos = changes.GetStartPosition();
+    while (pos)
+    {
+        // const OPCHANDLE handle = changes.GetKeyAt(pos);
+        OPCItemData *data = changes.GetNextValue(pos);
+        if (data)
+        {
+            publish(*data);
+        }
+    }
+}
+bool SubscribeCallback::OnDataSamples(COPCGroup &group, COPCItemDataMap &changes, vector<OPCItemData> &samples)
+{
+    if (!Callback)
+    {
+        return true;
+    }
+    // the rate controller counts changed items, not samples
+    Manager->recordChanges(group, changes);
+    unique_lock<mutex> streamLock;
+    if (StreamLock)
+    {
+        streamLock = unique_lock<mutex>(*StreamLock);
+    }
+    for (auto &sample : samples)
+    {
+        publish(sample);
+    }
+    return true;
+}
+void SubscribeCallback::publish(OPCItemData &data)
+{
+    const COPCItem *item = data.item();
+    if (!item)
+    {
+        printf("opc OnDataChange failed: item removed meanwhile\n");
+        return;
+    }
+    int id;
+    if (!Manager->getItemId(item, id))
+    {
+        return;
+    }
+    try
+    {
+        VariableParameter param{};
+        auto idStr = to_string(id);
+        param.id = idStr.c_str();
+        uint64_t timestamp = ConvertFiletimeToLong(data.ftTimeStamp);
+        param.timestamp = &timestamp;
+        int8_t status = 0;
+        vector<uint8_t> buf;
+        if (data.Error < 0)
+        {
+            param.dataLength = 0;
+        }
+        else
+        {
+            status = ConvertOPCDataToByteArray(data, buf);
+            param.dataLength = buf.size();
+            param.data = buf.data();
+        }
+        param.status = &status;
+        // printf("'%s'%d %d\n", idStr.c_str(), param.dataLength, data.Error);
+        Callback(&param);
+        /*printf("'%ws' %ws quality %d error %d\n", item->getName().c_str(), idStr.c_str(), data.wQuality,
+               data.Error);*/
+    }
+    catch (OPCException ex)
+    {
+        printf("opc SubscribeCallback failed: %ws %ws\n", item->getName().c_str(), ex.reasonString().c_str());
+    }
+}
+void OPCManager::mapItems(const vector<pair<int, COPCItem *>> &items, bool active)
+{
+    unique_lock<shared_timed_mutex> itemLock(ItemLock);
+    lock_guard<mutex> demandLock(DemandLock);
+    const int64_t now_ms = SteadyNow_ms();
+    for (auto &added : items)
+    {
+        // an item moved to another shard replaces the old one in the same step, readers never miss the id
+        COPCItem *previous;
+        if (ItemMap.Lookup(added.first, previous) && previous != added.second)
+        {
+            ItemRevoteMap.RemoveKey(previous);
+            Demand.erase(previous);
+        }
+        ItemMap.SetAt(added.first, added.second);
+        ItemRevoteMap.SetAt(added.second, added.first);
+        if (IdleTimeout_ms > 0)
+        {
+            Demand[added.second] = OPCItemDemand{now_ms, active, false, false};
+        }
+    }
+}
+void OPCManager::unmapItems(const vector<COPCItem *> &items)
+{
+    unique_lock<shared_timed_mutex> itemLock(ItemLock);
+    lock_guard<mutex> demandLock(DemandLock);
+    for (auto item : items)
+    {
+        int id;
+        if (ItemRevoteMap.Lookup(item, id))
+        {
+            ItemMap.RemoveKey(id);
+            ItemRevoteMap.RemoveKey(item);
+        }
+        // a stale entry left in ActivateQueue is skipped, the demand thread only activates items found in Demand
+        Demand.erase(item);
+    }
+}
+bool OPCManager::touchItem(COPCItem *item)
+{
+    lock_guard<mutex> lock(DemandLock);
+    if (IdleTimeout_ms == 0)
+    {
+        return true;
+    }
+    const auto found = Demand.find(item);
+    if (found == Demand.end())
+    {
+        return true;
+    }
+    OPCItemDemand &demand = found->second;
+    demand.lastUse_ms = SteadyNow_ms();
+    if (demand.active)
+    {
+        return true;
+    }
+    if (!demand.queued)
+    {
+        demand.queued = true;
+        ActivateQueue.push_back(item);
+        DemandSignal.notify_one();
+    }
+    return false;
+}
+void OPCManager::pinGroupItems(const vector<COPCGroup *> &groups, bool pin)
+{
+    if (groups.empty())
+    {
+        return;
+    }
+    shared_lock<shared_timed_mutex> itemLock(ItemLock);
+    vector<COPCItem *> activate;
+    {
+        lock_guard<mutex> demandLock(DemandLock);
+        if (IdleTimeout_ms == 0)
+        {
+            return;
+        }
+        const unordered_set<const COPCGroup *> groupSet(groups.begin(), groups.end());
+        const int64_t now_ms = SteadyNow_ms();
+        POSITION pos = ItemMap.GetStartPosition();
+        while (pos)
+        {
+            COPCItem *item = ItemMap.GetNextValue(pos);
+            const auto found = Demand.find(item);
+            if (found == Demand.end() || groupSet.find(&item->getGroup()) == groupSet.end())
+            {
+                continue;
+            }
+            OPCItemDemand &demand = found->second;
+            demand.pinned = pin;
+            // released items run into the idle timeout from now on
+            demand.lastUse_ms = now_ms;
+            if (pin && !demand.active)
+            {
+                demand.active = true;
+                activate.push_back(item);
+            }
+        }
+    }
+    vector<COPCItem *> failed;
+    setItemsActive(activate, true, failed);
+    lock_guard<mutex> demandLock(DemandLock);
+    for (auto item : failed)
+    {
+        const auto found = Demand.find(item);
+        if (found != Demand.end())
+        {
+            found->second.active = false;
+        }
+    }
+}
+void OPCManager::setItemsActive(const vector<COPCItem *> &items, bool active, vector<COPCItem *> &failed)
+{
+    // one SetActiveState call per group
+    unordered_map<COPCGroup *, vector<COPCItem *>> groupItems;
+    for (auto item : items)
+    {
+        groupItems[&item->getGroup()].push_back(item);
+    }
+    for (auto &entry : groupItems)
+    {
+        try
+        {
+            vector<HRESULT> errors;
+            if (entry.first->setItemsActive(entry.second, active, errors) == 0)
+            {
+                continue;
+            }
+            for (size_t i = 0; i < errors.size(); ++i)
+            {
+                if (FAILED(errors[i]))
+                {
+                    failed.push_back(entry.second[i]);
+                }
+            }
+        }
+        catch (OPCException ex)
+        {
+            printf("opc set items active failed: %ws %ws\n", entry.first->getName().c_str(),
+                   ex.reasonString().c_str());
+            failed.insert(failed.end(), entry.second.begin(), entry.second.end());
+        }
+    }
+}
+void OPCManager::startDemandThread()
+{
+    if (DemandThread.joinable())
+    {
+        return;
+    }
+    DemandStop = false;
+    DemandThread = thread(&OPCManager::demandWorker, this);
+}
+void OPCManager::stopDemandThread()
+{
+    if (!DemandThread.joinable())
+    {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(DemandLock);
+        DemandStop = true;
+    }
+    DemandSignal.notify_one();
+    DemandThread.join();
+}
+void OPCManager::demandWorker()
+{
+    const HRESULT initResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    int64_t lastScan_ms = SteadyNow_ms();
+    unique_lock<mutex> demandLock(DemandLock);
+    while (!DemandStop)
+    {
+        // idle items are looked for a few times per timeout, at least once a second. Activations queued while a
+        // batch is sent go out together with the next one
+        const int64_t scanInterval_ms =
+            IdleTimeout_ms > 0 ? (std::min)(static_cast<int64_t>(IdleTimeout_ms / 4) + 1, int64_t(1000)) : 1000;
+        DemandSignal.wait_for(demandLock, chrono::milliseconds(scanInterval_ms),
+                              [this]() { return DemandStop || !ActivateQueue.empty(); });
+        if (DemandStop)
+        {
+            break;
+        }
+        const bool scan = IdleTimeout_ms > 0 && SteadyNow_ms() - lastScan_ms >= scanInterval_ms;
+        if (ActivateQueue.empty() && !scan)
+        {
+            continue;
+        }
+        demandLock.unlock();
+        {
+            // ItemLock keeps the items alive during the calls and has to be taken before DemandLock
+            shared_lock<shared_timed_mutex> itemLock(ItemLock);
+            vector<COPCItem *> activate;
+            vector<COPCItem *> deactivate;
+            demandLock.lock();
+            for (auto item : ActivateQueue)
+            {
+                const auto found = Demand.find(item);
+                if (found == Demand.end() || !found->second.queued)
+                {
+                    continue;
+                }
+                found->second.queued = false;
+                if (!found->second.active)
+                {
+                    found->second.active = true;
+                    activate.push_back(item);
+                }
+            }
+            ActivateQueue.clear();
+            if (scan)
+            {
+                const int64_t now_ms = SteadyNow_ms();
+                lastScan_ms = now_ms;
+                for (auto &entry : Demand)
+                {
+                    OPCItemDemand &demand = entry.second;
+                    if (demand.active && !demand.pinned && now_ms - demand.lastUse_ms > IdleTimeout_ms)
+                    {
+                        demand.active = false;
+                        deactivate.push_back(entry.first);
+                    }
+                }
+            }
+            demandLock.unlock();
+
+            vector<COPCItem *> failedActivate;
+            vector<COPCItem *> failedDeactivate;
+            setItemsActive(activate, true, failedActivate);
+            setItemsActive(deactivate, false, failedDeactivate);
+            demandLock.lock();
+            for (auto item : failedActivate)
+            {
+                const auto found = Demand.find(item);
+                if (found != Demand.end())
+                {
+                    found->second.active = false;
+                }
+            }
+            for (auto item : failedDeactivate)
+            {
+                const auto found = Demand.find(item);
+                if (found != Demand.end())
+                {
+                    found->second.active = true;
+                }
+            }
+            demandLock.unlock();
+            if (!deactivate.empty())
+            {
+                printf("opc items activated: %d, deactivated: %d\n",
+                       static_cast<int>(activate.size() - failedActivate.size()),
+                       static_cast<int>(deactivate.size() - failedDeactivate.size()));
+            }
+        }
+        demandLock.lock();
+    }
+    demandLock.unlock();
+    if (SUCCEEDED(initResult))
+    {
+        CoUninitialize();
+    }
+}
+// the controller looks at the callbacks of the last window. A shard speeds up when more than half of its items
+// change per update or the values arrive later than one update period, and slows down when fewer than 5% change
+static const DWORD RATE_WINDOW_MS = 10000;
+static const double RATE_BUSY_RATIO = 0.5;
+static const double RATE_QUIET_RATIO = 0.05;
+void OPCManager::recordChanges(COPCGroup &group, COPCItemDataMap &changes)
+{
+    if (!RateControl)
+    {
+        return;
+    }
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    const uint64_t now_ms = ConvertFiletimeToLong(now) / 1000000;
+    lock_guard<mutex> lock(StatsLock);
+    OPCShardStats &stats = ShardStats[&group];
+    ++stats.callbacks;
+    POSITION pos = changes.GetStartPosition();
+    while (pos)
+    {
+        OPCItemData *data = changes.GetNextValue(pos);
+        if (!data || !data->item())
+        {
+            continue;
+        }
+        ++stats.changes;
+        ++ItemChanges[data->item()];
+        // a server clock running ahead of ours counts as no latency
+        const uint64_t source_ms = ConvertFiletimeToLong(data->ftTimeStamp) / 1000000;
+        if (now_ms > source_ms)
+        {
+            stats.latencySum_ms += now_ms - source_ms;
+        }
+    }
+}
+void OPCManager::startRateThread()
+{
+    if (RateThread.joinable())
+    {
+        return;
+    }
+    RateStop = false;
+    RateThread = thread(&OPCManager::rateWorker, this);
+}
+void OPCManager::stopRateThread()
+{
+    if (!RateThread.joinable())
+    {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(RateLock);
+        RateStop = true;
+    }
+    RateSignal.notify_one();
+    RateThread.join();
+}
+void OPCManager::rateWorker()
+{
+    const HRESULT initResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    unique_lock<mutex> rateLock(RateLock);
+    while (!RateStop)
+    {
+        RateSignal.wait_for(rateLock, chrono::milliseconds(RATE_WINDOW_MS), [this]() { return RateStop; });
+        if (RateStop)
+        {
+            break;
+        }
+        rateLock.unlock();
+        try
+        {
+            adjustRates();
+        }
+        catch (...)
+        {
+            printf("opc update rate controller failed\n");
+        }
+        rateLock.lock();
+    }
+    rateLock.unlock();
+    if (SUCCEEDED(initResult))
+    {
+        CoUninitialize();
+    }
+}
+void OPCManager::adjustRates()
+{
+    unordered_map<COPCGroup *, OPCShardStats> shardStats;
+    unordered_map<const COPCItem *, uint32_t> itemChanges;
+    {
+        lock_guard<mutex> lock(StatsLock);
+        shardStats.swap(ShardStats);
+        itemChanges.swap(ItemChanges);
+    }
+    std::lock_guard<std::mutex> lock(SessionLock);
+    if (Status != OPCManagerStatus::CONNECTED || !Subscribed || !RateControl)
+    {
+        return;
+    }
+    // items of every shard, only holders of SessionLock change the item maps
+    unordered_map<COPCGroup *, vector<COPCItem *>> shardMembers;
+    {
+        shared_lock<shared_timed_mutex> itemLock(ItemLock);
+        POSITION pos = ItemMap.GetStartPosition();
+        while (pos)
+        {
+            COPCItem *item = ItemMap.GetNextValue(pos);
+            shardMembers[&item->getGroup()].push_back(item);
+        }
+    }
+
+    const DWORD minRate = Config.minUpdateRate;
+    const DWORD maxRate = Config.maxUpdateRate;
+    bool layoutChanged = false;
+    for (size_t j = 0; j < Groups.size(); ++j)
+    {
+        const OPCJsonGroup &groupJson = Config.groups[j];
+        if (!groupJson.subscribe)
+        {
+            continue;
+        }
+        vector<COPCItem *> hot;
+        vector<COPCItem *> cold;
+        for (int tier = 0; tier < 2; ++tier)
+        {
+            const bool fast = tier == 1;
+            for (auto shard : fast ? Groups[j].fastShards : Groups[j].shards)
+            {
+                const auto members = shardMembers.find(shard);
+                if (members == shardMembers.end())
+                {
+                    continue;
+                }
+                const auto current = ShardRates.find(shard);
+                const DWORD rate =
+                    current != ShardRates.end() ? current->second : (fast ? minRate : groupJson.updateRate);
+                const double scans = (std::max)(1.0, static_cast<double>(RATE_WINDOW_MS) / rate);
+                const OPCShardStats &stats = shardStats[shard];
+                const double ratio = stats.changes / (members->second.size() * scans);
+                const uint64_t latency_ms = stats.changes > 0 ? stats.latencySum_ms / stats.changes : 0;
+
+                DWORD target = (std::min)((std::max)(rate, minRate), maxRate);
+                if (ratio > RATE_BUSY_RATIO || latency_ms > rate)
+                {
+                    target = (std::max)(target / 2, minRate);
+                }
+                else if (ratio < RATE_QUIET_RATIO)
+                {
+                    target = (std::min)(target * 2, maxRate);
+                }
+                if (target != rate)
+                {
+                    try
+                    {
+                        DWORD revisedUpdateRate_ms;
+                        shard->setState(target, revisedUpdateRate_ms, groupJson.deadBand, TRUE);
+                        ShardRates[shard] = revisedUpdateRate_ms;
+                        layoutChanged = true;
+                        printf("opc group %ws update rate %d -> %d ms (%.0f%% changing, %d ms latency)\n",
+                               shard->getName().c_str(), static_cast<int>(rate),
+                               static_cast<int>(revisedUpdateRate_ms), ratio * 100, static_cast<int>(latency_ms));
+                    }
+                    catch (OPCException ex)
+                    {
+                        printf("opc set group update rate failed: %ws %ws\n", shard->getName().c_str(),
+                               ex.reasonString().c_str());
+                    }
+                }
+
+                // hot items of a mostly quiet shard move to the fast tier, items of the fast tier that calmed down
+                // move back
+                for (auto item : members->second)
+                {
+                    const auto found = itemChanges.find(item);
+                    const double itemRatio = found != itemChanges.end() ? found->second / scans : 0;
+                    if (!fast && rate > minRate && ratio < RATE_BUSY_RATIO / 2 && itemRatio > RATE_BUSY_RATIO)
+                    {
+                        hot.push_back(item);
+                    }
+                    else if (fast && itemRatio < RATE_QUIET_RATIO)
+                    {
+                        cold.push_back(item);
+                    }
+                }
+            }
+        }
+        // a bounded number of moves per window keeps the shards from churning
+        if (hot.size() > Config.addItemsChunkSize)
+        {
+            hot.resize(Config.addItemsChunkSize);
+        }
+        if (cold.size() > Config.addItemsChunkSize)
+        {
+            cold.resize(Config.addItemsChunkSize);
+        }
+        if (!hot.empty() && moveItems(j, hot, true, shardMembers))
+        {
+            layoutChanged = true;
+        }
+        if (!cold.empty() && moveItems(j, cold, false, shardMembers))
+        {
+            layoutChanged = true;
+        }
     }
-    if (Status == OPCManagerStatus::CONNECTING || Status == OPCManagerStatus::DISCONNECTED)
+    if (layoutChanged)
     {
-        return -2;
+        // the standby no longer mirrors the live session, the watchdog builds a new one
+        dropStandby(true);
+        ++SessionVersion;
     }
-    COPCItem *item;
-    if (ItemMap.Lookup(itemId, item))
+}
+bool OPCManager::moveItems(size_t group, const vector<COPCItem *> &items, bool toFast,
+                           const unordered_map<COPCGroup *, vector<COPCItem *>> &shardMembers)
+{
+    const OPCJsonGroup &groupJson = Config.groups[group];
+    vector<COPCGroup *> &shards = toFast ? Groups[group].fastShards : Groups[group].shards;
+    // parameters of shards made for the target tier
+    OPCJsonGroup tier;
+    tier.name = toFast ? groupJson.name + L"@fast" : groupJson.name;
+    tier.updateRate = toFast ? Config.minUpdateRate : groupJson.updateRate;
+    tier.deadBand = groupJson.deadBand;
+    tier.subscribe = groupJson.subscribe;
+
+    OPCJsonGroup moving;
+    moving.name = tier.name;
+    vector<COPCItem *> sources;
+    vector<OPCSessionLoad> sessions;
     {
-        try
+        // released before mapItems takes the lock exclusively
+        shared_lock<shared_timed_mutex> itemLock(ItemLock);
+        for (auto item : items)
         {
-            if (item->readSync(value, source))
+            int id;
+            if (ItemRevoteMap.Lookup(item, id))
             {
-                return 0;
+                moving.items.push_back(jsonItem(id, item));
+                sources.push_back(item);
             }
         }
-        catch (OPCException ex)
-        {
-            printf("opc read failed: %ws %ws\n", item->getName().c_str(), ex.reasonString().c_str());
-        }
-        return -2;
+        sessions = SessionLoads(Sessions, ItemMap);
     }
-    return -1;
-}
-
-int OPCManager::write(int itemId, VARIANT data)
-{
-    if (Status == OPCManagerStatus::STOP)
+    vector<size_t> shardItems;
+    for (auto shard : shards)
     {
-        return -1;
+        const auto members = shardMembers.find(shard);
+        shardItems.push_back(members != shardMembers.end() ? members->second.size() : 0);
     }
-    if (Status == OPCManagerStatus::CONNECTING || Status == OPCManagerStatus::DISCONNECTED)
+    const size_t advisedShards = shards.size();
+    vector<OPCAddItemsJob> jobs;
+    try
     {
-        return -2;
+        addShardJobs(sessions, tier, moving, Config.maxGroupItems, false, shards, shardItems, jobs);
     }
-    COPCItem *item;
-    if (ItemMap.Lookup(itemId, item))
+    catch (OPCException ex)
+    {
+        printf("opc make group failed: %ws %ws\n", tier.name.c_str(), ex.reasonString().c_str());
+    }
+    if (jobs.empty())
+    {
+        return false;
+    }
+    addItemsConcurrently(jobs, Config.addItemsChunkSize, Config.addItemsConcurrency);
+
+    // the copies are added inactive and replace the originals in the maps, new shards are advised, then the copies
+    // are activated and the originals removed, so the id keeps streaming and the first updates are not lost
+    unordered_set<int> movedIds;
+    vector<COPCItem *> added;
+    for (auto &job : jobs)
+    {
+        mapItems(job.result.added, false);
+        for (auto &item : job.result.added)
+        {
+            movedIds.insert(item.first);
+            added.push_back(item.second);
+        }
+    }
+    for (size_t s = advisedShards; s < shards.size(); ++s)
     {
+        SubscribeGroups.push_back(shards[s]);
         try
         {
-            if (item->writeSync(data))
-            {
-                return 0;
-            }
-            else
-            {
-                return -1;
-            }
+            shards[s]->enableAsync(Callback);
         }
         catch (OPCException ex)
         {
-            printf("opc write failed: %ws %ws\n", item->getName().c_str(), ex.reasonString().c_str());
+            printf("opc subscribe failed: %ws %ws\n", shards[s]->getName().c_str(), ex.reasonString().c_str());
         }
-        return -2;
     }
-    return -1;
-}
-
-void SubscribeCallback::OnDataChange(COPCGroup &group, COPCItemDataMap &changes)
-{
-    if (!Callback)
+    if (IdleTimeout_ms > 0)
     {
-        return;
+        pinGroupItems(shards, true);
     }
-    POSITION pos = changes.GetStartPosition();
-    while (pos)
+    else
     {
-        // const OPCHANDLE handle = changes.GetKeyAt(pos);
-        OPCItemData *data = changes.GetNextValue(pos);
-        if (data)
+        vector<COPCItem *> failed;
+        setItemsActive(added, true, failed);
+    }
+    unordered_map<COPCGroup *, vector<COPCItem *>> removals;
+    for (size_t k = 0; k < sources.size(); ++k)
+    {
+        if (movedIds.find(moving.items[k].id) != movedIds.end())
         {
-            const COPCItem *item = data->item();
-            if (!item)
-            {
-                printf("opc OnDataChange failed: %d %ws\n", changes.GetKeyAt(pos), item->getName().c_str());
-            }
-            int id;
-            const OPCHANDLE handle = item->getHandle();
-            if (!Manager->getItemId(handle, id))
-            {
-                continue;
-            }
-            try
-            {
-                VariableParameter param{};
-                auto idStr = to_string(id);
-                param.id = idStr.c_str();
-                uint64_t timestamp = ConvertFiletimeToLong(data->ftTimeStamp);
-                param.timestamp = &timestamp;
-                int8_t status = 0;
-                vector<uint8_t> buf;
-                if (data->Error < 0)
-                {
-                    param.dataLength = 0;
-                }
-                else
-                {
-                    status = ConvertOPCDataToByteArray(*data, buf);
-                    param.dataLength = buf.size();
-                    param.data = buf.data();
-                }
-                param.status = &status;
-                // printf("'%s'%d %d\n", idStr.c_str(), param.dataLength, data->Error);
-                Callback(&param);
-                /*printf("'%ws' %ws quality %d error %d\n", item->getName().c_str(), idStr.c_str(), data->wQuality,
-                       data->Error);*/
-            }
-            catch (OPCException ex)
-            {
-                printf("opc SubscribeCallback failed: %ws %ws\n", item->getName().c_str(), ex.reasonString().c_str());
-            }
+            removals[&sources[k]->getGroup()].push_back(sources[k]);
+        }
+    }
+    for (auto &removal : removals)
+    {
+        try
+        {
+            vector<HRESULT> errors;
+            removal.first->removeItems(removal.second, errors);
+        }
+        catch (OPCException ex)
+        {
+            printf("opc remove items failed: %ws %ws\n", removal.first->getName().c_str(),
+                   ex.reasonString().c_str());
         }
     }
+    printf("opc group %ws moved %d items to the %s tier\n", groupJson.name.c_str(), static_cast<int>(added.size()),
+           toFast ? "fast" : "base");
+    return true;
 }
 void OPCManager::subscribe()
 {
+    Subscribed = true;
+    pinGroupItems(SubscribeGroups, true);
     for (auto &group : SubscribeGroups)
     {
         try
@@ -887,6 +3098,7 @@ void OPCManager::subscribe()
 
 void OPCManager::unsubscribe()
 {
+    Subscribed = false;
     for (auto &group : SubscribeGroups)
     {
         try
@@ -898,17 +3110,31 @@ void OPCManager::unsubscribe()
             printf("opc unsubscribe failed: %ws %ws\n", group->getName().c_str(), ex.reasonString().c_str());
         }
     }
+    pinGroupItems(SubscribeGroups, false);
 }
 
 void OPCManager::close()
 {
-    Status = OPCManagerStatus::STOP;
+    if (Status == OPCManagerStatus::STOP && !Host)
+    {
+        return;
+    }
+    const bool serverAlive = Status == OPCManagerStatus::CONNECTED;
+    // also ends a readiness wait of a reconnect running on the watchdog
+    setStatus(OPCManagerStatus::STOP);
+    stopWatchdog();
     if (Callback)
     {
         unsubscribe();
         delete Callback;
         Callback = nullptr;
     }
+    stopDemandThread();
+    stopRateThread();
+    {
+        std::lock_guard<std::mutex> lock(SessionLock);
+        destroySession(serverAlive);
+    }
     try
     {
         COPCClient::stop();
@@ -919,6 +3145,210 @@ void OPCManager::close()
     }
 }
 
+void OPCDriver::forEachManager(const function<void(OPCManager *, size_t)> &task)
+{
+    if (Managers.size() == 1)
+    {
+        task(Managers[0], 0);
+        return;
+    }
+    vector<exception_ptr> failures(Managers.size());
+    vector<thread> workers;
+    for (size_t i = 0; i < Managers.size(); ++i)
+    {
+        workers.emplace_back([this, &task, &failures, i]() {
+            const HRESULT initResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+            try
+            {
+                task(Managers[i], i);
+            }
+            catch (...)
+            {
+                failures[i] = current_exception();
+            }
+            if (SUCCEEDED(initResult))
+            {
+                CoUninitialize();
+            }
+        });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    for (auto &failure : failures)
+    {
+        if (failure)
+        {
+            rethrow_exception(failure);
+        }
+    }
+}
+void OPCDriver::route(const vector<OPCJson> &configs)
+{
+    unordered_map<int, OPCManager *> routes;
+    for (size_t i = 0; i < configs.size(); ++i)
+    {
+        for (auto &group : configs[i].groups)
+        {
+            for (auto &item : group.items)
+            {
+                routes[item.id] = Managers[i];
+            }
+        }
+    }
+    unique_lock<shared_timed_mutex> lock(RouteLock);
+    Routes.swap(routes);
+}
+size_t OPCDriver::connect()
+{
+    vector<OPCJson> configs = readOPCConfig(JsonFile, TagTableFile);
+    for (size_t i = 0; i < configs.size(); ++i)
+    {
+        Managers.push_back(new OPCManager(JsonFile, TagTableFile, i));
+        // paired with the COPCClient::stop of the manager's close, which runs on the caller's thread
+        COPCClient::init(OPCOLEInitMode::MULTITHREADED);
+    }
+    route(configs);
+    if (Managers.size() > 1)
+    {
+        printf("opc driver connecting %d servers\n", static_cast<int>(Managers.size()));
+    }
+    const auto startTime = chrono::steady_clock::now();
+    vector<char> connected(Managers.size(), 0);
+    forEachManager([&configs, &connected](OPCManager *manager, size_t i) {
+        connected[i] = manager->start(std::move(configs[i])) ? 1 : 0;
+    });
+    const size_t connectedCount = static_cast<size_t>(count(connected.begin(), connected.end(), 1));
+    if (Managers.size() > 1)
+    {
+        printf("opc driver connected %d of %d servers in %d ms\n", static_cast<int>(connectedCount),
+               static_cast<int>(Managers.size()),
+               static_cast<int>(
+                   chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime).count()));
+    }
+    return connectedCount;
+}
+void OPCDriver::reload()
+{
+    vector<OPCJson> configs = readOPCConfig(JsonFile, TagTableFile);
+    if (configs.size() != Managers.size())
+    {
+        throw OPCException(L"number of servers changed, reinit the driver");
+    }
+    route(configs);
+    forEachManager([&configs](OPCManager *manager, size_t i) { manager->reload(std::move(configs[i])); });
+}
+void OPCDriver::setCallback(SubscribeCallbackFunction callback)
+{
+    for (auto manager : Managers)
+    {
+        manager->setCallback(
+            new SubscribeCallback(callback, manager, Managers.size() > 1 ? &CallbackLock : nullptr));
+    }
+}
+void OPCDriver::subscribe()
+{
+    forEachManager([](OPCManager *manager, size_t) { manager->subscribe(); });
+}
+void OPCDriver::unsubscribe()
+{
+    forEachManager([](OPCManager *manager, size_t) { manager->unsubscribe(); });
+}
+void OPCDriver::close()
+{
+    // one after the other on the caller's thread, every close ends with a COPCClient::stop of its apartment
+    for (auto manager : Managers)
+    {
+        try
+        {
+            manager->close();
+        }
+        catch (OPCException ex)
+        {
+            printf("opc close failed: %ws\n", ex.reasonString().c_str());
+        }
+        delete manager;
+    }
+    Managers.clear();
+    unique_lock<shared_timed_mutex> lock(RouteLock);
+    Routes.clear();
+}
+
+static bool IsRunning(const OPCServerHealth &health) noexcept
+{
+    return health.state == OPCManagerStatus::CONNECTED && health.serverState == tagOPCSERVERSTATE::OPC_STATUS_RUNNING;
+}
+/// <summary>
+/// read the variables at indices of varParam, all routed to opc
+/// </summary>
+static EnumDrvRet ReadVariables(OPCManager *opc, const VariablesParameter *varParam, const vector<size_t> &indices)
+{
+    vector<uint8_t> buf;
+    for (size_t i : indices)
+    {
+        auto retryN = 0;
+        const auto var = varParam->variables[i];
+        const auto id = stoi(var.id);
+        // "cache", "device" or "maxAge:<ms>", the device is only read when the cached value is older than ms
+        DWORD maxAge_ms = COPCGroup::MAX_AGE_CACHE;
+        if (var.attributesLen > 0)
+        {
+            for (size_t j = 0; j < var.attributesLen; j++)
+            {
+                const auto attr = var.attributes[j];
+                if (strcmp(attr.name, "source") == 0)
+                {
+                    if (strcmp(attr.value, "device") == 0)
+                    {
+                        maxAge_ms = 0;
+                    }
+                    else if (strcmp(attr.value, "cache") == 0)
+                    {
+                        maxAge_ms = COPCGroup::MAX_AGE_CACHE;
+                    }
+                    else if (strncmp(attr.value, "maxAge:", 7) == 0)
+                    {
+                        maxAge_ms = strtoul(attr.value + 7, nullptr, 10);
+                    }
+                    break;
+                }
+            }
+        }
+    retryRead:
+        OPCItemData data;
+        const auto ret = opc->readMaxAge(id, data, maxAge_ms);
+        if (ret != 0)
+        {
+            if (ret == -2)
+            {
+                if (retryN < 1 && opc->checkServerStatus(true))
+                {
+                    retryN++;
+                    goto retryRead;
+                }
+                return EnumDrvRet::ENUMDRVRET_DisConnected;
+            }
+            return EnumDrvRet::ENUMDRVRET_ERROR;
+        }
+        *var.timestamp = ConvertFiletimeToLong(data.ftTimeStamp);
+        if (data.Error < 0)
+        {
+            *var.status = 0;
+        }
+        else
+        {
+            *var.status = ConvertOPCDataToByteArray(data, buf);
+        }
+        if (var.dataLength < buf.size())
+        {
+            return EnumDrvRet::ENUMDRVRET_ERROR;
+        }
+        memcpy(var.data, buf.data(), buf.size());
+    }
+    return EnumDrvRet::ENUMDRVRET_OK;
+}
+
 EnumDrvRet DriverCmd(const char *cmd, int *driverHandle, void *param)
 {
     try
@@ -933,10 +3363,20 @@ EnumDrvRet DriverCmd(const char *cmd, int *driverHandle, void *param)
             }
             string jsonPath = initParam->property[0].value;
             printf("json file path: %s\n", jsonPath.c_str());
-            OPCManager *opc = new OPCManager(jsonPath);
+            string tagTablePath;
+            for (int i = 1; i < initParam->propertyLen; i++)
+            {
+                const auto prop = initParam->property[i];
+                if (prop.name && prop.value && strcmp(prop.name, "TagTable") == 0)
+                {
+                    tagTablePath = prop.value;
+                }
+            }
+            OPCDriver *opc = new OPCDriver(jsonPath, tagTablePath);
+            size_t connected;
             try
             {
-                opc->connect();
+                connected = opc->connect();
             }
             catch (OPCException ex)
             {
@@ -945,10 +3385,16 @@ EnumDrvRet DriverCmd(const char *cmd, int *driverHandle, void *param)
             }
             *driverHandle = (int)opc;
             OPCMap.SetAt(*driverHandle, opc);
+            // the handle is valid either way, the watchdogs of the servers that are down keep reconnecting
+            const size_t servers = opc->getManagers().size();
+            if (connected < servers)
+            {
+                return connected > 0 ? EnumDrvRet::ENUMDRVRET_PartialOK : EnumDrvRet::ENUMDRVRET_DisConnected;
+            }
         }
         else if (cmdStr == "Read")
         {
-            OPCManager *opc;
+            OPCDriver *opc;
             if (!OPCMap.Lookup(*driverHandle, opc))
             {
                 return EnumDrvRet::ENUMDRVRET_ERROR;
@@ -958,67 +3404,61 @@ EnumDrvRet DriverCmd(const char *cmd, int *driverHandle, void *param)
             {
                 return EnumDrvRet::ENUMDRVRET_ERROR;
             }
-            vector<uint8_t> buf;
+            // variables grouped by the server they are routed to, in the order of their first appearance
+            vector<pair<OPCManager *, vector<size_t>>> batches;
             for (size_t i = 0; i < varParam->length; i++)
             {
-                auto retryN = 0;
-                const auto var = varParam->variables[i];
-                const auto id = stoi(var.id);
-                auto source = OPCDATASOURCE::OPC_DS_CACHE;
-                if (var.attributesLen > 0)
+                OPCManager *manager = opc->getManager(stoi(varParam->variables[i].id));
+                if (!manager)
                 {
-                    for (size_t j = 0; j < var.attributesLen; j++)
-                    {
-                        const auto attr = var.attributes[j];
-                        if (strcmp(attr.name, "source") == 0)
-                        {
-                            if (strcmp(attr.value, "device") == 0)
-                            {
-                                source = OPCDATASOURCE::OPC_DS_DEVICE;
-                            }
-                            else if (strcmp(attr.value, "cache") == 0)
-                            {
-                                source = OPCDATASOURCE::OPC_DS_CACHE;
-                            }
-                            break;
-                        }
-                    }
-                }
-            retryRead:
-                OPCItemData data;
-                const auto ret = opc->read(id, data, source);
-                if (ret != 0)
-                {
-                    if (ret == -2)
-                    {
-                        if (retryN < 1 && opc->checkServerStatus(true))
-                        {
-                            retryN++;
-                            goto retryRead;
-                        }
-                        return EnumDrvRet::ENUMDRVRET_DisConnected;
-                    }
                     return EnumDrvRet::ENUMDRVRET_ERROR;
                 }
-                *var.timestamp = ConvertFiletimeToLong(data.ftTimeStamp);
-                if (data.Error < 0)
-                {
-                    *var.status = 0;
-                }
-                else
+                auto batch =
+                    find_if(batches.begin(), batches.end(), [manager](const auto &b) { return b.first == manager; });
+                if (batch == batches.end())
                 {
-                    *var.status = ConvertOPCDataToByteArray(data, buf);
+                    batches.emplace_back(manager, vector<size_t>());
+                    batch = batches.end() - 1;
                 }
-                if (var.dataLength < buf.size())
+                batch->second.push_back(i);
+            }
+            // the servers are read at the same time, each batch on its own thread
+            vector<EnumDrvRet> results(batches.size(), EnumDrvRet::ENUMDRVRET_OK);
+            vector<thread> workers;
+            for (size_t b = 1; b < batches.size(); ++b)
+            {
+                workers.emplace_back([&batches, &results, varParam, b]() {
+                    const HRESULT initResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+                    try
+                    {
+                        results[b] = ReadVariables(batches[b].first, varParam, batches[b].second);
+                    }
+                    catch (...)
+                    {
+                        results[b] = EnumDrvRet::ENUMDRVRET_ERROR;
+                    }
+                    if (SUCCEEDED(initResult))
+                    {
+                        CoUninitialize();
+                    }
+                });
+            }
+            results[0] = ReadVariables(batches[0].first, varParam, batches[0].second);
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+            for (auto result : results)
+            {
+                if (result != EnumDrvRet::ENUMDRVRET_OK)
                 {
-                    return EnumDrvRet::ENUMDRVRET_ERROR;
+                    return result;
                 }
-                memcpy(var.data, buf.data(), buf.size());
             }
         }
         else if (cmdStr == "Write")
         {
-            OPCManager *opc;
+            OPCDriver *opc;
             if (!OPCMap.Lookup(*driverHandle, opc))
             {
                 return EnumDrvRet::ENUMDRVRET_ERROR;
@@ -1026,25 +3466,28 @@ EnumDrvRet DriverCmd(const char *cmd, int *driverHandle, void *param)
             auto retryN = 0;
             const VariableParameter *varParam = static_cast<VariableParameter *>(param);
             const auto id = stoi(varParam->id);
-        retryWrite:
-            const auto item = opc->getItem(id);
-            if (!item)
+            OPCManager *manager = opc->getManager(id);
+            if (!manager)
             {
                 return EnumDrvRet::ENUMDRVRET_ERROR;
             }
+        retryWrite:
             VARIANT value;
-            value.vt = item->getDataType();
+            if (!manager->getItemDataType(id, value.vt))
+            {
+                return EnumDrvRet::ENUMDRVRET_ERROR;
+            }
             const auto cvRet = ConvertByteArrayToOPCData(varParam->data, &value);
             if (!cvRet)
             {
                 return EnumDrvRet::ENUMDRVRET_ERROR;
             }
-            const auto ret = opc->write(id, value);
+            const auto ret = manager->write(id, value);
             if (ret != 0)
             {
                 if (ret == -2)
                 {
-                    if (retryN < 1 && opc->checkServerStatus(true))
+                    if (retryN < 1 && manager->checkServerStatus(true))
                     {
                         retryN++;
                         goto retryWrite;
@@ -1056,18 +3499,16 @@ EnumDrvRet DriverCmd(const char *cmd, int *driverHandle, void *param)
         }
         else if (cmdStr == "SubscribeCallBack")
         {
-            OPCManager *opc;
+            OPCDriver *opc;
             if (!OPCMap.Lookup(*driverHandle, opc))
             {
                 return EnumDrvRet::ENUMDRVRET_ERROR;
             }
-            SubscribeCallbackFunction callbackFunc = static_cast<SubscribeCallbackFunction>(param);
-            SubscribeCallback *callback = new SubscribeCallback(callbackFunc, opc);
-            opc->setCallback(callback);
+            opc->setCallback(static_cast<SubscribeCallbackFunction>(param));
         }
         else if (cmdStr == "Subscribe" || cmdStr == "EnableSubscribe")
         {
-            OPCManager *opc;
+            OPCDriver *opc;
             if (!OPCMap.Lookup(*driverHandle, opc))
             {
                 return EnumDrvRet::ENUMDRVRET_ERROR;
@@ -1076,24 +3517,74 @@ EnumDrvRet DriverCmd(const char *cmd, int *driverHandle, void *param)
         }
         else if (cmdStr == "UnSubscribe")
         {
-            OPCManager *opc;
+            OPCDriver *opc;
             if (!OPCMap.Lookup(*driverHandle, opc))
             {
                 return EnumDrvRet::ENUMDRVRET_ERROR;
             }
             opc->unsubscribe();
         }
+        else if (cmdStr == "ReloadConfig")
+        {
+            OPCDriver *opc;
+            if (!OPCMap.Lookup(*driverHandle, opc))
+            {
+                return EnumDrvRet::ENUMDRVRET_ERROR;
+            }
+            opc->reload();
+        }
         else if (cmdStr == "GetStatus")
         {
-            OPCManager *opc;
+            OPCDriver *opc;
             if (!OPCMap.Lookup(*driverHandle, opc))
             {
                 return EnumDrvRet::ENUMDRVRET_ERROR;
             }
-            if (opc->checkServerStatus(true))
+            // the cached snapshots of the watchdogs, no server call on the caller's thread. The snapshot reported is
+            // the one of the first server that is not running, if any
+            const vector<OPCManager *> &managers = opc->getManagers();
+            if (managers.empty())
+            {
+                return EnumDrvRet::ENUMDRVRET_DisConnected;
+            }
+            OPCServerHealth health = managers[0]->getHealth();
+            size_t running = IsRunning(health) ? 1 : 0;
+            for (size_t i = 1; i < managers.size(); ++i)
+            {
+                const OPCServerHealth serverHealth = managers[i]->getHealth();
+                if (IsRunning(serverHealth))
+                {
+                    ++running;
+                }
+                else if (IsRunning(health))
+                {
+                    health = serverHealth;
+                }
+            }
+            if (param)
+            {
+                DriverStatusParameter *statusParam = static_cast<DriverStatusParameter *>(param);
+                statusParam->state = health.state;
+                statusParam->serverState = health.serverState;
+                statusParam->lastCheck = health.lastCheck;
+                statusParam->rtt_us = health.rtt_us;
+                statusParam->switchovers = 0;
+                statusParam->switchover_us = 0;
+                for (auto manager : managers)
+                {
+                    statusParam->switchovers += manager->getSwitchovers();
+                    statusParam->switchover_us =
+                        (std::max)(statusParam->switchover_us, manager->getSwitchoverTime_us());
+                }
+            }
+            if (running == managers.size())
             {
                 return EnumDrvRet::ENUMDRVRET_OK;
             }
+            else if (running > 0)
+            {
+                return EnumDrvRet::ENUMDRVRET_PartialOK;
+            }
             else
             {
                 return EnumDrvRet::ENUMDRVRET_DisConnected;
@@ -1101,7 +3592,7 @@ EnumDrvRet DriverCmd(const char *cmd, int *driverHandle, void *param)
         }
         else if (cmdStr == "CloseDriver")
         {
-            OPCManager *opc;
+            OPCDriver *opc;
             if (!OPCMap.Lookup(*driverHandle, opc))
             {
                 return EnumDrvRet::ENUMDRVRET_ERROR;
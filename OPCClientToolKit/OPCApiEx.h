@@ -2,8 +2,18 @@
 
 #include "OPCClient.h"
 #include "OPCClientToolKitDLL.h"
+#include "OPCConfig.h"
 #include "OPCHost.h"
 #include "OPCItem.h"
+#include "OPCNameSpaceSnapshot.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 using namespace std;
 
 enum OPCDACLIENT_API EnumDrvRet
@@ -26,6 +36,7 @@ extern "C"
     /*							"UnSubscribe"-ȡ,
     /*							"SubscribeCallBack"-Ļص,
     /*							"GetStatus"-ȡ״̬,
+    /*							"ReloadConfig"-¼,
     /*			driverHandle()-"InitDriver"int*(½)
     /*								     int*(Ҫʵ)
     /*			request()-"InitDriver",((void*)request)InitDriverParameter*(ͨѶָ)
@@ -36,7 +47,8 @@ extern "C"
     /*								"Subscribe",((void*)request)VariablesParameter*(ĴĿָ)
     /*								"UnSubscribe",((void*)request)VariablesParameter*(ĴĿָ)
     /* "SubscribeCallBack",((void*)request)void*(صָ)ݸʽ-VariableParameter
-    /*								"GetStatus",paramЧ,ΪNULL
+    /*								"GetStatus",((void*)request)DriverStatusParameter*(״̬,ΪNULL)
+    /*								"ReloadConfig",paramЧ,ΪNULL
     /*								"CloseDriver",paramЧ,ΪNULL
     /*[ֵ]ɹ
     /**********************************************************************/
@@ -75,29 +87,166 @@ struct OPCDACLIENT_API VariablesParameter
     VariableParameter *variables;
 };
 
+// health snapshot published by the watchdog of a driver, filled by "GetStatus" without any server call
+struct OPCDACLIENT_API DriverStatusParameter
+{
+    int state;       // OPCManagerStatus
+    int serverState; // OPCSERVERSTATE of the last status check, 0 before the first one
+    uint64_t lastCheck; // time of the last successful status check, same unit as VariableParameter::timestamp
+    uint32_t rtt_us;    // round trip of that check
+    uint32_t switchovers;   // switchovers to the hot standby of a redundant pair since InitDriver
+    uint32_t switchover_us; // duration of the last one, the longest over the servers of the driver
+};
+
 typedef void (*SubscribeCallbackFunction)(const VariableParameter *variableParameter);
 class SubscribeCallback : public IAsyncDataCallback
 {
   private:
     SubscribeCallbackFunction Callback;
     OPCManager *Manager;
+    // shared by the callbacks of all servers of a driver, so that the changes of one OnDataChange reach the caller
+    // as one batch and never interleave with those of another server
+    mutex *StreamLock;
 
   protected:
     friend class OPCManager;
 
   public:
-    SubscribeCallback(SubscribeCallbackFunction callback, OPCManager *manager) noexcept
+    SubscribeCallback(SubscribeCallbackFunction callback, OPCManager *manager, mutex *streamLock = nullptr) noexcept
     {
         Callback = callback;
         Manager = manager;
+        StreamLock = streamLock;
     }
     ~SubscribeCallback()
     {
         Callback = nullptr;
         Manager = nullptr;
+        StreamLock = nullptr;
     }
 
     void OnDataChange(COPCGroup &group, COPCItemDataMap &changes);
+    /// <summary>
+    /// buffered items: every sample reaches the caller, in the order the server sent them
+    /// </summary>
+    bool OnDataSamples(COPCGroup &group, COPCItemDataMap &changes, vector<OPCItemData> &samples);
+
+  private:
+    void publish(OPCItemData &data);
+};
+/// <summary>
+/// passes IOPCShutdown requests of the server to its manager
+/// </summary>
+class ShutdownCallback : public IShutdownCallback
+{
+  private:
+    OPCManager *Manager;
+
+  public:
+    ShutdownCallback(OPCManager *manager) noexcept
+    {
+        Manager = manager;
+    }
+
+    void OnShutdown(COPCServer &server, const wstring &reason);
+};
+/// <summary>
+/// demand state of one item, guarded by OPCManager::DemandLock
+/// </summary>
+struct OPCItemDemand
+{
+    // steady clock ms of the last read
+    int64_t lastUse_ms;
+    bool active;
+    // kept active while its group streams to the subscription callback
+    bool pinned;
+    // waiting in OPCManager::ActivateQueue
+    bool queued;
+};
+/// <summary>
+/// one configured group, split into server groups (shards) of at most OPCJson::maxGroupItems items with the same
+/// update rate and dead band
+/// </summary>
+struct OPCManagerGroup
+{
+    vector<COPCGroup *> shards;
+    // fast tier, items that change much more often than the rest of their shard are moved here by the adaptive
+    // update rate controller, and back once they calm down
+    vector<COPCGroup *> fastShards;
+};
+/// <summary>
+/// OnDataChange statistics of one shard over a controller window
+/// </summary>
+struct OPCShardStats
+{
+    uint64_t callbacks;
+    uint64_t changes;
+    // sum of receive time minus source timestamp over all changes
+    uint64_t latencySum_ms;
+};
+/// <summary>
+/// one server group of a session plan
+/// </summary>
+struct OPCPlanShard
+{
+    // index of the configured group in OPCManager::Config.groups
+    size_t group;
+    bool fast;
+    // server group name, update rate, dead band, subscription and items (client ids and names)
+    OPCJsonGroup json;
+    // json.items[0, activeItems) were active
+    size_t activeItems;
+    // json.updateRate was set by the adaptive update rate controller
+    bool rateAdjusted;
+};
+/// <summary>
+/// layout of a live session, compiled from it so that a reconnect replays it without the config file
+/// </summary>
+struct OPCSessionPlan
+{
+    vector<OPCPlanShard> shards;
+    bool subscribed;
+};
+/// <summary>
+/// hot standby of a redundant pair: the session of a plan pre-built on the other server, its groups inactive and its
+/// items registered. A switchover activates the groups and takes the standby as the live session
+/// </summary>
+struct OPCStandbySession
+{
+    COPCHost *host;
+    vector<COPCServer *> sessions;
+    OPCSessionPlan plan;
+    // shards[i] was made for plan.shards[i]
+    vector<COPCGroup *> shards;
+    vector<OPCManagerGroup> groups;
+    vector<COPCGroup *> subscribeGroups;
+    unordered_map<COPCGroup *, DWORD> shardRates;
+    vector<pair<int, COPCItem *>> items;
+    vector<bool> active;
+};
+/// <summary>
+/// result of the last watchdog check, published as one atomic value
+/// </summary>
+struct OPCServerHealth
+{
+    uint64_t lastCheck;
+    uint32_t rtt_us;
+    uint16_t state;
+    uint16_t serverState;
+};
+/// <summary>
+/// makes the host object of a host name, the servers of the manager are connected through it
+/// </summary>
+typedef function<COPCHost *(const wstring &hostName)> OPCHostFactory;
+/// <summary>
+/// items of the config a namespace change touched, a reload limited to them leaves every other item as it is
+/// </summary>
+struct OPCReloadScope
+{
+    // appeared or changed type on the server, (re)added
+    unordered_set<wstring> add;
+    // gone from the server, removed and not added again
+    unordered_set<wstring> remove;
 };
 enum OPCManagerStatus
 {
@@ -111,41 +260,212 @@ class OPCManager
   private:
     OPCManagerStatus Status;
     string JsonFile;
+    // optional compiled tag table cache of JsonFile
+    string TagTableFile;
+    // entry of the server in the config, 0 unless the config has several servers
+    size_t ServerIndex;
+    // serializes connect, reconnect, reload, rate moves and close of this manager, the managers of a driver recover
+    // independently
+    mutex SessionLock;
+    // COPCClient::makeHost unless replaced, e.g. by a host of in-process servers
+    OPCHostFactory HostFactory;
     COPCHost *Host;
+    // pooled connections to the server, groups are spread over them and I/O runs on the session of the group.
+    // Server is Sessions[0], used for status checks
+    vector<COPCServer *> Sessions;
     COPCServer *Server;
+    // config the live groups were created from, Groups[i] belongs to Config.groups[i]
+    OPCJson Config;
+    // items of Config with a SamplingRate or Buffered, by id. Rebuilt with Config and guarded by SessionLock like it
+    unordered_map<int, OPCJsonItem> SampledItems;
+    // redundant pair: the live session runs on Config.secondaryServer, the standby (if built) on Config.server.
+    // Guarded by SessionLock like Standby
+    bool OnSecondary;
+    OPCStandbySession *Standby;
+    // changes whenever the live layout does, a standby built from an older plan is dropped
+    uint64_t SessionVersion;
+    // Config.secondaryServer is set
+    atomic<bool> Redundant;
+    // only used by the watchdog, a failed standby build backs off like a reconnect
+    DWORD StandbyBackoff_ms;
+    int64_t NextStandby_ms;
+    atomic<uint32_t> Switchovers;
+    atomic<uint32_t> Switchover_us;
+    vector<OPCManagerGroup> Groups;
+    // shards of the groups with IsSubscribe set
     vector<COPCGroup *> SubscribeGroups;
     CAtlMap<int, COPCItem *> ItemMap;
-    CAtlMap<OPCHANDLE, int> ItemRevoteMap;
+    CAtlMap<const COPCItem *, int> ItemRevoteMap;
+    // held shared while an item of ItemMap is in use, exclusive while the item maps change
+    mutable shared_timed_mutex ItemLock;
+    // subscribe() is in effect, groups created by a reload start streaming right away
+    bool Subscribed;
     SubscribeCallback *Callback;
+    // advised on every server connection, a shutdown request starts the reconnect right away
+    ShutdownCallback ShutdownHandler;
+    // demand driven activation, only used when Config.itemIdleTimeout is set. Lock order: ItemLock, DemandLock
+    unsigned long IdleTimeout_ms;
+    unordered_map<COPCItem *, OPCItemDemand> Demand;
+    vector<COPCItem *> ActivateQueue;
+    mutex DemandLock;
+    condition_variable DemandSignal;
+    thread DemandThread;
+    bool DemandStop;
+    // adaptive update rate controller, only used when Config.maxUpdateRate is set
+    atomic<bool> RateControl;
+    mutex StatsLock;
+    unordered_map<COPCGroup *, OPCShardStats> ShardStats;
+    unordered_map<const COPCItem *, uint32_t> ItemChanges;
+    // update rate of the shards the controller changed, guarded by SessionLock like Groups
+    unordered_map<COPCGroup *, DWORD> ShardRates;
+    mutex RateLock;
+    condition_variable RateSignal;
+    thread RateThread;
+    bool RateStop;
+    // notified whenever Status changes through setStatus, failed reconnects back off exponentially
+    mutex ReconnectLock;
+    condition_variable ReconnectSignal;
+    DWORD ReconnectBackoff_ms;
+    int64_t NextReconnect_ms;
+    // health watchdog, the only thread that checks the server and reconnects. Callers that need a fresh verdict
+    // bump CheckRequests and wait until ChecksDone catches up
+    atomic<OPCServerHealth> Health;
+    unsigned long StatusInterval_ms;
+    mutex WatchdogLock;
+    condition_variable WatchdogSignal;
+    thread WatchdogThread;
+    bool WatchdogStop;
+    uint64_t CheckRequests;
+    uint64_t ChecksDone;
+    // sessions whose server announced its shutdown, posted by the COM thread and handled by the watchdog. Only
+    // compared against Sessions, never dereferenced
+    vector<const COPCServer *> ShutdownRequests;
+
+    void setStatus(OPCManagerStatus status);
+    OPCJson loadConfig();
+    /// <summary>
+    /// connect host and sessionCount sessions to server and wait for it to report running, polling with backoff.
+    /// health is filled once the server answered, connections made before a failure are left to the caller
+    /// </summary>
+    void connectServer(const wstring &hostName, const wstring &serverName, size_t sessionCount, bool requireRunning,
+                       COPCHost *&host, vector<COPCServer *> &sessions, OPCServerHealth &health);
+    /// <summary>
+    /// connect Host and the Sessions of the live session, on the secondary server while OnSecondary
+    /// </summary>
+    void openServer(const OPCJson &json, bool requireRunning);
+    void capturePlan(OPCSessionPlan &plan);
+    /// <summary>
+    /// replace Config, SampledItems follows it
+    /// </summary>
+    void setConfig(OPCJson &&config);
+    /// <summary>
+    /// config entry of a live item, with the sampling options it was configured with
+    /// </summary>
+    OPCJsonItem jsonItem(int id, const COPCItem *item) const;
+    /// <summary>
+    /// rebuild the session of the plan on a new server connection through the bulk item paths, the old session is
+    /// kept mapped until the new one replaces it in one step. On failure the old session is left in place
+    /// </summary>
+    void replayPlan(const OPCSessionPlan &plan);
+    void replaceItems(const vector<pair<int, COPCItem *>> &items, const vector<bool> &active,
+                      vector<COPCItem *> &previous);
+    bool tryReconnect();
+    /// <summary>
+    /// pre-build the hot standby on the other server from the plan of the live session, SessionLock is only held
+    /// while the plan is captured and the standby installed
+    /// </summary>
+    void buildStandby();
+    void dropStandby(bool serverAlive);
+    /// <summary>
+    /// make the standby the live session: activate its groups, one SetState each, and swap its items in. returns
+    /// false if the standby server is not running, the standby is dropped then
+    /// </summary>
+    bool switchover();
+    void publishHealth(const OPCServerHealth &health);
+    void startWatchdog();
+    void stopWatchdog();
+    void watchdogWorker();
+    /// <summary>
+    /// one watchdog pass: GetStatus round trip, reconnect with backoff if the server is lost
+    /// </summary>
+    void checkHealth();
+    /// <summary>
+    /// mark the session disconnected if one of the servers is still a live session, the watchdog then reconnects
+    /// </summary>
+    void handleShutdown(const vector<const COPCServer *> &servers);
+    void mapItems(const vector<pair<int, COPCItem *>> &items, bool active);
+    void unmapItems(const vector<COPCItem *> &items);
+    /// <summary>
+    /// record a read of the item, returns false if the item is not active yet and queues its activation
+    /// </summary>
+    bool touchItem(COPCItem *item);
+    /// <summary>
+    /// pin the items of the groups active while they stream, or release them to the idle timeout
+    /// </summary>
+    void pinGroupItems(const vector<COPCGroup *> &groups, bool pin);
+    void setItemsActive(const vector<COPCItem *> &items, bool active, vector<COPCItem *> &failed);
+    void startDemandThread();
+    void stopDemandThread();
+    void demandWorker();
+    void startRateThread();
+    void stopRateThread();
+    void rateWorker();
+    /// <summary>
+    /// one controller pass: change shard update rates within the configured bounds and move diverging items
+    /// between the rate tiers of their group
+    /// </summary>
+    void adjustRates();
+    /// <summary>
+    /// move items to new shards of the other tier of group, returns false if nothing moved
+    /// </summary>
+    bool moveItems(size_t group, const vector<COPCItem *> &items, bool toFast,
+                   const unordered_map<COPCGroup *, vector<COPCItem *>> &shardMembers);
+    /// <summary>
+    /// delete all groups and items and release the server. With a live server every group costs one RemoveItems
+    /// and one RemoveGroup call, otherwise nothing is sent to it
+    /// </summary>
+    void destroySession(bool serverAlive);
 
   public:
-    OPCManager(const string &jsonFile) noexcept
+    OPCManager(const string &jsonFile, const string &tagTableFile = string(), size_t serverIndex = 0) noexcept
+        : HostFactory(COPCClient::makeHost), ShutdownHandler(this)
     {
         JsonFile = jsonFile;
+        TagTableFile = tagTableFile;
+        ServerIndex = serverIndex;
+        OnSecondary = false;
+        Standby = nullptr;
+        SessionVersion = 0;
+        Redundant = false;
+        StandbyBackoff_ms = 0;
+        NextStandby_ms = 0;
+        Switchovers = 0;
+        Switchover_us = 0;
         Status = OPCManagerStatus::STOP;
         Host = nullptr;
         Server = nullptr;
+        Subscribed = false;
         Callback = nullptr;
+        IdleTimeout_ms = 0;
+        DemandStop = false;
+        RateControl = false;
+        RateStop = false;
+        ReconnectBackoff_ms = 0;
+        NextReconnect_ms = 0;
+        Health = OPCServerHealth{0, 0, OPCManagerStatus::STOP, 0};
+        StatusInterval_ms = 1000;
+        WatchdogStop = false;
+        CheckRequests = 0;
+        ChecksDone = 0;
     }
     ~OPCManager()
     {
         close();
-
-        SubscribeGroups.clear();
-        try
-        {
-            ItemMap.RemoveAll();
-            ItemRevoteMap.RemoveAll();
-        }
-        catch (...)
-        {
-        }
-        Server = nullptr;
-        Host = nullptr;
     }
 
     COPCItem *getItem(int id)
     {
+        shared_lock<shared_timed_mutex> lock(ItemLock);
         COPCItem *data;
         if (ItemMap.Lookup(id, data))
         {
@@ -153,21 +473,108 @@ class OPCManager
         }
         return nullptr;
     }
-    bool getItemId(OPCHANDLE item, int &id)
+    bool getItemDataType(int id, VARTYPE &type)
+    {
+        shared_lock<shared_timed_mutex> lock(ItemLock);
+        COPCItem *data;
+        if (ItemMap.Lookup(id, data))
+        {
+            type = data->getDataType();
+            return true;
+        }
+        return false;
+    }
+    bool getItemId(const COPCItem *item, int &id)
     {
+        shared_lock<shared_timed_mutex> lock(ItemLock);
         return ItemRevoteMap.Lookup(item, id);
     }
 
+    /// <summary>
+    /// feed the update rate controller, called by the subscription callback
+    /// </summary>
+    void recordChanges(COPCGroup &group, COPCItemDataMap &changes);
+    /// <summary>
+    /// the server announced its shutdown: stop using it and wake the watchdog to reconnect
+    /// </summary>
+    void onServerShutdown(COPCServer &server, const wstring &reason);
+
     void connect();
-    void reconnect();
+    /// <summary>
+    /// connect with the already loaded config entry of the server
+    /// </summary>
+    void connect(OPCJson json);
+    /// <summary>
+    /// first connect of a driver, then start the watchdog whatever the result. A manager whose server is down stays
+    /// disconnected and the watchdog keeps retrying, returns false in that case
+    /// </summary>
+    bool start(OPCJson json);
+    /// <summary>
+    /// replay the session plan of the lost connection, or start over from the config file if replay is false
+    /// </summary>
+    void reconnect(bool replay = true);
+    /// <summary>
+    /// body of reconnect, the caller holds SessionLock and has set the status to DISCONNECTED. A fresh connect uses
+    /// config instead of the config file if it is set
+    /// </summary>
+    void reconnectSession(bool replay, OPCJson *config = nullptr);
+    /// <summary>
+    /// re-read the config and apply only the differences to the live session: add and remove items, create and
+    /// remove groups, change update rate and dead band in place. Untouched groups keep streaming.
+    /// </summary>
+    void reload();
+    /// <summary>
+    /// apply config, with a scope only to the items named in it
+    /// </summary>
+    void reload(OPCJson config, const OPCReloadScope *scope = nullptr);
+    /// <summary>
+    /// apply a namespace diff of the server to the live config: configured items that disappeared are removed, those
+    /// that appeared or changed type are added again. No other item is touched
+    /// </summary>
+    void reload(const NameSpaceDiff &diff);
+    /// <summary>
+    /// browse the namespace of the live server, diff it against snapshot and reload the differences. snapshot is
+    /// replaced by the new one, an empty snapshot is only filled. The browse runs on a session of its own, if the
+    /// live session changes meanwhile it throws and snapshot is left as it is
+    /// </summary>
+    NameSpaceDiff reloadNameSpace(COPCNameSpaceSnapshot &snapshot);
+    /// <summary>
+    /// true if the last watchdog check found the server running. With retryConnect the watchdog checks right away,
+    /// reconnecting if needed, and the caller waits for its verdict
+    /// </summary>
     bool checkServerStatus(bool retryConnect);
+    OPCServerHealth getHealth() const
+    {
+        return Health.load();
+    }
+    uint32_t getSwitchovers() const
+    {
+        return Switchovers.load();
+    }
+    uint32_t getSwitchoverTime_us() const
+    {
+        return Switchover_us.load();
+    }
 
     void read(const vector<int> &itemIds, vector<OPCItemData> &data);
 
     int read(int itemId, OPCItemData &value, OPCDATASOURCE source);
+    /// <summary>
+    /// read from the server cache if its value is at most maxAge_ms old, from the device otherwise.
+    /// 0 reads the device, COPCGroup::MAX_AGE_CACHE the cache
+    /// </summary>
+    int readMaxAge(int itemId, OPCItemData &value, DWORD maxAge_ms);
 
     int OPCManager::write(int itemId, VARIANT data);
 
+    /// <summary>
+    /// replace the host factory, only before the first connect
+    /// </summary>
+    void setHostFactory(OPCHostFactory factory)
+    {
+        HostFactory = std::move(factory);
+    }
+
     void setCallback(SubscribeCallback *callback) noexcept
     {
         if (Callback)
@@ -183,7 +590,65 @@ class OPCManager
 
     void close();
 };
-static CAtlMap<int, OPCManager *> OPCMap;
+/// <summary>
+/// the servers of one driver handle, one manager per server entry of the config. Variable ids are unique over all
+/// servers, reads and writes are routed by id and run concurrently on the servers involved. Every manager keeps its
+/// own watchdog, so servers recover independently of each other
+/// </summary>
+class OPCDriver
+{
+  private:
+    string JsonFile;
+    string TagTableFile;
+    vector<OPCManager *> Managers;
+    // variable id to its manager, exclusive while a reload changes it
+    unordered_map<int, OPCManager *> Routes;
+    mutable shared_timed_mutex RouteLock;
+    // serializes the subscription callbacks of all managers into one stream
+    mutex CallbackLock;
+
+    void route(const vector<OPCJson> &configs);
+    /// <summary>
+    /// run task on every manager, on a thread each when there are several. Rethrows the first failure
+    /// </summary>
+    void forEachManager(const function<void(OPCManager *, size_t)> &task);
+
+  public:
+    OPCDriver(const string &jsonFile, const string &tagTableFile = string()) noexcept
+    {
+        JsonFile = jsonFile;
+        TagTableFile = tagTableFile;
+    }
+    ~OPCDriver()
+    {
+        close();
+    }
+
+    /// <summary>
+    /// load the config once and connect all servers in parallel. A server that is down does not fail the driver, its
+    /// watchdog keeps reconnecting. Returns the number of servers connected
+    /// </summary>
+    size_t connect();
+    OPCManager *getManager(int id) const
+    {
+        shared_lock<shared_timed_mutex> lock(RouteLock);
+        const auto route = Routes.find(id);
+        return route == Routes.end() ? nullptr : route->second;
+    }
+    const vector<OPCManager *> &getManagers() const
+    {
+        return Managers;
+    }
+    /// <summary>
+    /// re-read the config once and reload every server with its entry. The number of servers can not change
+    /// </summary>
+    void reload();
+    void setCallback(SubscribeCallbackFunction callback);
+    void subscribe();
+    void unsubscribe();
+    void close();
+};
+static CAtlMap<int, OPCDriver *> OPCMap;
 
 /* OPC DA Quality Codes
 0
@@ -0,0 +1,269 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <thread>
+
+#include "OPCBrowseCrawler.h"
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+namespace opcda_client
+{
+#endif
+
+/**
+ * sort and drop duplicates, servers may show one item under several branches
+ */
+static void SortUnique(std::vector<std::wstring> &itemIds)
+{
+    std::sort(itemIds.begin(), itemIds.end());
+    itemIds.erase(std::unique(itemIds.begin(), itemIds.end()), itemIds.end());
+
+} // SortUnique
+
+static double ItemRate(size_t count, std::chrono::steady_clock::time_point started)
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return seconds > 0 ? count / seconds : 0;
+
+} // ItemRate
+
+COPCBrowseCrawler::COPCBrowseCrawler(size_t threads)
+    : Threads(threads ? threads : 1), Outstanding(0), Queued(0), Sessions(0), StartFailed(false), ItemsPerSecond(0)
+{
+} // COPCBrowseCrawler::COPCBrowseCrawler
+
+bool COPCBrowseCrawler::takeBranch(size_t self, Branch &branch)
+{
+    {
+        Worker &own = *Workers[self];
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (!own.branches.empty())
+        {
+            branch = std::move(own.branches.back());
+            own.branches.pop_back();
+            return true;
+        } // if
+    }
+
+    // steal the oldest branch of another thread, the one closest to the root and likely the largest subtree
+    for (size_t i = 1; i < Workers.size(); ++i)
+    {
+        Worker &victim = *Workers[(self + i) % Workers.size()];
+        std::lock_guard<std::mutex> lock(victim.lock);
+        if (!victim.branches.empty())
+        {
+            branch = std::move(victim.branches.front());
+            victim.branches.pop_front();
+            return true;
+        } // if
+    }     // for
+
+    return false;
+
+} // COPCBrowseCrawler::takeBranch
+
+void COPCBrowseCrawler::browse(size_t self, COPCServer &server, const BrowseOptions &options)
+{
+    Worker &worker = *Workers[self];
+    Branch branch;
+    for (;;)
+    {
+        // read before looking at the queues, a branch queued after that wakes the wait below
+        size_t queued = Queued;
+        if (!takeBranch(self, branch))
+        {
+            // the other threads are still browsing and may queue more branches
+            std::unique_lock<std::mutex> idle(IdleLock);
+            BranchQueued.wait(idle, [this, queued]() { return !Outstanding || Queued != queued; });
+            if (!Outstanding)
+            {
+                break;
+            }
+            continue;
+        } // if
+
+        std::vector<std::wstring> branchIds;
+        bool browsed = false;
+        try
+        {
+            browsed = server.browseLevel(branch.id, branch.depth, options, worker.itemIds, branchIds);
+        }
+        catch (OPCException &e)
+        {
+            printf("COPCBrowseCrawler::browse: %ws\n", e.reasonString().c_str());
+        }
+
+        if (!browsed && branch.depth == 1)
+        {
+            StartFailed = true;
+        }
+
+        // count the sub branches before the branch is done, so that Outstanding does not drop to 0 in between
+        if (!branchIds.empty())
+        {
+            Outstanding += branchIds.size();
+            {
+                std::lock_guard<std::mutex> lock(worker.lock);
+                for (std::wstring &id : branchIds)
+                {
+                    worker.branches.push_back(Branch{std::move(id), branch.depth + 1});
+                }
+            }
+            {
+                std::lock_guard<std::mutex> idle(IdleLock);
+                ++Queued;
+            }
+            BranchQueued.notify_all();
+        } // if
+
+        if (--Outstanding == 0)
+        {
+            {
+                // a thread between its check and its wait holds the lock, the notify cannot slip in before it sleeps
+                std::lock_guard<std::mutex> idle(IdleLock);
+            }
+            BranchQueued.notify_all();
+        } // if
+    } // for
+
+} // COPCBrowseCrawler::browse
+
+void COPCBrowseCrawler::runWorker(size_t self, const ConnectFunction &connect, bool owned,
+                                  const BrowseOptions &options)
+{
+    bool initialised = false;
+    COPCServer *server = nullptr;
+    try
+    {
+        initialised = COPCClient::init(MULTITHREADED);
+        server = connect();
+    }
+    catch (OPCException &e)
+    {
+        printf("COPCBrowseCrawler::runWorker: %ws\n", e.reasonString().c_str());
+    }
+
+    if (server)
+    {
+        ++Sessions;
+        browse(self, *server, options);
+        SortUnique(Workers[self]->itemIds);
+        if (owned)
+        {
+            delete server;
+        }
+    } // if
+
+    if (initialised)
+    {
+        COPCClient::stop();
+    }
+
+} // COPCBrowseCrawler::runWorker
+
+bool COPCBrowseCrawler::run(const ConnectFunction &connect, bool owned, const BrowseOptions &options,
+                            std::vector<std::wstring> &itemIds)
+{
+    auto started = std::chrono::steady_clock::now();
+    Workers.clear();
+    for (size_t i = 0; i < Threads; ++i)
+    {
+        Workers.emplace_back(new Worker());
+    }
+
+    Outstanding = 1;
+    Queued = 0;
+    Sessions = 0;
+    StartFailed = false;
+    Workers.front()->branches.push_back(Branch{options.startBranch, 1});
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < Threads; ++i)
+    {
+        threads.emplace_back(&COPCBrowseCrawler::runWorker, this, i, std::cref(connect), owned, std::cref(options));
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    if (!Sessions || StartFailed)
+    {
+        Workers.clear();
+        return false;
+    } // if
+
+    // each thread sorted its own ids
+    std::vector<std::wstring> merged;
+    for (std::unique_ptr<Worker> &worker : Workers)
+    {
+        std::vector<std::wstring> next;
+        next.reserve(merged.size() + worker->itemIds.size());
+        std::merge(std::make_move_iterator(merged.begin()), std::make_move_iterator(merged.end()),
+                   std::make_move_iterator(worker->itemIds.begin()), std::make_move_iterator(worker->itemIds.end()),
+                   std::back_inserter(next));
+        merged.swap(next);
+    } // for
+    Workers.clear();
+
+    merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+    ItemsPerSecond = ItemRate(merged.size(), started);
+    itemIds.insert(itemIds.end(), std::make_move_iterator(merged.begin()), std::make_move_iterator(merged.end()));
+    return true;
+
+} // COPCBrowseCrawler::run
+
+bool COPCBrowseCrawler::crawl(const ConnectFunction &connect, const BrowseOptions &options,
+                              std::vector<std::wstring> &itemIds)
+{
+    return run(connect, true, options, itemIds);
+
+} // COPCBrowseCrawler::crawl
+
+bool COPCBrowseCrawler::crawl(COPCServer &server, const BrowseOptions &options, std::vector<std::wstring> &itemIds)
+{
+    APTTYPE type = APTTYPE_CURRENT;
+    APTTYPEQUALIFIER qualifier = APTTYPEQUALIFIER_NONE;
+    if (Threads > 1 && options.useBrowse3 && server.hasBrowse3() &&
+        SUCCEEDED(CoGetApartmentType(&type, &qualifier)) && type == APTTYPE_MTA)
+    {
+        return run([&server] { return &server; }, false, options, itemIds);
+    } // if
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::wstring> found;
+    if (!server.browseItemNames(found, options))
+    {
+        return false;
+    }
+
+    SortUnique(found);
+    ItemsPerSecond = ItemRate(found.size(), started);
+    itemIds.insert(itemIds.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+    return true;
+
+} // COPCBrowseCrawler::crawl
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+} // namespace opcda_client
+#endif
@@ -0,0 +1,131 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#pragma once
+
+#pragma warning(disable : 4251) // can be ignored if deriving from a type in the Standard C++ Library..
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "OPCClient.h"
+#include "OPCClientToolKitDLL.h"
+#include "OPCServer.h"
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+namespace opcda_client
+{
+#endif
+
+/**
+ * Browses a namespace with several threads in the multithreaded apartment. Each thread browses branches from a queue
+ * of its own, newest first, and steals the oldest branch of another thread when its queue runs dry, so uneven
+ * subtrees keep all threads busy. The item ids found are merged into one sorted list without duplicates.
+ */
+class OPCDACLIENT_API COPCBrowseCrawler
+{
+  public:
+    /**
+     * makes the session a crawling thread browses through, called on that thread. Returns a server owned by the
+     * crawler, or null
+     */
+    typedef std::function<COPCServer *()> ConnectFunction;
+
+  private:
+    struct Branch
+    {
+        std::wstring id;
+        unsigned depth;
+    };
+
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<Branch> branches;
+        std::vector<std::wstring> itemIds;
+    };
+
+    size_t Threads;
+
+    std::vector<std::unique_ptr<Worker>> Workers;
+
+    /// branches queued or being browsed, the crawl is done when it drops to 0
+    std::atomic<size_t> Outstanding;
+
+    /// idle threads wait on BranchQueued until Queued moves or Outstanding drops to 0, IdleLock is taken after either
+    std::mutex IdleLock;
+    std::condition_variable BranchQueued;
+    std::atomic<size_t> Queued;
+
+    /// threads that got a session
+    std::atomic<size_t> Sessions;
+
+    std::atomic<bool> StartFailed;
+
+    double ItemsPerSecond;
+
+    bool takeBranch(size_t self, Branch &branch);
+
+    void browse(size_t self, COPCServer &server, const BrowseOptions &options);
+
+    void runWorker(size_t self, const ConnectFunction &connect, bool owned, const BrowseOptions &options);
+
+    bool run(const ConnectFunction &connect, bool owned, const BrowseOptions &options,
+             std::vector<std::wstring> &itemIds);
+
+  public:
+    explicit COPCBrowseCrawler(size_t threads = 4);
+
+    COPCBrowseCrawler(const COPCBrowseCrawler &) = delete;
+
+    COPCBrowseCrawler &operator=(const COPCBrowseCrawler &) = delete;
+
+    /**
+     * Crawl with one session per thread, each made by connect and deleted when the crawl is done. DA 2.0 servers
+     * keep one browse position per session, so this is the way to browse them in parallel.
+     * returns false if no session could be made or the start branch could not be browsed.
+     */
+    bool crawl(const ConnectFunction &connect, const BrowseOptions &options, std::vector<std::wstring> &itemIds);
+
+    /**
+     * Crawl through one session. The threads share it when the server supports IOPCBrowse, which has no browse
+     * position, and the calling thread is in the multithreaded apartment. Otherwise the calling thread browses alone.
+     */
+    bool crawl(COPCServer &server, const BrowseOptions &options, std::vector<std::wstring> &itemIds);
+
+    /**
+     * throughput of the last crawl in items per second
+     */
+    double getItemsPerSecond() const
+    {
+        return ItemsPerSecond;
+    }
+
+}; // COPCBrowseCrawler
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+} // namespace opcda_client
+#endif
@@ -18,6 +18,7 @@ Free Software Foundation, Inc., 59 Temple Place - Suite 330,
 Boston, MA  02111-1307, USA.
 */
 
+#include <mutex>
 #include <process.h>
 
 #include "OPCClient.h"
@@ -37,6 +38,9 @@ ATL::CComPtr<IMalloc> COPCClient::iMalloc;
 
 int COPCClient::ReleaseCount = 0;
 
+// guards iMalloc and ReleaseCount, several managers may connect on their own threads at once
+static std::mutex InitLock;
+
 bool COPCClient::init(OPCOLEInitMode mode)
 {
     HRESULT result = -1;
@@ -57,6 +61,7 @@ bool COPCClient::init(OPCOLEInitMode mode)
     CoInitializeSecurity(nullptr, -1, nullptr, nullptr, RPC_C_AUTHN_LEVEL_NONE, RPC_C_IMP_LEVEL_IMPERSONATE, nullptr,
                          EOAC_NONE, nullptr);
 
+    std::lock_guard<std::mutex> lock(InitLock);
     if (!iMalloc)
     {
         result = CoGetMalloc(MEMCTX_TASK, &iMalloc);
@@ -73,9 +78,12 @@ bool COPCClient::init(OPCOLEInitMode mode)
 
 void COPCClient::stop()
 {
-    if (--ReleaseCount <= 0)
     {
-        iMalloc.Release();
+        std::lock_guard<std::mutex> lock(InitLock);
+        if (--ReleaseCount <= 0)
+        {
+            iMalloc.Release();
+        }
     }
 
     CoUninitialize();
@@ -29,6 +29,7 @@ Boston, MA  02111-1307, USA.
 #include <atlstr.h>
 #include <objbase.h>
 #include <stdexcept>
+#include <vector>
 
 #include "OPCClientToolKitDLL.h"
 #include "OPCItemData.h"
@@ -79,8 +80,34 @@ class IAsyncDataCallback
   public:
     virtual void OnDataChange(COPCGroup &group, COPCItemDataMap &changes) = 0;
 
+    /**
+     * Called instead of OnDataChange() when one update carries several values of an item, as buffered items do
+     * (see COPCGroup::setItemsBuffered()). samples holds every value in the order the server sent them, oldest first
+     * per item; changes holds the newest value per item. Return false to receive changes through OnDataChange()
+     * instead, which the default does.
+     */
+    virtual bool OnDataSamples(COPCGroup &group, COPCItemDataMap &changes, std::vector<OPCItemData> &samples)
+    {
+        (void)group;
+        (void)changes;
+        (void)samples;
+        return false;
+    }
+
 }; // IAsyncDataCallback
 
+/**
+ * A server about to shut down calls IOPCShutdown::ShutdownRequest on the sink advised by the servers
+ * enableShutdownNotification() method, the request is delegated to an instance implementing this interface.
+ * It is called on a COM thread while the server is going down: it should only record the event, not call the server.
+ */
+class IShutdownCallback
+{
+  public:
+    virtual void OnShutdown(COPCServer &server, const std::wstring &reason) = 0;
+
+}; // IShutdownCallback
+
 /**
  * Starting point for 'everything'. Utility class that creates host objects and handles COM memory management.
  * Effectively a singleton.
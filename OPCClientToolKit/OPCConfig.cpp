@@ -0,0 +1,1045 @@
+#include "OPCConfig.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <unordered_set>
+using Json = nlohmann::json;
+using namespace std;
+
+static wstring ConvertUtf8ToWide(const string &str)
+{
+    if (str.empty())
+    {
+        return wstring();
+    }
+    const int length = MultiByteToWideChar(CP_UTF8, 0, str.data(), static_cast<int>(str.size()), nullptr, 0);
+    if (length <= 0)
+    {
+        throw OPCException(L"json string is not utf-8");
+    }
+    wstring wstr(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, str.data(), static_cast<int>(str.size()), &wstr[0], length);
+    return wstr;
+}
+
+/// <summary>
+/// tuning defaults of a server entry, keys missing from the json keep them
+/// </summary>
+static void SetDefaults(OPCJson &data)
+{
+    data.addItemsChunkSize = 1000;
+    data.addItemsConcurrency = 4;
+    data.itemIdleTimeout = 0;
+    data.maxGroupItems = 0;
+    data.minUpdateRate = 0;
+    data.maxUpdateRate = 0;
+    data.statusInterval = 1000;
+    data.sessions = 1;
+}
+
+/// <summary>
+/// fills OPCJson while the json text streams by, keeps only the scope stack and the current key
+/// </summary>
+class OPCJsonSaxHandler : public nlohmann::json_sax<Json>
+{
+  private:
+    enum class Scope
+    {
+        Root,
+        Servers,
+        // entry of the Servers array, takes the server keys of Root
+        Server,
+        Groups,
+        Group,
+        Variables,
+        Variable,
+    };
+    enum class ValueType
+    {
+        Null,
+        Boolean,
+        Integer,
+        Unsigned,
+        Float,
+        String,
+        // object or array where a scalar is expected
+        Structured,
+    };
+    struct Value
+    {
+        ValueType type;
+        bool boolean;
+        int64_t integer;
+        uint64_t unsignedInteger;
+        double floating;
+        string_t *str;
+    };
+
+    // one entry per server, the root itself is the only entry unless it has a Servers array
+    vector<OPCJson> &Servers;
+    vector<Scope> Scopes;
+    string_t Key;
+    // > 0 while inside a value of an unknown key
+    size_t SkipDepth;
+    bool HasHost, HasServer, HasGroups;
+    // the root has a Servers array, or server keys of its own
+    bool HasServers, HasServerFields;
+    bool HasGroupName, HasVariables;
+    bool HasId, HasName;
+
+    OPCJson &current()
+    {
+        return Servers.back();
+    }
+    OPCJsonGroup &group()
+    {
+        return current().groups.back();
+    }
+    OPCJsonItem &item()
+    {
+        return current().groups.back().items.back();
+    }
+    void notObject()
+    {
+        if (Scopes.back() == Scope::Servers)
+        {
+            throw OPCException(L"Servers entry is not object");
+        }
+        if (Scopes.back() == Scope::Groups)
+        {
+            throw OPCException(L"Group field is not object");
+        }
+        throw OPCException(L"Variable field is not object");
+    }
+    bool isServerKey() const
+    {
+        return Key == "Host" || Key == "Server" || Key == "Groups" || Key == "AddItemsChunkSize" ||
+               Key == "AddItemsConcurrency" || Key == "ItemIdleTimeout" || Key == "MaxGroupItems" ||
+               Key == "MinUpdateRate" || Key == "MaxUpdateRate" || Key == "StatusInterval" || Key == "Sessions" ||
+               Key == "SecondaryHost" || Key == "SecondaryServer";
+    }
+    bool isKnownKey() const
+    {
+        switch (Scopes.back())
+        {
+        case Scope::Root:
+            return Key == "Servers" || isServerKey();
+        case Scope::Server:
+            return isServerKey();
+        case Scope::Group:
+            return Key == "Group" || Key == "Variables" || Key == "UpdateRate" || Key == "DeadZone" ||
+                   Key == "IsSubscribe";
+        case Scope::Variable:
+            return Key == "Id" || Key == "Name" || Key == "SamplingRate" || Key == "Buffered";
+        default:
+            return false;
+        }
+    }
+    static size_t toSize(const Value &value, const wchar_t *error)
+    {
+        if (value.type != ValueType::Unsigned)
+        {
+            throw OPCException(error);
+        }
+        return value.unsignedInteger < 1 ? 1 : static_cast<size_t>(value.unsignedInteger);
+    }
+    bool onValue(const Value &value)
+    {
+        if (SkipDepth > 0)
+        {
+            return true;
+        }
+        if (Scopes.empty())
+        {
+            throw OPCException(L"json is not object");
+        }
+        const Scope scope = Scopes.back();
+        if (scope == Scope::Groups || scope == Scope::Variables || scope == Scope::Servers)
+        {
+            notObject();
+        }
+        if (scope == Scope::Root && Key == "Servers")
+        {
+            throw OPCException(L"Servers field is not array");
+        }
+        if (scope == Scope::Root || scope == Scope::Server)
+        {
+            if (scope == Scope::Root && isServerKey())
+            {
+                HasServerFields = true;
+            }
+            if (Key == "Host")
+            {
+                if (value.type != ValueType::String)
+                {
+                    throw OPCException(L"Host field is not string type");
+                }
+                current().host = ConvertUtf8ToWide(*value.str);
+                if (current().host.empty())
+                {
+                    current().host = L"localhost";
+                }
+                HasHost = true;
+            }
+            else if (Key == "Server")
+            {
+                if (value.type != ValueType::String)
+                {
+                    throw OPCException(L"Server field is not string type");
+                }
+                current().server = ConvertUtf8ToWide(*value.str);
+                if (current().server.empty())
+                {
+                    throw OPCException(L"Server field is empty");
+                }
+                HasServer = true;
+            }
+            else if (Key == "SecondaryHost")
+            {
+                if (value.type != ValueType::String)
+                {
+                    throw OPCException(L"SecondaryHost field is not string type");
+                }
+                current().secondaryHost = ConvertUtf8ToWide(*value.str);
+            }
+            else if (Key == "SecondaryServer")
+            {
+                if (value.type != ValueType::String)
+                {
+                    throw OPCException(L"SecondaryServer field is not string type");
+                }
+                current().secondaryServer = ConvertUtf8ToWide(*value.str);
+            }
+            else if (Key == "Groups")
+            {
+                throw OPCException(L"Groups field is not array");
+            }
+            else if (Key == "AddItemsChunkSize")
+            {
+                current().addItemsChunkSize = toSize(value, L"AddItemsChunkSize field is not uint type");
+            }
+            else if (Key == "AddItemsConcurrency")
+            {
+                current().addItemsConcurrency = toSize(value, L"AddItemsConcurrency field is not uint type");
+            }
+            else if (Key == "Sessions")
+            {
+                current().sessions = toSize(value, L"Sessions field is not uint type");
+            }
+            else if (Key == "ItemIdleTimeout")
+            {
+                if (value.type != ValueType::Unsigned || value.unsignedInteger > ULONG_MAX)
+                {
+                    throw OPCException(L"ItemIdleTimeout field is not uint type");
+                }
+                current().itemIdleTimeout = static_cast<unsigned long>(value.unsignedInteger);
+            }
+            else if (Key == "MaxGroupItems")
+            {
+                if (value.type != ValueType::Unsigned || value.unsignedInteger > UINT_MAX)
+                {
+                    throw OPCException(L"MaxGroupItems field is not uint type");
+                }
+                current().maxGroupItems = static_cast<size_t>(value.unsignedInteger);
+            }
+            else if (Key == "MinUpdateRate")
+            {
+                if (value.type != ValueType::Unsigned || value.unsignedInteger > ULONG_MAX)
+                {
+                    throw OPCException(L"MinUpdateRate field is not uint type");
+                }
+                current().minUpdateRate = static_cast<unsigned long>(value.unsignedInteger);
+            }
+            else if (Key == "MaxUpdateRate")
+            {
+                if (value.type != ValueType::Unsigned || value.unsignedInteger > ULONG_MAX)
+                {
+                    throw OPCException(L"MaxUpdateRate field is not uint type");
+                }
+                current().maxUpdateRate = static_cast<unsigned long>(value.unsignedInteger);
+            }
+            else if (Key == "StatusInterval")
+            {
+                if (value.type != ValueType::Unsigned || value.unsignedInteger > ULONG_MAX)
+                {
+                    throw OPCException(L"StatusInterval field is not uint type");
+                }
+                current().statusInterval = static_cast<unsigned long>(value.unsignedInteger);
+            }
+        }
+        else if (scope == Scope::Group)
+        {
+            if (Key == "Group")
+            {
+                if (value.type != ValueType::String)
+                {
+                    throw OPCException(L"Group field is not string type");
+                }
+                group().name = ConvertUtf8ToWide(*value.str);
+                if (group().name.empty())
+                {
+                    throw OPCException(L"Group field is empty");
+                }
+                HasGroupName = true;
+            }
+            else if (Key == "Variables")
+            {
+                throw OPCException(L"Variables field is not array");
+            }
+            else if (Key == "UpdateRate")
+            {
+                if (value.type == ValueType::Null)
+                {
+                    group().updateRate = 1000;
+                }
+                else
+                {
+                    if (value.type != ValueType::Unsigned || value.unsignedInteger > ULONG_MAX)
+                    {
+                        throw OPCException(L"Group UpdateRate field is not ulong type");
+                    }
+                    group().updateRate = static_cast<unsigned long>(value.unsignedInteger);
+                    if (group().updateRate < 100)
+                    {
+                        group().updateRate = 100;
+                    }
+                }
+            }
+            else if (Key == "DeadZone")
+            {
+                if (value.type == ValueType::Null)
+                {
+                    group().deadBand = 0.0;
+                }
+                else if (value.type == ValueType::Float)
+                {
+                    group().deadBand = static_cast<float>(value.floating);
+                }
+                else if (value.type == ValueType::Integer)
+                {
+                    group().deadBand = static_cast<float>(value.integer);
+                }
+                else if (value.type == ValueType::Unsigned)
+                {
+                    group().deadBand = static_cast<float>(value.unsignedInteger);
+                }
+                else
+                {
+                    throw OPCException(L"Group DeadZone field is not float type");
+                }
+            }
+            else if (Key == "IsSubscribe")
+            {
+                if (value.type == ValueType::Null)
+                {
+                    group().subscribe = false;
+                }
+                else
+                {
+                    if (value.type != ValueType::Boolean)
+                    {
+                        throw OPCException(L"Group IsSubscribe field is not bool type");
+                    }
+                    group().subscribe = value.boolean;
+                }
+            }
+        }
+        else if (scope == Scope::Variable)
+        {
+            if (Key == "Id")
+            {
+                if (value.type == ValueType::Integer && value.integer >= INT_MIN && value.integer <= INT_MAX)
+                {
+                    item().id = static_cast<int>(value.integer);
+                }
+                else if (value.type == ValueType::Unsigned && value.unsignedInteger <= INT_MAX)
+                {
+                    item().id = static_cast<int>(value.unsignedInteger);
+                }
+                else
+                {
+                    throw OPCException(L"Variable Id field is not int type");
+                }
+                HasId = true;
+            }
+            else if (Key == "Name")
+            {
+                if (value.type != ValueType::String)
+                {
+                    throw OPCException(L"Variable Name field is not string type");
+                }
+                item().name = ConvertUtf8ToWide(*value.str);
+                if (item().name.empty())
+                {
+                    throw OPCException(L"Variable Name field is empty");
+                }
+                HasName = true;
+            }
+            else if (Key == "SamplingRate")
+            {
+                if (value.type == ValueType::Null)
+                {
+                    item().samplingRate = 0;
+                }
+                else
+                {
+                    if (value.type != ValueType::Unsigned || value.unsignedInteger > ULONG_MAX)
+                    {
+                        throw OPCException(L"Variable SamplingRate field is not ulong type");
+                    }
+                    item().samplingRate = static_cast<unsigned long>(value.unsignedInteger);
+                }
+            }
+            else if (Key == "Buffered")
+            {
+                if (value.type == ValueType::Null)
+                {
+                    item().buffered = false;
+                }
+                else
+                {
+                    if (value.type != ValueType::Boolean)
+                    {
+                        throw OPCException(L"Variable Buffered field is not bool type");
+                    }
+                    item().buffered = value.boolean;
+                }
+            }
+        }
+        return true;
+    }
+
+  public:
+    OPCJsonSaxHandler(vector<OPCJson> &servers) : Servers(servers), SkipDepth(0)
+    {
+        HasHost = HasServer = HasGroups = false;
+        HasServers = HasServerFields = false;
+        HasGroupName = HasVariables = false;
+        HasId = HasName = false;
+    }
+
+    bool null() override
+    {
+        return onValue(Value{ValueType::Null});
+    }
+    bool boolean(bool val) override
+    {
+        Value value{ValueType::Boolean};
+        value.boolean = val;
+        return onValue(value);
+    }
+    bool number_integer(number_integer_t val) override
+    {
+        Value value{ValueType::Integer};
+        value.integer = val;
+        return onValue(value);
+    }
+    bool number_unsigned(number_unsigned_t val) override
+    {
+        Value value{ValueType::Unsigned};
+        value.unsignedInteger = val;
+        return onValue(value);
+    }
+    bool number_float(number_float_t val, const string_t &) override
+    {
+        Value value{ValueType::Float};
+        value.floating = val;
+        return onValue(value);
+    }
+    bool string(string_t &val) override
+    {
+        Value value{ValueType::String};
+        value.str = &val;
+        return onValue(value);
+    }
+    bool binary(binary_t &) override
+    {
+        throw OPCException(L"json binary values are not supported");
+    }
+    bool key(string_t &val) override
+    {
+        if (SkipDepth == 0)
+        {
+            Key.swap(val);
+        }
+        return true;
+    }
+    bool start_object(std::size_t) override
+    {
+        if (SkipDepth > 0)
+        {
+            ++SkipDepth;
+            return true;
+        }
+        if (Scopes.empty())
+        {
+            Servers.emplace_back();
+            SetDefaults(current());
+            Scopes.push_back(Scope::Root);
+            return true;
+        }
+        switch (Scopes.back())
+        {
+        case Scope::Servers:
+            Servers.emplace_back();
+            SetDefaults(current());
+            HasHost = HasServer = HasGroups = false;
+            Scopes.push_back(Scope::Server);
+            return true;
+        case Scope::Groups:
+            current().groups.emplace_back();
+            group().updateRate = 1000;
+            group().deadBand = 0.0;
+            group().subscribe = false;
+            HasGroupName = HasVariables = false;
+            Scopes.push_back(Scope::Group);
+            return true;
+        case Scope::Variables:
+            group().items.emplace_back();
+            item().id = 0;
+            item().samplingRate = 0;
+            item().buffered = false;
+            HasId = HasName = false;
+            Scopes.push_back(Scope::Variable);
+            return true;
+        default:
+            if (isKnownKey())
+            {
+                return onValue(Value{ValueType::Structured}); // reports the type error of the key
+            }
+            SkipDepth = 1;
+            return true;
+        }
+    }
+    bool end_object() override
+    {
+        if (SkipDepth > 0)
+        {
+            --SkipDepth;
+            return true;
+        }
+        const Scope scope = Scopes.back();
+        Scopes.pop_back();
+        if (scope == Scope::Root && HasServers)
+        {
+            if (HasServerFields)
+            {
+                throw OPCException(L"Servers field can not be combined with server fields at the root");
+            }
+            // drop the root entry, only the Servers entries describe servers
+            Servers.erase(Servers.begin());
+            if (Servers.empty())
+            {
+                throw OPCException(L"Servers field is empty");
+            }
+        }
+        else if (scope == Scope::Root || scope == Scope::Server)
+        {
+            if (!HasHost)
+            {
+                throw OPCException(L"Host field is missing");
+            }
+            if (!HasServer)
+            {
+                throw OPCException(L"Server field is missing");
+            }
+            if (!HasGroups)
+            {
+                throw OPCException(L"Groups field is missing");
+            }
+        }
+        else if (scope == Scope::Group)
+        {
+            if (!HasGroupName)
+            {
+                throw OPCException(L"Group field is missing");
+            }
+            if (!HasVariables)
+            {
+                throw OPCException(L"Variables field is missing");
+            }
+        }
+        else if (scope == Scope::Variable)
+        {
+            if (!HasId)
+            {
+                throw OPCException(L"Variable Id field is missing");
+            }
+            if (!HasName)
+            {
+                throw OPCException(L"Variable Name field is missing");
+            }
+        }
+        return true;
+    }
+    bool start_array(std::size_t) override
+    {
+        if (SkipDepth > 0)
+        {
+            ++SkipDepth;
+            return true;
+        }
+        if (Scopes.empty())
+        {
+            throw OPCException(L"json is not object");
+        }
+        const Scope scope = Scopes.back();
+        if ((scope == Scope::Root || scope == Scope::Server) && Key == "Groups")
+        {
+            HasGroups = true;
+            HasServerFields = HasServerFields || scope == Scope::Root;
+            Scopes.push_back(Scope::Groups);
+            return true;
+        }
+        if (scope == Scope::Root && Key == "Servers")
+        {
+            HasServers = true;
+            Scopes.push_back(Scope::Servers);
+            return true;
+        }
+        if (scope == Scope::Group && Key == "Variables")
+        {
+            HasVariables = true;
+            Scopes.push_back(Scope::Variables);
+            return true;
+        }
+        if (scope == Scope::Groups || scope == Scope::Variables || scope == Scope::Servers)
+        {
+            notObject();
+        }
+        if (isKnownKey())
+        {
+            return onValue(Value{ValueType::Structured}); // reports the type error of the key
+        }
+        SkipDepth = 1;
+        return true;
+    }
+    bool end_array() override
+    {
+        if (SkipDepth > 0)
+        {
+            --SkipDepth;
+            return true;
+        }
+        Scopes.pop_back();
+        return true;
+    }
+    bool parse_error(std::size_t position, const std::string &, const nlohmann::detail::exception &ex) override
+    {
+        printf("json parse error at %d: %s\n", static_cast<int>(position), ex.what());
+        throw OPCException(L"json parse failed");
+    }
+};
+
+vector<OPCJson> readOPCJson(const string &jsonFile)
+{
+    ifstream ifs(jsonFile, ios::binary);
+    if (!ifs.is_open())
+    {
+        throw OPCException(L"Json file open failed!");
+    }
+    vector<OPCJson> servers;
+    OPCJsonSaxHandler handler(servers);
+    Json::sax_parse(ifs, &handler);
+    for (auto &data : servers)
+    {
+        data.statusInterval = data.statusInterval < 100 ? 100 : data.statusInterval;
+        data.sessions = data.sessions < 1 ? 1 : data.sessions;
+        if (!data.secondaryServer.empty() && data.secondaryHost.empty())
+        {
+            data.secondaryHost = L"localhost";
+        }
+        if (data.maxUpdateRate > 0)
+        {
+            data.minUpdateRate = data.minUpdateRate < 100 ? 100 : data.minUpdateRate;
+            data.maxUpdateRate = data.maxUpdateRate < data.minUpdateRate ? data.minUpdateRate : data.maxUpdateRate;
+        }
+    }
+    if (servers.size() > 1)
+    {
+        // the driver routes reads and writes by id alone
+        unordered_set<int> ids;
+        for (auto &data : servers)
+        {
+            unordered_set<int> serverIds;
+            for (auto &group : data.groups)
+            {
+                for (auto &item : group.items)
+                {
+                    serverIds.insert(item.id);
+                }
+            }
+            for (int id : serverIds)
+            {
+                if (!ids.insert(id).second)
+                {
+                    printf("variable id %d is configured on several servers\n", id);
+                    throw OPCException(L"Variable Id is used by several servers");
+                }
+            }
+        }
+    }
+    return servers;
+}
+
+/// <summary>
+/// compiled tag table layout, a compact binary form of the config. All integers are little endian, strings are a
+/// uint32 length followed by UTF-16 units: header, header extensions (version 2, version 3), host, server, secondary
+/// host and server (version 4), then per group: name, updateRate, deadBand, subscribe, item count and per item id,
+/// name, samplingRate and buffered (version 5). A table of several servers repeats this block per server, all blocks
+/// carry the same header stamp and the server count
+/// </summary>
+static const char TAGTABLE_MAGIC[4] = {'O', 'P', 'C', 'T'};
+static const uint32_t TAGTABLE_VERSION = 5;
+struct OPCTagTableHeader
+{
+    char magic[4];
+    uint32_t version;
+    // size and last write time of the json file the table was compiled from
+    uint64_t sourceSize;
+    uint64_t sourceWriteTime;
+    uint32_t addItemsChunkSize;
+    uint32_t addItemsConcurrency;
+    uint32_t groupCount;
+    // was reserved (0) in tables written before item idle timeouts existed, 0 keeps all items active
+    uint32_t itemIdleTimeout;
+};
+// follows the header from version 2 on, version 1 tables read as all zero
+struct OPCTagTableHeaderV2
+{
+    uint32_t maxGroupItems;
+    uint32_t minUpdateRate;
+    uint32_t maxUpdateRate;
+    // was reserved (0) in tables written before the health watchdog existed, read as the default of 1000 ms
+    uint32_t statusInterval;
+};
+// follows the version 2 extension from version 3 on, older tables read as one session
+struct OPCTagTableHeaderV3
+{
+    uint32_t sessions;
+    // was reserved (0) in tables written before multi-server configs, read as one server
+    uint32_t serverCount;
+    uint32_t reserved[2];
+};
+
+static bool GetSourceStamp(const string &jsonFile, uint64_t &size, uint64_t &writeTime)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(jsonFile.c_str(), GetFileExInfoStandard, &attributes))
+    {
+        return false;
+    }
+    size = static_cast<uint64_t>(attributes.nFileSizeHigh) << 32 | attributes.nFileSizeLow;
+    writeTime = static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32 |
+                attributes.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+/// <summary>
+/// bounds checked reader over the file contents, values and strings are copied out
+/// </summary>
+class OPCTagTableReader
+{
+  private:
+    const uint8_t *Cursor;
+    const uint8_t *End;
+
+  public:
+    OPCTagTableReader(const uint8_t *begin, size_t size) : Cursor(begin), End(begin + size)
+    {
+    }
+    template <typename T> void read(T &value)
+    {
+        if (static_cast<size_t>(End - Cursor) < sizeof(T))
+        {
+            throw OPCException(L"tag table is truncated");
+        }
+        memcpy(&value, Cursor, sizeof(T));
+        Cursor += sizeof(T);
+    }
+    void read(wstring &value)
+    {
+        uint32_t length = 0;
+        read(length);
+        if (static_cast<size_t>(End - Cursor) / sizeof(wchar_t) < length)
+        {
+            throw OPCException(L"tag table is truncated");
+        }
+        value.assign(reinterpret_cast<const wchar_t *>(Cursor), length);
+        Cursor += length * sizeof(wchar_t);
+    }
+};
+
+/// <summary>
+/// read the rest of the server block of header, returns the number of server blocks of the table
+/// </summary>
+static uint32_t ReadServerBlock(OPCTagTableReader &reader, const OPCTagTableHeader &header, OPCJson &table)
+{
+    OPCTagTableHeaderV2 headerV2 = {};
+    if (header.version >= 2)
+    {
+        reader.read(headerV2);
+    }
+    OPCTagTableHeaderV3 headerV3 = {};
+    headerV3.sessions = 1;
+    if (header.version >= 3)
+    {
+        reader.read(headerV3);
+    }
+    table.addItemsChunkSize = header.addItemsChunkSize;
+    table.addItemsConcurrency = header.addItemsConcurrency;
+    table.itemIdleTimeout = header.itemIdleTimeout;
+    table.maxGroupItems = headerV2.maxGroupItems;
+    table.minUpdateRate = headerV2.minUpdateRate;
+    table.maxUpdateRate = headerV2.maxUpdateRate;
+    table.statusInterval = headerV2.statusInterval;
+    if (table.statusInterval == 0)
+    {
+        table.statusInterval = 1000;
+    }
+    table.sessions = headerV3.sessions < 1 ? 1 : headerV3.sessions;
+    reader.read(table.host);
+    reader.read(table.server);
+    if (header.version >= 4)
+    {
+        reader.read(table.secondaryHost);
+        reader.read(table.secondaryServer);
+    }
+    table.groups.resize(header.groupCount);
+    for (auto &group : table.groups)
+    {
+        uint8_t subscribe = 0;
+        uint32_t itemCount = 0;
+        uint32_t updateRate = 0;
+        reader.read(group.name);
+        reader.read(updateRate);
+        reader.read(group.deadBand);
+        reader.read(subscribe);
+        reader.read(itemCount);
+        group.updateRate = updateRate;
+        group.subscribe = subscribe != 0;
+        group.items.resize(itemCount);
+        for (auto &item : group.items)
+        {
+            int32_t id = 0;
+            uint32_t samplingRate = 0;
+            uint8_t buffered = 0;
+            reader.read(id);
+            reader.read(item.name);
+            if (header.version >= 5)
+            {
+                reader.read(samplingRate);
+                reader.read(buffered);
+            }
+            item.id = id;
+            item.samplingRate = samplingRate;
+            item.buffered = buffered != 0;
+        }
+    }
+    return headerV3.serverCount < 1 ? 1 : headerV3.serverCount;
+}
+
+bool readOPCTagTable(const string &tagTableFile, const string &jsonFile, vector<OPCJson> &data)
+{
+    HANDLE file = CreateFileA(tagTableFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    const uint8_t *view = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(OPCTagTableHeader)))
+    {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+        {
+            view = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+    }
+    bool loaded = false;
+    if (view)
+    {
+        try
+        {
+            OPCTagTableReader reader(view, static_cast<size_t>(fileSize.QuadPart));
+            OPCTagTableHeader header;
+            reader.read(header);
+            uint64_t sourceSize = 0;
+            uint64_t sourceWriteTime = 0;
+            const bool current = jsonFile.empty() || !GetSourceStamp(jsonFile, sourceSize, sourceWriteTime) ||
+                                 (header.sourceSize == sourceSize && header.sourceWriteTime == sourceWriteTime);
+            if (memcmp(header.magic, TAGTABLE_MAGIC, sizeof(TAGTABLE_MAGIC)) == 0 &&
+                header.version >= 1 && header.version <= TAGTABLE_VERSION && current)
+            {
+                vector<OPCJson> tables(1);
+                const uint32_t serverCount = ReadServerBlock(reader, header, tables[0]);
+                while (tables.size() < serverCount)
+                {
+                    OPCTagTableHeader next;
+                    reader.read(next);
+                    if (memcmp(next.magic, TAGTABLE_MAGIC, sizeof(TAGTABLE_MAGIC)) != 0 ||
+                        next.version != header.version || next.sourceSize != header.sourceSize ||
+                        next.sourceWriteTime != header.sourceWriteTime)
+                    {
+                        throw OPCException(L"tag table server block is malformed");
+                    }
+                    tables.emplace_back();
+                    ReadServerBlock(reader, next, tables.back());
+                }
+                data = std::move(tables);
+                loaded = true;
+            }
+        }
+        catch (OPCException ex)
+        {
+            printf("tag table %s ignored: %ws\n", tagTableFile.c_str(), ex.reasonString().c_str());
+        }
+        UnmapViewOfFile(view);
+    }
+    if (mapping)
+    {
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    return loaded;
+}
+
+class OPCTagTableWriter
+{
+  private:
+    ofstream &Stream;
+
+  public:
+    OPCTagTableWriter(ofstream &stream) : Stream(stream)
+    {
+    }
+    template <typename T> void write(const T &value)
+    {
+        Stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+    void write(const wstring &value)
+    {
+        write(static_cast<uint32_t>(value.size()));
+        Stream.write(reinterpret_cast<const char *>(value.data()), value.size() * sizeof(wchar_t));
+    }
+};
+
+/// <summary>
+/// write the server block of data, header holds the source stamp
+/// </summary>
+static void WriteServerBlock(OPCTagTableWriter &writer, OPCTagTableHeader header, const OPCJson &data,
+                             uint32_t serverCount)
+{
+    header.addItemsChunkSize = static_cast<uint32_t>(data.addItemsChunkSize);
+    header.addItemsConcurrency = static_cast<uint32_t>(data.addItemsConcurrency);
+    header.groupCount = static_cast<uint32_t>(data.groups.size());
+    header.itemIdleTimeout = static_cast<uint32_t>(data.itemIdleTimeout);
+    OPCTagTableHeaderV2 headerV2 = {};
+    headerV2.maxGroupItems = static_cast<uint32_t>(data.maxGroupItems);
+    headerV2.minUpdateRate = static_cast<uint32_t>(data.minUpdateRate);
+    headerV2.maxUpdateRate = static_cast<uint32_t>(data.maxUpdateRate);
+    headerV2.statusInterval = static_cast<uint32_t>(data.statusInterval);
+    OPCTagTableHeaderV3 headerV3 = {};
+    headerV3.sessions = static_cast<uint32_t>(data.sessions);
+    headerV3.serverCount = serverCount;
+
+    writer.write(header);
+    writer.write(headerV2);
+    writer.write(headerV3);
+    writer.write(data.host);
+    writer.write(data.server);
+    writer.write(data.secondaryHost);
+    writer.write(data.secondaryServer);
+    for (auto &group : data.groups)
+    {
+        writer.write(group.name);
+        writer.write(static_cast<uint32_t>(group.updateRate));
+        writer.write(group.deadBand);
+        writer.write(static_cast<uint8_t>(group.subscribe ? 1 : 0));
+        writer.write(static_cast<uint32_t>(group.items.size()));
+        for (auto &item : group.items)
+        {
+            writer.write(static_cast<int32_t>(item.id));
+            writer.write(item.name);
+            writer.write(static_cast<uint32_t>(item.samplingRate));
+            writer.write(static_cast<uint8_t>(item.buffered ? 1 : 0));
+        }
+    }
+}
+
+void writeOPCTagTable(const string &tagTableFile, const string &jsonFile, const vector<OPCJson> &data)
+{
+    OPCTagTableHeader header = {};
+    memcpy(header.magic, TAGTABLE_MAGIC, sizeof(TAGTABLE_MAGIC));
+    header.version = TAGTABLE_VERSION;
+    GetSourceStamp(jsonFile, header.sourceSize, header.sourceWriteTime);
+
+    // written next to the target and moved into place, so readers never map a half written table
+    const string tempFile = tagTableFile + ".tmp";
+    {
+        ofstream ofs(tempFile, ios::binary | ios::trunc);
+        if (!ofs.is_open())
+        {
+            throw OPCException(L"tag table file open failed");
+        }
+        OPCTagTableWriter writer(ofs);
+        for (auto &server : data)
+        {
+            WriteServerBlock(writer, header, server, static_cast<uint32_t>(data.size()));
+        }
+        if (!ofs.good())
+        {
+            throw OPCException(L"tag table write failed");
+        }
+    }
+    if (!MoveFileExA(tempFile.c_str(), tagTableFile.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFileA(tempFile.c_str());
+        throw OPCException(L"tag table replace failed");
+    }
+}
+
+static bool IsOPCTagTable(const string &file)
+{
+    ifstream ifs(file, ios::binary);
+    char magic[sizeof(TAGTABLE_MAGIC)] = {0};
+    return ifs.read(magic, sizeof(magic)) && memcmp(magic, TAGTABLE_MAGIC, sizeof(TAGTABLE_MAGIC)) == 0;
+}
+
+vector<OPCJson> readOPCConfig(const string &configFile, const string &tagTableFile)
+{
+    vector<OPCJson> data;
+    if (IsOPCTagTable(configFile))
+    {
+        if (!readOPCTagTable(configFile, string(), data))
+        {
+            throw OPCException(L"tag table load failed");
+        }
+        return data;
+    }
+    if (tagTableFile.empty())
+    {
+        return readOPCJson(configFile);
+    }
+    if (readOPCTagTable(tagTableFile, configFile, data))
+    {
+        printf("tag table loaded: %s\n", tagTableFile.c_str());
+        return data;
+    }
+    data = readOPCJson(configFile);
+    try
+    {
+        writeOPCTagTable(tagTableFile, configFile, data);
+        printf("tag table compiled: %s\n", tagTableFile.c_str());
+    }
+    catch (OPCException ex)
+    {
+        printf("tag table compile failed: %s %ws\n", tagTableFile.c_str(), ex.reasonString().c_str());
+    }
+    return data;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "OPCClient.h"
+
+struct OPCJsonItem
+{
+    int id;
+    std::wstring name;
+    // ms between samples taken by the server, 0 samples at the update rate of the group
+    unsigned long samplingRate;
+    // the server keeps the samples taken between two updates, so each of them is reported
+    bool buffered;
+};
+struct OPCJsonGroup
+{
+    std::wstring name;
+    unsigned long updateRate;
+    float deadBand;
+    bool subscribe;
+    std::vector<OPCJsonItem> items;
+};
+struct OPCJson
+{
+    std::wstring host;
+    std::wstring server;
+    // other server of a redundant pair, kept as a hot standby. Empty without redundancy
+    std::wstring secondaryHost;
+    std::wstring secondaryServer;
+    // number of item names submitted per IOPCItemMgt::AddItems call
+    size_t addItemsChunkSize;
+    // number of groups registering their items concurrently
+    size_t addItemsConcurrency;
+    // items are activated on demand and deactivated after this many ms without a read, 0 keeps all items active
+    unsigned long itemIdleTimeout;
+    // groups with more items are split into several server groups of at most this many items, 0 does not split
+    size_t maxGroupItems;
+    // bounds in ms of the adaptive update rate controller, the controller is off while maxUpdateRate is 0
+    unsigned long minUpdateRate;
+    unsigned long maxUpdateRate;
+    // period in ms of the server health watchdog
+    unsigned long statusInterval;
+    // number of pooled connections to the server, groups are spread over them by item count
+    size_t sessions;
+    std::vector<OPCJsonGroup> groups;
+};
+
+/**
+ * Stream the json config file through a SAX parser straight into OPCJson, no DOM is built.
+ * A config either describes one server at its root or several in a "Servers" array of entries with the same keys,
+ * one OPCJson per server. Variable ids are unique over all servers.
+ */
+std::vector<OPCJson> readOPCJson(const std::string &jsonFile);
+
+/**
+ * Load a compiled tag table, a compact binary form of the config (ids, UTF-16 names and group parameters) that is
+ * read without parsing json. Names are copied out of the table into the returned OPCJson.
+ * If jsonFile is not empty, the table is only used when it was compiled from the current version of that file.
+ * returns false if the table is missing, stale or malformed.
+ */
+bool readOPCTagTable(const std::string &tagTableFile, const std::string &jsonFile, std::vector<OPCJson> &data);
+
+/**
+ * Compile the config into a tag table file, stamped with the size and write time of jsonFile.
+ */
+void writeOPCTagTable(const std::string &tagTableFile, const std::string &jsonFile, const std::vector<OPCJson> &data);
+
+/**
+ * Read the driver config. configFile may be a json file or a compiled tag table. If tagTableFile is set, it is
+ * used as a compiled cache of the json file: loaded when current, (re)written otherwise.
+ */
+std::vector<OPCJson> readOPCConfig(const std::string &configFile, const std::string &tagTableFile);
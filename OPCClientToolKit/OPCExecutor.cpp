@@ -0,0 +1,248 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#include <unordered_set>
+
+#include "OPCExecutor.h"
+#include "OPCGroup.h"
+#include "OPCItem.h"
+#include "OPCServer.h"
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+namespace opcda_client
+{
+#endif
+
+COPCExecutor::COPCExecutor(OPCOLEInitMode mode) : Pending(nullptr), Stopping(false), Mode(mode)
+{
+    Wake = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (!Wake)
+    {
+        throw OPCException(L"COPCExecutor::COPCExecutor: CreateEvent FAILED");
+    }
+
+    Worker = std::thread(&COPCExecutor::run, this);
+
+} // COPCExecutor::COPCExecutor
+
+COPCExecutor::~COPCExecutor()
+{
+    Stopping = true;
+    SetEvent(Wake);
+    Worker.join();
+
+    // commands queued while the thread was leaving, their futures report a broken promise
+    for (Command *command = take(); command;)
+    {
+        Command *next = command->next;
+        delete command;
+        command = next;
+    } // for
+
+    CloseHandle(Wake);
+
+} // COPCExecutor::~COPCExecutor
+
+void COPCExecutor::post(Command *command)
+{
+    if (Stopping)
+    {
+        delete command;
+        throw OPCException(L"COPCExecutor::post: executor is stopping");
+    } // if
+
+    Command *head = Pending.load(std::memory_order_relaxed);
+    do
+    {
+        command->next = head;
+    } while (!Pending.compare_exchange_weak(head, command, std::memory_order_release, std::memory_order_relaxed));
+
+    // the executor drains the stack until it is empty, only a push onto an empty stack needs to wake it
+    if (!head)
+    {
+        SetEvent(Wake);
+    }
+
+} // COPCExecutor::post
+
+void COPCExecutor::post(std::function<void()> task)
+{
+    Command *command = new Command();
+    command->item = nullptr;
+    command->task = std::move(task);
+    post(command);
+
+} // COPCExecutor::post
+
+COPCExecutor::Command *COPCExecutor::take()
+{
+    Command *head = Pending.exchange(nullptr, std::memory_order_acquire);
+    Command *oldest = nullptr;
+    while (head)
+    {
+        Command *next = head->next;
+        head->next = oldest;
+        oldest = head;
+        head = next;
+    } // while
+
+    return oldest;
+
+} // COPCExecutor::take
+
+void COPCExecutor::run()
+{
+    bool initialised = false;
+    try
+    {
+        initialised = COPCClient::init(Mode);
+    }
+    catch (OPCException &e)
+    {
+        printf("COPCExecutor::run: %ws\n", e.reasonString().c_str());
+    }
+
+    for (;;)
+    {
+        WaitForSingleObject(Wake, INFINITE);
+        for (Command *batch = take(); batch; batch = take())
+        {
+            execute(batch);
+        }
+
+        if (Stopping)
+        {
+            break;
+        }
+    } // for
+
+    if (initialised)
+    {
+        COPCClient::stop();
+    }
+
+} // COPCExecutor::run
+
+void COPCExecutor::execute(Command *batch)
+{
+    std::vector<Command *> reads;
+    while (batch)
+    {
+        Command *command = batch;
+        if (!command->item)
+        {
+            batch = command->next;
+            command->task();
+            delete command;
+            continue;
+        } // if
+
+        // gather the run of reads against the same group and source
+        COPCGroup *group = &command->item->getGroup();
+        reads.clear();
+        while (batch && batch->item && &batch->item->getGroup() == group && batch->source == command->source)
+        {
+            reads.push_back(batch);
+            batch = batch->next;
+        } // while
+
+        readMerged(reads);
+        for (Command *read : reads)
+        {
+            delete read;
+        }
+    } // while
+
+} // COPCExecutor::execute
+
+void COPCExecutor::readMerged(std::vector<Command *> &reads)
+{
+    std::vector<COPCItem *> items;
+    std::unordered_set<COPCItem *> queued;
+    for (Command *read : reads)
+    {
+        if (queued.insert(read->item).second)
+        {
+            items.push_back(read->item);
+        }
+    } // for
+
+    COPCItemDataMap values;
+    try
+    {
+        items.front()->getGroup().readSync(items, values, reads.front()->source);
+    }
+    catch (...)
+    {
+        for (Command *read : reads)
+        {
+            read->value.set_exception(std::current_exception());
+        }
+        return;
+    } // catch
+
+    for (Command *read : reads)
+    {
+        COPCItemDataMap::CPair *pair = values.Lookup(COPCGroup::getOpcHandle(read->item));
+        OPCItemData *data = pair ? pair->m_value : nullptr;
+        if (data && !FAILED(data->Error))
+        {
+            read->value.set_value(*data);
+        }
+        else
+        {
+            read->value.set_exception(
+                std::make_exception_ptr(OPCException(L"COPCExecutor::read: synchronous read FAILED")));
+        }
+    } // for
+
+} // COPCExecutor::readMerged
+
+std::future<OPCItemData> COPCExecutor::read(COPCItem *item, OPCDATASOURCE source)
+{
+    Command *command = new Command();
+    command->item = item;
+    command->source = source;
+    std::future<OPCItemData> result = command->value.get_future();
+    post(command);
+    return result;
+
+} // COPCExecutor::read
+
+std::future<bool> COPCExecutor::write(COPCItem *item, const VARIANT &value)
+{
+    CComVariant copy(value);
+    return submit([item, copy]() mutable { return item->writeSync(copy); });
+
+} // COPCExecutor::write
+
+std::future<std::vector<std::wstring>> COPCExecutor::browse(COPCServer *server)
+{
+    return submit([server] {
+        std::vector<std::wstring> names;
+        server->getItemNames(names);
+        return names;
+    });
+
+} // COPCExecutor::browse
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+} // namespace opcda_client
+#endif
@@ -0,0 +1,150 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#pragma once
+
+#pragma warning(disable : 4251) // can be ignored if deriving from a type in the Standard C++ Library..
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OPCClient.h"
+#include "OPCClientToolKitDLL.h"
+#include "OPCItemData.h"
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+namespace opcda_client
+{
+#endif
+
+class COPCItem;
+class COPCServer;
+
+/**
+ * Runs OPC calls on a thread of its own. The thread initialises COM once and owns every object created through the
+ * executor, so any thread may queue commands without calling COPCClient::init. Each command returns a future.
+ * Commands are queued through a lock free stack and executed in the order they were queued; reads queued back to back
+ * against the same group and data source are merged into one IOPCSyncIO::Read call.
+ * A command must not wait on the future of another command, it would block the executor.
+ */
+class OPCDACLIENT_API COPCExecutor
+{
+  private:
+    struct Command
+    {
+        Command *next;
+
+        /// set for item reads, which are merged with adjacent reads of the same group
+        COPCItem *item;
+        OPCDATASOURCE source;
+        std::promise<OPCItemData> value;
+
+        /// any other command
+        std::function<void()> task;
+    };
+
+    /// commands queued by any thread, newest first. The executor takes the whole stack at once
+    std::atomic<Command *> Pending;
+
+    /// auto reset event, signalled when a command is pushed onto an empty stack
+    HANDLE Wake;
+
+    std::atomic<bool> Stopping;
+
+    OPCOLEInitMode Mode;
+
+    std::thread Worker;
+
+    void post(Command *command);
+
+    void post(std::function<void()> task);
+
+    /// take all queued commands, oldest first
+    Command *take();
+
+    void run();
+
+    void execute(Command *batch);
+
+    void readMerged(std::vector<Command *> &reads);
+
+  public:
+    /**
+     * Start the executor thread. The default multithreaded apartment needs no message loop; objects of an apartment
+     * threaded executor cannot deliver callbacks since the executor does not pump messages.
+     */
+    explicit COPCExecutor(OPCOLEInitMode mode = MULTITHREADED);
+
+    /**
+     * Run the commands already queued and stop the thread. Objects created through the executor must be deleted
+     * through it before.
+     */
+    virtual ~COPCExecutor();
+
+    COPCExecutor(const COPCExecutor &) = delete;
+
+    COPCExecutor &operator=(const COPCExecutor &) = delete;
+
+    /**
+     * Queue any call, e.g. connecting a server or deleting a group. The future holds its result or rethrows the
+     * exception it threw.
+     */
+    template <typename F> auto submit(F call) -> std::future<decltype(call())>
+    {
+        typedef decltype(call()) Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(call));
+        std::future<Result> result = task->get_future();
+        post([task] { (*task)(); });
+        return result;
+    }
+
+    /**
+     * Queue a synchronous read of an item. The future throws OPCException if the read or the item failed.
+     */
+    std::future<OPCItemData> read(COPCItem *item, OPCDATASOURCE source = OPC_DS_DEVICE);
+
+    /**
+     * Queue a synchronous write of an item, the value is copied. The future holds the result of COPCItem::writeSync.
+     */
+    std::future<bool> write(COPCItem *item, const VARIANT &value);
+
+    /**
+     * Queue a flat browse of the server's address space.
+     */
+    std::future<std::vector<std::wstring>> browse(COPCServer *server);
+
+    /**
+     * true when called from the executor thread
+     */
+    bool isExecutorThread() const
+    {
+        return std::this_thread::get_id() == Worker.get_id();
+    }
+
+}; // COPCExecutor
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+} // namespace opcda_client
+#endif
@@ -22,6 +22,19 @@ Boston, MA  02111-1307, USA.
 #include "OPCItem.h"
 #include "OPCServer.h"
 
+#ifndef OPC_E_BADTYPE
+#define OPC_E_BADTYPE ((HRESULT)0xC0040004L)
+#endif
+#ifndef OPC_E_UNKNOWNITEMID
+#define OPC_E_UNKNOWNITEMID ((HRESULT)0xC0040007L)
+#endif
+#ifndef OPC_E_INVALIDITEMID
+#define OPC_E_INVALIDITEMID ((HRESULT)0xC0040008L)
+#endif
+#ifndef OPC_E_UNKNOWNPATH
+#define OPC_E_UNKNOWNPATH ((HRESULT)0xC004000AL)
+#endif
+
 #ifdef OPCDA_CLIENT_NAMESPACE
 namespace opcda_client
 {
@@ -122,7 +135,16 @@ class CAsyncDataCallback : public IOPCDataCallback
             CTransaction *transaction = nullptr;
             if (CallbacksGroup.lookupTransaction(transactionID, transaction))
             {
-                updateOPCData(transaction->getItemDataMap(), count, clientHandles, values, quality, time, errors);
+                if (transaction->isChangesOnly())
+                {
+                    CallbacksGroup.updateLastKnownValues(count, clientHandles, values, quality, time, errors,
+                                                         &transaction->getItemDataMap());
+                }
+                else
+                {
+                    updateOPCData(transaction->getItemDataMap(), count, clientHandles, values, quality, time, errors);
+                    CallbacksGroup.updateLastKnownValues(count, clientHandles, values, quality, time, errors);
+                }
                 transaction->setCompleted();
                 return S_OK;
             } // if
@@ -133,10 +155,38 @@ class CAsyncDataCallback : public IOPCDataCallback
             }
         } // if
 
+        CallbacksGroup.updateLastKnownValues(count, clientHandles, values, quality, time, errors);
+
         if (usrHandler)
         {
             COPCItemDataMap dataChanges;
             updateOPCData(dataChanges, count, clientHandles, values, quality, time, errors);
+
+            // buffered items appear more than once, the map kept only their newest value
+            if (dataChanges.GetCount() < count)
+            {
+                std::vector<OPCItemData> samples;
+                samples.reserve(count);
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    COPCItem *item = nullptr;
+                    CallbacksGroup.lookupOpcItem(clientHandles[i], item);
+                    if (FAILED(errors[i]))
+                    {
+                        samples.emplace_back(item, errors[i]);
+                    }
+                    else
+                    {
+                        samples.emplace_back(item, values[i], quality[i], time[i], errors[i]);
+                    }
+                } // for
+
+                if (usrHandler->OnDataSamples(CallbacksGroup, dataChanges, samples))
+                {
+                    return S_OK;
+                }
+            } // if
+
             usrHandler->OnDataChange(CallbacksGroup, dataChanges);
         } // if
 
@@ -255,7 +305,7 @@ class CAsyncDataCallback : public IOPCDataCallback
 
 COPCGroup::COPCGroup(const std::wstring &groupName, bool active, unsigned long reqUpdateRate_ms,
                      unsigned long &revisedUpdateRate_ms, float deadBand, COPCServer &server)
-    : GroupName(groupName), OpcServer(server)
+    : GroupName(groupName), OpcServer(server), UserAsyncCBHandler(nullptr), Abandoned(false)
 {
     HRESULT result = OpcServer.getServerInterface()->AddGroup(groupName.c_str(), active, reqUpdateRate_ms, 0, 0,
                                                               &deadBand, 0, &GroupHandle, &revisedUpdateRate_ms,
@@ -271,6 +321,9 @@ COPCGroup::COPCGroup(const std::wstring &groupName, bool active, unsigned long r
         throw OPCException(L"COPCGroup::COPCGroup: FAILED to get IID_IOPCSyncIO");
     }
 
+    // DA 3.0 only, reads with a maxAge are emulated without it
+    result = iStateManagement->QueryInterface(IID_IOPCSyncIO2, (void **)&iSyncIO2);
+
     result = iStateManagement->QueryInterface(IID_IOPCAsyncIO2, (void **)&iAsync2IO);
     if (FAILED(result))
     {
@@ -283,14 +336,74 @@ COPCGroup::COPCGroup(const std::wstring &groupName, bool active, unsigned long r
         throw OPCException(L"COPCGroup::COPCGroup: FAILED to get IID_IOPCItemMgt");
     }
 
+    // DA 3.0 only, items are sampled at the update rate of the group without it
+    result = iStateManagement->QueryInterface(IID_IOPCItemSamplingMgt, (void **)&iSamplingManagement);
+
 } // COPCGroup::COPCGroup
 
 COPCGroup::~COPCGroup()
 {
+    if (Abandoned)
+    {
+        return;
+    }
+
+    // the server stops calling the sink before the group goes away, a late callback would reach a deleted group
+    if (AsyncDataCallBackHandler)
+    {
+        iAsyncDataCallbackConnectionPoint->Unadvise(GroupCallbackHandle);
+        iAsyncDataCallbackConnectionPoint = nullptr;
+        AsyncDataCallBackHandler = nullptr;
+        UserAsyncCBHandler = nullptr;
+    }
+
+    std::vector<COPCItem *> items;
+    detachItems(items);
+    if (!items.empty())
+    {
+        OPCHANDLE *handles = buildServerHandleList(items);
+        HRESULT *results = nullptr;
+        if (SUCCEEDED(iItemManagement->RemoveItems(static_cast<DWORD>(items.size()), handles, &results)))
+        {
+            COPCClient::comFree(results);
+        }
+        delete[] handles;
+    }
     OpcServer.getServerInterface()->RemoveGroup(GroupHandle, false);
 
 } // COPCGroup::~COPCGroup
 
+void COPCGroup::abandon()
+{
+    std::vector<COPCItem *> items;
+    detachItems(items);
+    if (AsyncDataCallBackHandler)
+    {
+        // local call, drops the references the server holds on the sink
+        CoDisconnectObject(AsyncDataCallBackHandler, 0);
+        UserAsyncCBHandler = nullptr;
+    }
+    Abandoned = true;
+
+} // COPCGroup::abandon
+
+void COPCGroup::detachItems(std::vector<COPCItem *> &items)
+{
+    ATL::CComCritSecLock<ATL::CComAutoCriticalSection> lock(LastKnownLock);
+    POSITION pos = GroupItemDataMap.GetStartPosition();
+    while (pos)
+    {
+        OPCItemData *data = GroupItemDataMap.GetNextValue(pos);
+        COPCItem *item = data ? data->item() : nullptr;
+        if (item && item->Registered)
+        {
+            item->Registered = false;
+            items.push_back(item);
+        }
+    }
+
+} // COPCGroup::detachItems
+
 OPCHANDLE *COPCGroup::buildServerHandleList(std::vector<COPCItem *> &items)
 {
     OPCHANDLE *handles = new OPCHANDLE[items.size()];
@@ -335,6 +448,7 @@ void COPCGroup::readSync(std::vector<COPCItem *> &items, COPCItemDataMap &itemDa
         }
         else
         {
+            delete pair->m_value;
             itemDataMap.SetValueAt(pair, data);
         }
     } // for
@@ -345,6 +459,88 @@ void COPCGroup::readSync(std::vector<COPCItem *> &items, COPCItemDataMap &itemDa
 
 } // COPCGroup::readSync
 
+void COPCGroup::readMaxAge(std::vector<COPCItem *> &items, DWORD maxAge_ms, COPCItemDataMap &itemDataMap)
+{
+    if (maxAge_ms == 0 || maxAge_ms == MAX_AGE_CACHE)
+    {
+        readSync(items, itemDataMap, maxAge_ms == 0 ? OPC_DS_DEVICE : OPC_DS_CACHE);
+        return;
+    } // if
+
+    if (iSyncIO2)
+    {
+        OPCHANDLE *handles = buildServerHandleList(items);
+        DWORD nbrItems = static_cast<DWORD>(items.size());
+        std::vector<DWORD> maxAges(nbrItems, maxAge_ms);
+        VARIANT *values = nullptr;
+        WORD *qualities = nullptr;
+        FILETIME *times = nullptr;
+        HRESULT *results = nullptr;
+        HRESULT result =
+            iSyncIO2->ReadMaxAge(nbrItems, handles, maxAges.data(), &values, &qualities, &times, &results);
+        delete[] handles;
+        if (FAILED(result))
+        {
+            throw OPCException(L"COPCGroup::readMaxAge: ReadMaxAge FAILED", result);
+        }
+
+        // results are in the order of the request
+        for (unsigned i = 0; i < nbrItems; ++i)
+        {
+            OPCHANDLE handle = getOpcHandle(items[i]);
+            OPCItemData *data =
+                CAsyncDataCallback::makeOPCDataItem(values[i], qualities[i], times[i], results[i], items[i]);
+            COPCItemDataMap::CPair *pair = itemDataMap.Lookup(handle);
+            if (pair)
+            {
+                delete pair->m_value;
+            }
+            itemDataMap.SetAt(handle, data);
+        } // for
+
+        COPCClient::comFreeVariant(values, nbrItems);
+        COPCClient::comFree(qualities);
+        COPCClient::comFree(times);
+        COPCClient::comFree(results);
+        return;
+    } // if
+
+    readSync(items, itemDataMap, OPC_DS_CACHE);
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    ULARGE_INTEGER oldest;
+    oldest.LowPart = now.dwLowDateTime;
+    oldest.HighPart = now.dwHighDateTime;
+    oldest.QuadPart -= static_cast<ULONGLONG>(maxAge_ms) * 10000;
+
+    std::vector<COPCItem *> stale;
+    for (COPCItem *item : items)
+    {
+        COPCItemDataMap::CPair *pair = itemDataMap.Lookup(getOpcHandle(item));
+        OPCItemData *data = pair ? pair->m_value : nullptr;
+        if (!data || FAILED(data->Error) || (data->wQuality & OPC_QUALITY_MASK) != OPC_QUALITY_GOOD)
+        {
+            stale.push_back(item);
+            continue;
+        } // if
+
+        ULARGE_INTEGER time;
+        time.LowPart = data->ftTimeStamp.dwLowDateTime;
+        time.HighPart = data->ftTimeStamp.dwHighDateTime;
+        if (time.QuadPart < oldest.QuadPart)
+        {
+            stale.push_back(item);
+        }
+    } // for
+
+    if (!stale.empty())
+    {
+        readSync(stale, itemDataMap, OPC_DS_DEVICE);
+    }
+
+} // COPCGroup::readMaxAge
+
 CTransaction *COPCGroup::readAsync(std::vector<COPCItem *> &items, ITransactionComplete *transactionCB)
 {
     DWORD cancelID = 0;
@@ -384,7 +580,12 @@ CTransaction *COPCGroup::readAsync(std::vector<COPCItem *> &items, ITransactionC
 CTransaction *COPCGroup::refresh(OPCDATASOURCE source, ITransactionComplete *transactionCB)
 {
     DWORD cancelID = 0;
-    CTransaction *transaction = new CTransaction(GroupItemDataMap, transactionCB);
+    CTransaction *transaction = nullptr;
+    {
+        // items may be added or forgotten meanwhile by a reload on another thread
+        ATL::CComCritSecLock<ATL::CComAutoCriticalSection> lock(LastKnownLock);
+        transaction = new CTransaction(GroupItemDataMap, transactionCB);
+    }
     DWORD transactionID = addTransaction(transaction);
 
     HRESULT result = iAsync2IO->Refresh2(source, transactionID, &cancelID);
@@ -399,6 +600,72 @@ CTransaction *COPCGroup::refresh(OPCDATASOURCE source, ITransactionComplete *tra
 
 } // COPCGroup::refresh
 
+CTransaction *COPCGroup::refreshChanges(OPCDATASOURCE source, ITransactionComplete *transactionCB)
+{
+    DWORD cancelID = 0;
+    CTransaction *transaction = new CTransaction(transactionCB); // starts empty, changed items get added..
+    transaction->setChangesOnly(true);
+    DWORD transactionID = addTransaction(transaction);
+
+    HRESULT result = iAsync2IO->Refresh2(source, transactionID, &cancelID);
+    if (FAILED(result))
+    {
+        deleteTransaction(transaction);
+        throw OPCException(L"COPCGroup::refreshChanges: refresh FAILED");
+    } // if
+
+    transaction->setCancelId(cancelID);
+    return transaction;
+
+} // COPCGroup::refreshChanges
+
+unsigned COPCGroup::updateLastKnownValues(DWORD count, OPCHANDLE *clientHandles, VARIANT *values, WORD *quality,
+                                          FILETIME *time, HRESULT *errors, COPCItemDataMap *changes)
+{
+    unsigned nbrChanged = 0;
+    ATL::CComCritSecLock<ATL::CComAutoCriticalSection> lock(LastKnownLock);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        COPCItemDataMap::CPair *pair = GroupItemDataMap.Lookup(clientHandles[i]);
+        if (!pair || !pair->m_value)
+        {
+            continue; // item has been removed from the group meanwhile..
+        }
+
+        OPCItemData *lastKnown = pair->m_value;
+        if (!lastKnown->hasChanged(values[i], quality[i], errors[i]))
+        {
+            lastKnown->ftTimeStamp = time[i];
+            continue;
+        } // if
+
+        lastKnown->set(values[i], quality[i], time[i], errors[i]);
+        ++nbrChanged;
+        if (changes)
+        {
+            OPCItemData *data = nullptr;
+            if (changes->Lookup(clientHandles[i], data) && data)
+            {
+                *data = *lastKnown;
+            }
+            else
+            {
+                changes->SetAt(clientHandles[i], new OPCItemData(*lastKnown));
+            }
+        } // if
+    }     // for
+
+    return nbrChanged;
+
+} // COPCGroup::updateLastKnownValues
+
+void COPCGroup::getLastKnownValues(COPCItemDataMap &snapshot)
+{
+    ATL::CComCritSecLock<ATL::CComAutoCriticalSection> lock(LastKnownLock);
+    snapshot = GroupItemDataMap;
+
+} // COPCGroup::getLastKnownValues
+
 bool COPCGroup::cancelRefresh(CTransaction *&transaction)
 {
     if (!transaction)
@@ -447,7 +714,7 @@ bool COPCGroup::removeItem(COPCItem *item)
         throw OPCException(L"COPCGroup::removeItem: FAILED to remove item");
     }
 
-    return items[0];
+    return true;
 
 } // COPCGroup::removeItem
 
@@ -457,13 +724,10 @@ int COPCGroup::addItems(std::vector<std::wstring> &names, std::vector<COPCItem *
     items.resize(names.size());
     errors.resize(names.size());
     OPCITEMDEF *itemDef = new OPCITEMDEF[names.size()];
-    std::vector<CW2W *> nameVector;
     for (unsigned i = 0; i < names.size(); ++i)
     {
         items[i] = new COPCItem(names[i], *this);
-        USES_CONVERSION;
-        nameVector.push_back(new CW2W(names[i].c_str()));
-        itemDef[i].szItemID = **(nameVector.end() - 1);
+        itemDef[i].szItemID = const_cast<LPWSTR>(names[i].c_str()); // only read by the server, no copy needed..
         itemDef[i].szAccessPath = nullptr; // wide name;
         itemDef[i].bActive = active;
         itemDef[i].hClient = getOpcHandle(items[i]);
@@ -478,13 +742,14 @@ int COPCGroup::addItems(std::vector<std::wstring> &names, std::vector<COPCItem *
 
     HRESULT result = getItemManagementInterface()->AddItems(nbrItems, itemDef, &details, &results);
     delete[] itemDef;
-    for (unsigned i = 0; i < names.size(); ++i)
-    {
-        delete nameVector[i];
-    }
 
     if (FAILED(result))
     {
+        for (unsigned i = 0; i < names.size(); ++i)
+        {
+            delete items[i];
+            items[i] = nullptr;
+        }
         throw OPCException(L"COPCGroup::addItems: FAILED to add items");
     }
 
@@ -493,7 +758,7 @@ int COPCGroup::addItems(std::vector<std::wstring> &names, std::vector<COPCItem *
     {
         if (details[i].pBlob)
         {
-            COPCClient::comFree(details[0].pBlob);
+            COPCClient::comFree(details[i].pBlob);
         }
 
         if (FAILED(results[i]))
@@ -505,6 +770,7 @@ int COPCGroup::addItems(std::vector<std::wstring> &names, std::vector<COPCItem *
         } // if
         else
         {
+            ATL::CComCritSecLock<ATL::CComAutoCriticalSection> lock(LastKnownLock);
             addItemData(GroupItemDataMap, items[i]); // add new item to group's item data map..
             items[i]->setOPCParameters(details[i].hServer, details[i].vtCanonicalDataType, details[i].dwAccessRights);
             errors[i] = ERROR_SUCCESS;
@@ -517,23 +783,80 @@ int COPCGroup::addItems(std::vector<std::wstring> &names, std::vector<COPCItem *
 
 } // COPCGroup::addItems
 
+int COPCGroup::validateItems(std::vector<std::wstring> &names, std::vector<HRESULT> &errors)
+{
+    errors.resize(names.size());
+    OPCITEMDEF *itemDef = new OPCITEMDEF[names.size()];
+    for (unsigned i = 0; i < names.size(); ++i)
+    {
+        itemDef[i].szItemID = const_cast<LPWSTR>(names[i].c_str());
+        itemDef[i].szAccessPath = nullptr;
+        itemDef[i].bActive = FALSE;
+        itemDef[i].hClient = 0;
+        itemDef[i].dwBlobSize = 0;
+        itemDef[i].pBlob = nullptr;
+        itemDef[i].vtRequestedDataType = VT_EMPTY;
+    } // for
+
+    HRESULT *results = nullptr;
+    OPCITEMRESULT *details = nullptr;
+    DWORD nbrItems = static_cast<DWORD>(names.size());
+
+    HRESULT result = getItemManagementInterface()->ValidateItems(nbrItems, itemDef, FALSE, &details, &results);
+    delete[] itemDef;
+    if (FAILED(result))
+    {
+        throw OPCException(L"COPCGroup::validateItems: FAILED to validate items", result);
+    }
+
+    int errorCount = 0;
+    for (unsigned i = 0; i < nbrItems; ++i)
+    {
+        if (details[i].pBlob)
+        {
+            COPCClient::comFree(details[i].pBlob);
+        }
+
+        errors[i] = FAILED(results[i]) ? results[i] : ERROR_SUCCESS;
+        if (FAILED(results[i]))
+        {
+            ++errorCount;
+        }
+    } // for
+
+    COPCClient::comFree(details);
+    COPCClient::comFree(results);
+    return errorCount;
+
+} // COPCGroup::validateItems
+
+bool COPCGroup::isPermanentItemError(HRESULT error)
+{
+    return (error == OPC_E_INVALIDITEMID) || (error == OPC_E_UNKNOWNITEMID) || (error == OPC_E_UNKNOWNPATH) ||
+           (error == OPC_E_BADTYPE) || (error == E_INVALIDARG);
+
+} // COPCGroup::isPermanentItemError
+
 int COPCGroup::removeItems(std::vector<COPCItem *> &items, std::vector<HRESULT> &errors)
 {
     errors.resize(items.size());
-    OPCHANDLE *itemHandle = new OPCHANDLE[items.size()];
-    for (unsigned i = 0; i < items.size(); ++i)
+    if (items.empty())
     {
-        OPCHANDLE handle = getOpcHandle(items[i]);
-        itemHandle[i] = handle;
-    } // for
+        return 0;
+    }
+    OPCHANDLE *itemHandle = buildServerHandleList(items);
 
     HRESULT *results = nullptr;
     DWORD nbrItems = static_cast<DWORD>(items.size());
 
     HRESULT result = getItemManagementInterface()->RemoveItems(nbrItems, itemHandle, &results);
     delete[] itemHandle;
+
+    // one call removed them all, the destructors must not remove them again
     for (unsigned i = 0; i < items.size(); ++i)
     {
+        items[i]->Registered = false;
+        forgetItem(items[i]);
         delete items[i];
     }
 
@@ -553,7 +876,6 @@ int COPCGroup::removeItems(std::vector<COPCItem *> &items, std::vector<HRESULT>
         } // if
         else
         {
-            GroupItemDataMap.RemoveKey(itemHandle[i]);
             errors[i] = ERROR_SUCCESS;
         } // else
     }     // for
@@ -563,6 +885,181 @@ int COPCGroup::removeItems(std::vector<COPCItem *> &items, std::vector<HRESULT>
 
 } // COPCGroup::removeItems
 
+void COPCGroup::forgetItem(COPCItem *item)
+{
+    ATL::CComCritSecLock<ATL::CComAutoCriticalSection> lock(LastKnownLock);
+    OPCHANDLE handle = getOpcHandle(item);
+    COPCItemDataMap::CPair *pos = GroupItemDataMap.Lookup(handle);
+    if (pos)
+    {
+        delete pos->m_value;
+        GroupItemDataMap.RemoveKey(handle);
+    }
+
+} // COPCGroup::forgetItem
+
+int COPCGroup::setItemsActive(std::vector<COPCItem *> &items, bool active, std::vector<HRESULT> &errors)
+{
+    errors.resize(items.size());
+    if (items.empty())
+    {
+        return 0;
+    }
+
+    OPCHANDLE *handles = buildServerHandleList(items);
+    HRESULT *results = nullptr;
+    DWORD nbrItems = static_cast<DWORD>(items.size());
+
+    HRESULT result = iItemManagement->SetActiveState(nbrItems, handles, active, &results);
+    delete[] handles;
+    if (FAILED(result))
+    {
+        throw OPCException(L"COPCGroup::setItemsActive: FAILED to set item active state");
+    }
+
+    int errorCount = 0;
+    for (unsigned i = 0; i < nbrItems; ++i)
+    {
+        errors[i] = results[i];
+        if (FAILED(results[i]))
+        {
+            ++errorCount;
+        }
+    } // for
+
+    COPCClient::comFree(results);
+    return errorCount;
+
+} // COPCGroup::setItemsActive
+
+int COPCGroup::setItemsSamplingRate(std::vector<COPCItem *> &items, const std::vector<DWORD> &samplingRates_ms,
+                                    std::vector<DWORD> &revisedRates_ms, std::vector<HRESULT> &errors)
+{
+    if (!iSamplingManagement)
+    {
+        throw OPCException(L"COPCGroup::setItemsSamplingRate: IOPCItemSamplingMgt is not supported", E_NOINTERFACE);
+    }
+    if (samplingRates_ms.size() != items.size())
+    {
+        throw OPCException(L"COPCGroup::setItemsSamplingRate: one sampling rate per item expected");
+    }
+
+    errors.resize(items.size());
+    revisedRates_ms.resize(items.size());
+    if (items.empty())
+    {
+        return 0;
+    }
+
+    OPCHANDLE *handles = buildServerHandleList(items);
+    std::vector<DWORD> requested(samplingRates_ms);
+    DWORD *revised = nullptr;
+    HRESULT *results = nullptr;
+    DWORD nbrItems = static_cast<DWORD>(items.size());
+
+    HRESULT result = iSamplingManagement->SetItemSamplingRate(nbrItems, handles, requested.data(), &revised, &results);
+    delete[] handles;
+    if (FAILED(result))
+    {
+        throw OPCException(L"COPCGroup::setItemsSamplingRate: FAILED to set item sampling rate", result);
+    }
+
+    int errorCount = 0;
+    for (unsigned i = 0; i < nbrItems; ++i)
+    {
+        errors[i] = results[i];
+        revisedRates_ms[i] = FAILED(results[i]) ? 0 : revised[i];
+        if (FAILED(results[i]))
+        {
+            ++errorCount;
+        }
+    } // for
+
+    COPCClient::comFree(revised);
+    COPCClient::comFree(results);
+    return errorCount;
+
+} // COPCGroup::setItemsSamplingRate
+
+int COPCGroup::clearItemsSamplingRate(std::vector<COPCItem *> &items, std::vector<HRESULT> &errors)
+{
+    if (!iSamplingManagement)
+    {
+        throw OPCException(L"COPCGroup::clearItemsSamplingRate: IOPCItemSamplingMgt is not supported", E_NOINTERFACE);
+    }
+
+    errors.resize(items.size());
+    if (items.empty())
+    {
+        return 0;
+    }
+
+    OPCHANDLE *handles = buildServerHandleList(items);
+    HRESULT *results = nullptr;
+    DWORD nbrItems = static_cast<DWORD>(items.size());
+
+    HRESULT result = iSamplingManagement->ClearItemSamplingRate(nbrItems, handles, &results);
+    delete[] handles;
+    if (FAILED(result))
+    {
+        throw OPCException(L"COPCGroup::clearItemsSamplingRate: FAILED to clear item sampling rate", result);
+    }
+
+    int errorCount = 0;
+    for (unsigned i = 0; i < nbrItems; ++i)
+    {
+        errors[i] = results[i];
+        if (FAILED(results[i]))
+        {
+            ++errorCount;
+        }
+    } // for
+
+    COPCClient::comFree(results);
+    return errorCount;
+
+} // COPCGroup::clearItemsSamplingRate
+
+int COPCGroup::setItemsBuffered(std::vector<COPCItem *> &items, bool buffered, std::vector<HRESULT> &errors)
+{
+    if (!iSamplingManagement)
+    {
+        throw OPCException(L"COPCGroup::setItemsBuffered: IOPCItemSamplingMgt is not supported", E_NOINTERFACE);
+    }
+
+    errors.resize(items.size());
+    if (items.empty())
+    {
+        return 0;
+    }
+
+    OPCHANDLE *handles = buildServerHandleList(items);
+    std::vector<BOOL> enable(items.size(), buffered ? TRUE : FALSE);
+    HRESULT *results = nullptr;
+    DWORD nbrItems = static_cast<DWORD>(items.size());
+
+    HRESULT result = iSamplingManagement->SetItemBufferEnable(nbrItems, handles, enable.data(), &results);
+    delete[] handles;
+    if (FAILED(result))
+    {
+        throw OPCException(L"COPCGroup::setItemsBuffered: FAILED to set item buffering", result);
+    }
+
+    int errorCount = 0;
+    for (unsigned i = 0; i < nbrItems; ++i)
+    {
+        errors[i] = results[i];
+        if (FAILED(results[i]))
+        {
+            ++errorCount;
+        }
+    } // for
+
+    COPCClient::comFree(results);
+    return errorCount;
+
+} // COPCGroup::setItemsBuffered
+
 OPCHANDLE COPCGroup::addItemData(COPCItemDataMap &opcItemDataMap, COPCItem *item, HRESULT error)
 {
     OPCHANDLE handle = getOpcHandle(item);
@@ -576,6 +1073,7 @@ bool COPCGroup::lookupOpcItem(OPCHANDLE handle, COPCItem *&item)
     item = nullptr;
     bool result = false;
     OPCItemData *itemData = nullptr;
+    ATL::CComCritSecLock<ATL::CComAutoCriticalSection> lock(LastKnownLock);
     if ((result = GroupItemDataMap.Lookup(handle, itemData)) && itemData)
     {
         item = itemData->item();
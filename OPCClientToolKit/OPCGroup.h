@@ -49,9 +49,19 @@ class OPCDACLIENT_API COPCGroup
   private:
     ATL::CComPtr<IOPCGroupStateMgt> iStateManagement;
     ATL::CComPtr<IOPCSyncIO> iSyncIO;
+
+    /**
+     * DA 3.0 synchronous I/O, null if the server does not support it
+     */
+    ATL::CComPtr<IOPCSyncIO2> iSyncIO2;
     ATL::CComPtr<IOPCAsyncIO2> iAsync2IO;
     ATL::CComPtr<IOPCItemMgt> iItemManagement;
 
+    /**
+     * DA 3.0 per item sampling rate and buffering, null if the server does not support it
+     */
+    ATL::CComPtr<IOPCItemSamplingMgt> iSamplingManagement;
+
     /**
      * used to keep track of the connection point for AsyncDataCallback
      */
@@ -74,9 +84,16 @@ class OPCDACLIENT_API COPCGroup
 
     /**
      * map of OPC items associated with this goup. Not owned (at the moment!)
+     * Also holds the last known value of each item, updated by refreshs and async data changes.
      */
     COPCItemDataMap GroupItemDataMap;
 
+    /**
+     * guards GroupItemDataMap, its items and last known values, against concurrent callbacks. Recursive, so the
+     * callbacks may look up items while holding it
+     */
+    ATL::CComAutoCriticalSection LastKnownLock;
+
     CAtlMap<DWORD, CTransaction *> TransactionMap;
 
     /**
@@ -96,17 +113,37 @@ class OPCDACLIENT_API COPCGroup
     IAsyncDataCallback *UserAsyncCBHandler;
     CAsyncDataCallback *_CAsyncDataCallback;
 
+    /**
+     * set by abandon(), the destructor then makes no COM call
+     */
+    bool Abandoned;
+
     /**
      * Caller owns returned array
      */
     OPCHANDLE *buildServerHandleList(std::vector<COPCItem *> &items);
 
+    /**
+     * mark all items still registered in the group as removed and return them. The items stay owned by the caller.
+     */
+    void detachItems(std::vector<COPCItem *> &items);
+
   public:
     COPCGroup(const std::wstring &groupName, bool active, unsigned long reqUpdateRate_ms,
               unsigned long &revisedUpdateRate_ms, float deadBand, COPCServer &server);
 
+    /**
+     * removes all items still in the group with one RemoveItems call, then the group itself. Those items are
+     * detached, not deleted: deleting them afterwards makes no COM call.
+     */
     virtual ~COPCGroup();
 
+    /**
+     * the server is gone: detach the group and its items from it, so that deleting them makes no COM call.
+     * The data callback sink is disconnected locally, no late callback can reach the group.
+     */
+    void abandon();
+
     COPCItem *addItem(std::wstring &name, bool active);
 
     bool removeItem(COPCItem *item);
@@ -118,8 +155,67 @@ class OPCDACLIENT_API COPCGroup
     int addItems(std::vector<std::wstring> &names, std::vector<COPCItem *> &items, std::vector<HRESULT> &errors,
                  bool active);
 
+    /**
+     * check item names with the server without adding them.
+     * returns the number of invalid names, errors[x] holds the result for names[x]
+     */
+    int validateItems(std::vector<std::wstring> &names, std::vector<HRESULT> &errors);
+
+    /**
+     * true if an add item error will not go away by retrying (unknown or malformed item ID)
+     */
+    static bool isPermanentItemError(HRESULT error);
+
+    /**
+     * remove and delete a set of items with one IOPCItemMgt::RemoveItems call.
+     * returns the number of failed items, errors[x] holds the result for items[x]
+     */
     int removeItems(std::vector<COPCItem *> &items, std::vector<HRESULT> &errors);
 
+    /**
+     * drop an item from the item data map of the group, no COM call is made
+     */
+    void forgetItem(COPCItem *item);
+
+    /**
+     * activate or deactivate a set of items with one IOPCItemMgt::SetActiveState call.
+     * returns the number of failed items, errors[x] holds the result for items[x]
+     */
+    int setItemsActive(std::vector<COPCItem *> &items, bool active, std::vector<HRESULT> &errors);
+
+    /**
+     * Sample items at their own rate with one IOPCItemSamplingMgt::SetItemSamplingRate call, samplingRates_ms[x]
+     * being the rate requested for items[x]. The group still calls back once per update rate; buffered items then
+     * carry every sample taken since the last update. revisedRates_ms[x] holds the rate granted by the server.
+     * returns the number of failed items, errors[x] holds the result for items[x].
+     * throws OPCException if the server does not support IOPCItemSamplingMgt
+     */
+    int setItemsSamplingRate(std::vector<COPCItem *> &items, const std::vector<DWORD> &samplingRates_ms,
+                             std::vector<DWORD> &revisedRates_ms, std::vector<HRESULT> &errors);
+
+    /**
+     * Sample items at the update rate of the group again with one IOPCItemSamplingMgt::ClearItemSamplingRate call.
+     * returns the number of failed items, errors[x] holds the result for items[x].
+     * throws OPCException if the server does not support IOPCItemSamplingMgt
+     */
+    int clearItemsSamplingRate(std::vector<COPCItem *> &items, std::vector<HRESULT> &errors);
+
+    /**
+     * Turn the server side buffer of a set of items on or off with one IOPCItemSamplingMgt::SetItemBufferEnable
+     * call. A buffered item may appear several times in one OnDataChange, see IAsyncDataCallback::OnDataSamples().
+     * returns the number of failed items, errors[x] holds the result for items[x].
+     * throws OPCException if the server does not support IOPCItemSamplingMgt
+     */
+    int setItemsBuffered(std::vector<COPCItem *> &items, bool buffered, std::vector<HRESULT> &errors);
+
+    /**
+     * true if the group supports the DA 3.0 IOPCItemSamplingMgt interface
+     */
+    bool hasSamplingManagement() const
+    {
+        return iSamplingManagement != nullptr;
+    }
+
     static OPCHANDLE getOpcHandle(void *ptr)
     {
         return static_cast<OPCHANDLE>(reinterpret_cast<uintptr_t>(ptr));
@@ -165,6 +261,20 @@ class OPCDACLIENT_API COPCGroup
      */
     void readSync(std::vector<COPCItem *> &items, COPCItemDataMap &opcData, OPCDATASOURCE source);
 
+    /**
+     * maxAge that any cached value satisfies
+     */
+    static const DWORD MAX_AGE_CACHE = 0xFFFFFFFF;
+
+    /**
+     * Read set of OPC items synchronously, from the server cache if the cached value is at most maxAge_ms old and
+     * from the device otherwise. 0 always reads the device, MAX_AGE_CACHE always the cache.
+     * DA 3.0 servers decide per item through IOPCSyncIO2::ReadMaxAge. Other servers are read from the cache first,
+     * then the items whose value is not good or whose timestamp is older than maxAge_ms are read from the device.
+     * The timestamp is that of the last change, so unchanging values go to the device more often than needed.
+     */
+    void readMaxAge(std::vector<COPCItem *> &items, DWORD maxAge_ms, COPCItemDataMap &opcData);
+
     /**
      * Read a defined group of OPC item asynchronously
      */
@@ -178,6 +288,28 @@ class OPCDACLIENT_API COPCGroup
      */
     CTransaction *refresh(OPCDATASOURCE source, ITransactionComplete *transactionCB = nullptr);
 
+    /**
+     * Delta refresh, an async operation like refresh().
+     * Results are compared with the group's last known values and only items whose value, quality or error
+     * changed are stored in the transaction object, so the complete callback sees the changes only.
+     * The full snapshot stays available through getLastKnownValues().
+     * Transaction object is owned by caller.
+     */
+    CTransaction *refreshChanges(OPCDATASOURCE source, ITransactionComplete *transactionCB = nullptr);
+
+    /**
+     * Enter results received from the server into the last known values of the group.
+     * If changes is not nullptr, a copy of every item that changed is added to it.
+     * returns the number of changed items.
+     */
+    unsigned updateLastKnownValues(DWORD count, OPCHANDLE *clientHandles, VARIANT *values, WORD *quality,
+                                   FILETIME *time, HRESULT *errors, COPCItemDataMap *changes = nullptr);
+
+    /**
+     * Copy the last known values of all items in the group into snapshot.
+     */
+    void getLastKnownValues(COPCItemDataMap &snapshot);
+
     /**
      * Cancel the async group refresh again.
      */
@@ -188,6 +320,14 @@ class OPCDACLIENT_API COPCGroup
         return iSyncIO;
     }
 
+    /**
+     * true if the group supports the DA 3.0 IOPCSyncIO2 interface
+     */
+    bool hasSyncIO2() const
+    {
+        return iSyncIO2 != nullptr;
+    }
+
     ATL::CComPtr<IOPCAsyncIO2> &getAsync2IOInterface()
     {
         return iAsync2IO;
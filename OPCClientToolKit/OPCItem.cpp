@@ -27,15 +27,22 @@ namespace opcda_client
 {
 #endif
 
-COPCItem::COPCItem(std::wstring &itemName, COPCGroup &itemGroup) : ItemName(itemName), ItemGroup(itemGroup)
+COPCItem::COPCItem(std::wstring &itemName, COPCGroup &itemGroup)
+    : ServersItemHandle(0), VtCanonicalDataType(VT_EMPTY), DwAccessRights(0), Registered(false),
+      ItemGroup(itemGroup), ItemName(itemName)
 {
 } // COPCItem::COPCItem
 
 COPCItem::~COPCItem()
 {
-    HRESULT *itemResult = nullptr;
-    ItemGroup.getItemManagementInterface()->RemoveItems(1, &ServersItemHandle, &itemResult);
-    COPCClient::comFree(itemResult);
+    // items removed in bulk by their group, or never added, cost no round trip here
+    if (Registered)
+    {
+        HRESULT *itemResult = nullptr;
+        ItemGroup.getItemManagementInterface()->RemoveItems(1, &ServersItemHandle, &itemResult);
+        COPCClient::comFree(itemResult);
+        ItemGroup.forgetItem(this);
+    }
 
 } // COPCItem::~COPCItem
 
@@ -44,6 +51,7 @@ void COPCItem::setOPCParameters(OPCHANDLE handle, VARTYPE type, DWORD dwAccess)
     ServersItemHandle = handle;
     VtCanonicalDataType = type;
     DwAccessRights = dwAccess;
+    Registered = true;
 
 } // COPCItem::setOPCParameters
 
@@ -91,6 +99,30 @@ bool COPCItem::readSync(OPCItemData &data, OPCDATASOURCE source)
 
 } // COPCItem::readSync
 
+bool COPCItem::readMaxAge(OPCItemData &data, DWORD maxAge_ms)
+{
+    std::vector<COPCItem *> items;
+    OPCHANDLE handle = COPCGroup::getOpcHandle(this);
+    items.push_back(this);
+    COPCItemDataMap opcData;
+    ItemGroup.readMaxAge(items, maxAge_ms, opcData);
+
+    COPCItemDataMap::CPair *pos = opcData.Lookup(handle);
+    if (pos)
+    {
+        OPCItemData *readData = opcData.GetValueAt(pos);
+        if (readData && !FAILED(readData->Error))
+        {
+            data = *readData;
+            return true;
+        } // if
+    }     // if
+
+    throw OPCException(L"COPCItem::readMaxAge: synchronous read FAILED");
+    return false;
+
+} // COPCItem::readMaxAge
+
 CTransaction *COPCItem::readAsync(ITransactionComplete *transactionCB)
 {
     std::vector<COPCItem *> items;
@@ -131,28 +163,7 @@ CTransaction *COPCItem::writeAsync(VARIANT &data, ITransactionComplete *transact
 
 bool COPCItem::getSupportedProperties(std::vector<CPropertyDescription> &desc)
 {
-    DWORD nbrProperties = 0;
-    DWORD *pPropertyIDs = nullptr;
-    LPWSTR *pDescriptions = nullptr;
-    VARTYPE *pvtDataTypes = nullptr;
-
-    USES_CONVERSION;
-    HRESULT result = ItemGroup.getServer().getPropertiesInterface()->QueryAvailableProperties(
-        &ItemName[0], &nbrProperties, &pPropertyIDs, &pDescriptions, &pvtDataTypes);
-    if (FAILED(result))
-    {
-        throw OPCException(L"COPCItem::getSupportedProperties: FAILED to retrieve properties", result);
-    }
-
-    for (unsigned i = 0; i < nbrProperties; ++i)
-    {
-        desc.push_back(CPropertyDescription(pPropertyIDs[i], pDescriptions[i], pvtDataTypes[i]));
-    }
-
-    COPCClient::comFree(pPropertyIDs);
-    COPCClient::comFree(pDescriptions);
-    COPCClient::comFree(pvtDataTypes);
-    return true;
+    return ItemGroup.getServer().queryAvailableProperties(ItemName, desc);
 
 } // COPCItem::getSupportedProperties
 
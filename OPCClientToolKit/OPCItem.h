@@ -45,6 +45,12 @@ class OPCDACLIENT_API COPCItem
     VARTYPE VtCanonicalDataType;
     DWORD DwAccessRights;
 
+    /**
+     * true while the item exists in the server group. Cleared by the bulk teardown of the group, the destructor
+     * then makes no COM call.
+     */
+    bool Registered;
+
     COPCGroup &ItemGroup;
 
     std::wstring ItemName;
@@ -65,6 +71,12 @@ class OPCDACLIENT_API COPCItem
 
     bool readSync(OPCItemData &data, OPCDATASOURCE source);
 
+    /**
+     * read from the server cache if the cached value is at most maxAge_ms old, from the device otherwise. See
+     * COPCGroup::readMaxAge
+     */
+    bool readMaxAge(OPCItemData &data, DWORD maxAge_ms);
+
     /**
      * returned transaction object is owned
      */
@@ -120,6 +120,81 @@ void OPCItemData::set(VARIANT &value, WORD quality, FILETIME time, HRESULT error
 
 } // OPCItemData::set
 
+bool OPCItemData::hasChanged(const VARIANT &value, WORD quality, HRESULT error) const
+{
+    if ((Error != error) || (wQuality != quality) || (vDataValue.vt != value.vt))
+    {
+        return true;
+    }
+
+    if (value.vt & VT_ARRAY)
+    {
+        SAFEARRAY *own = vDataValue.parray;
+        SAFEARRAY *other = value.parray;
+        if (!own || !other)
+        {
+            return own != other;
+        }
+
+        UINT dims = SafeArrayGetDim(own);
+        if ((dims != SafeArrayGetDim(other)) || (own->cbElements != other->cbElements))
+        {
+            return true;
+        }
+
+        ULONG nbrElements = 1;
+        for (UINT i = 0; i < dims; ++i)
+        {
+            if (own->rgsabound[i].cElements != other->rgsabound[i].cElements)
+            {
+                return true;
+            }
+            nbrElements *= own->rgsabound[i].cElements;
+        } // for
+
+        if ((value.vt & VT_TYPEMASK) == VT_BSTR || (value.vt & VT_TYPEMASK) == VT_VARIANT)
+        {
+            return true; // elements hold pointers, treat as changed rather than walking each one..
+        }
+
+        return memcmp(own->pvData, other->pvData, nbrElements * own->cbElements) != 0;
+    } // if
+
+    switch (value.vt)
+    {
+    case VT_EMPTY:
+    case VT_NULL:
+        return false;
+    case VT_BSTR: {
+        UINT length = SysStringByteLen(vDataValue.bstrVal);
+        if (length != SysStringByteLen(value.bstrVal))
+        {
+            return true;
+        }
+        return length && (memcmp(vDataValue.bstrVal, value.bstrVal, length) != 0);
+    }
+    case VT_DECIMAL:
+        return memcmp(&vDataValue.decVal, &value.decVal, sizeof(DECIMAL)) != 0;
+    case VT_I1:
+    case VT_UI1:
+        return vDataValue.bVal != value.bVal;
+    case VT_I2:
+    case VT_UI2:
+    case VT_BOOL:
+        return vDataValue.uiVal != value.uiVal;
+    case VT_I4:
+    case VT_UI4:
+    case VT_INT:
+    case VT_UINT:
+    case VT_R4:
+    case VT_ERROR:
+        return vDataValue.ulVal != value.ulVal;
+    default:
+        return vDataValue.ullVal != value.ullVal; // VT_R8, VT_CY, VT_DATE, VT_I8, VT_UI8..
+    } // switch
+
+} // OPCItemData::hasChanged
+
 COPCItemDataMap::~COPCItemDataMap()
 {
     POSITION pos = GetStartPosition();
@@ -138,13 +213,25 @@ COPCItemDataMap::~COPCItemDataMap()
 
 COPCItemDataMap &COPCItemDataMap::operator=(const COPCItemDataMap &other)
 {
-    POSITION pos = other.GetStartPosition();
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    // the values replaced are owned by this map, a reused snapshot would leak them otherwise
+    POSITION pos = GetStartPosition();
+    while (pos)
+    {
+        delete GetNextValue(pos);
+    }
+    RemoveAll();
 
+    pos = other.GetStartPosition();
     while (pos)
     {
         OPCHANDLE handle = other.GetKeyAt(pos);
-        OPCItemData *itemData = new OPCItemData(*other.GetNextValue(pos));
-        SetAt(handle, itemData);
+        const OPCItemData *otherData = other.GetNextValue(pos);
+        SetAt(handle, otherData ? new OPCItemData(*otherData) : nullptr);
     } // while
 
     return *this;
@@ -62,6 +62,11 @@ struct OPCDACLIENT_API OPCItemData
 
     void set(VARIANT &value, WORD quality, FILETIME time, HRESULT error = S_OK);
 
+    /**
+     * true if value, quality or error differ from the data held. The timestamp is not compared.
+     */
+    bool hasChanged(const VARIANT &value, WORD quality, HRESULT error = S_OK) const;
+
     COPCItem *item()
     {
         return Item;
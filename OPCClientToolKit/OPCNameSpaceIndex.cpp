@@ -0,0 +1,627 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <regex>
+
+#include "OPCNameSpaceIndex.h"
+#include "OPCServer.h"
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+namespace opcda_client
+{
+#endif
+
+/**
+ * index file layout, all integers little endian: header, server id in UTF-16 units padded to an even count, item
+ * count + 1 offsets into the pool in UTF-16 units, then the pool of sorted item ids, each terminated by a 0 unit.
+ * Item i spans offsets[i] to offsets[i + 1] - 1.
+ */
+static const char NAMESPACE_MAGIC[4] = {'O', 'P', 'C', 'N'};
+static const uint32_t NAMESPACE_VERSION = 1;
+
+struct CNameSpaceHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t timestamp;
+    uint32_t itemCount;
+    uint32_t serverIdLength;
+    uint64_t poolLength;
+};
+
+/**
+ * order of item ids, the order of std::wstring
+ */
+static int CompareId(const wchar_t *a, size_t aLength, const wchar_t *b, size_t bLength)
+{
+    int order = std::wstring::traits_type::compare(a, b, (std::min)(aLength, bLength));
+    if (order)
+    {
+        return order;
+    }
+    return aLength < bLength ? -1 : aLength > bLength ? 1 : 0;
+
+} // CompareId
+
+/**
+ * The mapped image of an index file
+ */
+class CNameSpaceView
+{
+  private:
+    HANDLE Mapping;
+    const uint8_t *Base;
+
+  public:
+    CNameSpaceHeader Header;
+    const wchar_t *ServerId;
+    const uint32_t *Offsets;
+    const wchar_t *Pool;
+
+    /// owns the mapping and its view
+    CNameSpaceView(HANDLE mapping, const uint8_t *base) : Mapping(mapping), Base(base)
+    {
+    }
+
+    ~CNameSpaceView()
+    {
+        UnmapViewOfFile(Base);
+        CloseHandle(Mapping);
+    }
+
+    /// check the image of size bytes and locate its parts
+    void parse(size_t size)
+    {
+        if (size < sizeof(CNameSpaceHeader))
+        {
+            throw OPCException(L"namespace index is truncated");
+        }
+        memcpy(&Header, Base, sizeof(Header));
+        if (memcmp(Header.magic, NAMESPACE_MAGIC, sizeof(NAMESPACE_MAGIC)) != 0 || Header.version != NAMESPACE_VERSION)
+        {
+            throw OPCException(L"namespace index has an unknown format");
+        }
+
+        size_t idUnits = (static_cast<size_t>(Header.serverIdLength) + 1) & ~static_cast<size_t>(1);
+        uint64_t expected = sizeof(CNameSpaceHeader) + idUnits * sizeof(wchar_t) +
+                            (static_cast<uint64_t>(Header.itemCount) + 1) * sizeof(uint32_t) +
+                            Header.poolLength * sizeof(wchar_t);
+        if (expected != size)
+        {
+            throw OPCException(L"namespace index is truncated");
+        }
+
+        ServerId = reinterpret_cast<const wchar_t *>(Base + sizeof(CNameSpaceHeader));
+        Offsets = reinterpret_cast<const uint32_t *>(ServerId + idUnits);
+        Pool = reinterpret_cast<const wchar_t *>(Offsets + Header.itemCount + 1);
+        if (Offsets[0] != 0 || Offsets[Header.itemCount] != Header.poolLength)
+        {
+            throw OPCException(L"namespace index is malformed");
+        }
+        for (uint32_t i = 0; i < Header.itemCount; ++i)
+        {
+            if (Offsets[i + 1] <= Offsets[i] || Pool[Offsets[i + 1] - 1] != 0)
+            {
+                throw OPCException(L"namespace index is malformed");
+            }
+        } // for
+    }
+
+    size_t count() const
+    {
+        return Header.itemCount;
+    }
+
+    /// item i, 0 terminated
+    const wchar_t *item(size_t i) const
+    {
+        return Pool + Offsets[i];
+    }
+
+    size_t length(size_t i) const
+    {
+        return Offsets[i + 1] - Offsets[i] - 1;
+    }
+
+    std::wstring serverId() const
+    {
+        return std::wstring(ServerId, Header.serverIdLength);
+    }
+
+    /// first item not ordered before key
+    size_t lowerBound(const std::wstring &key) const
+    {
+        size_t first = 0;
+        size_t last = count();
+        while (first < last)
+        {
+            size_t middle = first + (last - first) / 2;
+            if (CompareId(item(middle), length(middle), key.c_str(), key.size()) < 0)
+            {
+                first = middle + 1;
+            }
+            else
+            {
+                last = middle;
+            }
+        } // while
+        return first;
+    }
+
+    bool startsWith(size_t i, const std::wstring &prefix) const
+    {
+        return length(i) >= prefix.size() &&
+               std::wstring::traits_type::compare(item(i), prefix.c_str(), prefix.size()) == 0;
+    }
+
+}; // CNameSpaceView
+
+/**
+ * the characters a match of a regular expression must start with, empty if there are none or they cannot be told
+ */
+static std::wstring LiteralPrefix(const std::wstring &expression)
+{
+    std::wstring prefix;
+    if (expression.find(L'|') != std::wstring::npos)
+    {
+        return prefix;
+    }
+
+    for (size_t i = (!expression.empty() && expression[0] == L'^') ? 1 : 0; i < expression.size(); ++i)
+    {
+        wchar_t c = expression[i];
+        if (wcschr(L"\\^$.|?*+()[]{}", c))
+        {
+            // these quantifiers allow the last literal character to be missing
+            if ((c == L'?' || c == L'*' || c == L'{') && !prefix.empty())
+            {
+                prefix.pop_back();
+            }
+            break;
+        } // if
+        prefix += c;
+    } // for
+
+    return prefix;
+
+} // LiteralPrefix
+
+COPCNameSpaceIndex::COPCNameSpaceIndex(const std::string &fileName)
+    : FileName(fileName), MappedViews(0), StopRefresh(false)
+{
+} // COPCNameSpaceIndex::COPCNameSpaceIndex
+
+COPCNameSpaceIndex::~COPCNameSpaceIndex()
+{
+    stopRefresh();
+
+} // COPCNameSpaceIndex::~COPCNameSpaceIndex
+
+std::shared_ptr<const CNameSpaceView> COPCNameSpaceIndex::current() const
+{
+    std::lock_guard<std::mutex> lock(ViewLock);
+    return View;
+
+} // COPCNameSpaceIndex::current
+
+std::shared_ptr<const CNameSpaceView> COPCNameSpaceIndex::map(const std::string &fileName)
+{
+    // FILE_SHARE_DELETE lets update rename the file while it is mapped
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    const uint8_t *base = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(CNameSpaceHeader)))
+    {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+        {
+            base = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+    } // if
+
+    // the mapping keeps the file open
+    CloseHandle(file);
+    if (!base)
+    {
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+        return nullptr;
+    } // if
+
+    {
+        std::lock_guard<std::mutex> lock(ReleaseLock);
+        ++MappedViews;
+    }
+
+    // the view is unmapped before an update waiting to replace the file is woken
+    std::shared_ptr<CNameSpaceView> view(new CNameSpaceView(mapping, base), [this](CNameSpaceView *released) {
+        delete released;
+        {
+            std::lock_guard<std::mutex> lock(ReleaseLock);
+            --MappedViews;
+        }
+        ViewReleased.notify_all();
+    });
+    try
+    {
+        view->parse(static_cast<size_t>(fileSize.QuadPart));
+    }
+    catch (OPCException &e)
+    {
+        printf("COPCNameSpaceIndex::map: %s ignored: %ws\n", fileName.c_str(), e.reasonString().c_str());
+        return nullptr;
+    }
+    return view;
+
+} // COPCNameSpaceIndex::map
+
+bool COPCNameSpaceIndex::open()
+{
+    std::shared_ptr<const CNameSpaceView> view = map(FileName);
+    if (!view)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(ViewLock);
+    View = view;
+    return true;
+
+} // COPCNameSpaceIndex::open
+
+bool COPCNameSpaceIndex::update(const std::wstring &serverId, std::vector<std::wstring> itemIds,
+                                std::vector<std::wstring> *added, std::vector<std::wstring> *removed)
+{
+    std::lock_guard<std::mutex> updating(UpdateLock);
+    std::sort(itemIds.begin(), itemIds.end());
+    itemIds.erase(std::unique(itemIds.begin(), itemIds.end()), itemIds.end());
+
+    // both lists are sorted, one pass finds the changes
+    std::shared_ptr<const CNameSpaceView> previous = current();
+    std::vector<std::wstring> newIds;
+    std::vector<std::wstring> goneIds;
+    size_t count = previous ? previous->count() : 0;
+    for (size_t i = 0, j = 0; i < itemIds.size() || j < count;)
+    {
+        int order = i == itemIds.size()
+                        ? 1
+                        : j == count ? -1
+                                     : CompareId(itemIds[i].c_str(), itemIds[i].size(), previous->item(j),
+                                                 previous->length(j));
+        if (order < 0)
+        {
+            newIds.push_back(itemIds[i++]);
+        }
+        else if (order > 0)
+        {
+            goneIds.emplace_back(previous->item(j), previous->length(j));
+            ++j;
+        }
+        else
+        {
+            ++i;
+            ++j;
+        }
+    } // for
+
+    if (previous && previous->serverId() == serverId && newIds.empty() && goneIds.empty())
+    {
+        return false;
+    }
+
+    uint64_t poolLength = 0;
+    for (const std::wstring &itemId : itemIds)
+    {
+        poolLength += itemId.size() + 1;
+    }
+    if (poolLength > UINT32_MAX || serverId.size() > UINT32_MAX)
+    {
+        throw OPCException(L"COPCNameSpaceIndex::update: namespace too large");
+    }
+
+    CNameSpaceHeader header = {};
+    memcpy(header.magic, NAMESPACE_MAGIC, sizeof(NAMESPACE_MAGIC));
+    header.version = NAMESPACE_VERSION;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    header.timestamp = static_cast<uint64_t>(now.dwHighDateTime) << 32 | now.dwLowDateTime;
+    header.itemCount = static_cast<uint32_t>(itemIds.size());
+    header.serverIdLength = static_cast<uint32_t>(serverId.size());
+    header.poolLength = poolLength;
+
+    size_t idUnits = (serverId.size() + 1) & ~static_cast<size_t>(1);
+    std::vector<uint32_t> offsets;
+    offsets.reserve(itemIds.size() + 1);
+    uint32_t offset = 0;
+    for (const std::wstring &itemId : itemIds)
+    {
+        offsets.push_back(offset);
+        offset += static_cast<uint32_t>(itemId.size() + 1);
+    } // for
+    offsets.push_back(offset);
+
+    // written next to the index and mapped from there, so a reader never maps a half written file
+    const std::string tempFile = FileName + ".tmp";
+    {
+        std::ofstream ofs(tempFile, std::ios::binary | std::ios::trunc);
+        std::wstring paddedId(serverId);
+        paddedId.resize(idUnits, 0);
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char *>(paddedId.data()), idUnits * sizeof(wchar_t));
+        ofs.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint32_t));
+        for (const std::wstring &itemId : itemIds)
+        {
+            ofs.write(reinterpret_cast<const char *>(itemId.c_str()), (itemId.size() + 1) * sizeof(wchar_t));
+        }
+        if (!ofs.good())
+        {
+            throw OPCException(L"COPCNameSpaceIndex::update: write FAILED");
+        }
+    }
+
+    std::shared_ptr<const CNameSpaceView> view = map(tempFile);
+    if (!view)
+    {
+        DeleteFileA(tempFile.c_str());
+        throw OPCException(L"COPCNameSpaceIndex::update: mapping the new index FAILED");
+    } // if
+
+    previous.reset();
+    {
+        std::lock_guard<std::mutex> lock(ViewLock);
+        View = view;
+    }
+
+    // a mapped file cannot be replaced, queries hold the old view only for their own duration. The new view stays
+    // valid when its file is renamed
+    {
+        std::unique_lock<std::mutex> lock(ReleaseLock);
+        ViewReleased.wait(lock, [this] { return MappedViews <= 1; });
+    }
+
+    if (!MoveFileExA(tempFile.c_str(), FileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        throw OPCException(L"COPCNameSpaceIndex::update: replacing the index file FAILED");
+    } // if
+
+    if (added)
+    {
+        added->swap(newIds);
+    }
+    if (removed)
+    {
+        removed->swap(goneIds);
+    }
+    return true;
+
+} // COPCNameSpaceIndex::update
+
+std::wstring COPCNameSpaceIndex::getServerId() const
+{
+    std::shared_ptr<const CNameSpaceView> view = current();
+    return view ? view->serverId() : std::wstring();
+
+} // COPCNameSpaceIndex::getServerId
+
+FILETIME COPCNameSpaceIndex::getTimestamp() const
+{
+    FILETIME timestamp = {0, 0};
+    std::shared_ptr<const CNameSpaceView> view = current();
+    if (view)
+    {
+        timestamp.dwLowDateTime = static_cast<DWORD>(view->Header.timestamp);
+        timestamp.dwHighDateTime = static_cast<DWORD>(view->Header.timestamp >> 32);
+    } // if
+    return timestamp;
+
+} // COPCNameSpaceIndex::getTimestamp
+
+size_t COPCNameSpaceIndex::size() const
+{
+    std::shared_ptr<const CNameSpaceView> view = current();
+    return view ? view->count() : 0;
+
+} // COPCNameSpaceIndex::size
+
+size_t COPCNameSpaceIndex::findPrefix(const std::wstring &prefix, std::vector<std::wstring> &itemIds,
+                                      size_t limit) const
+{
+    std::shared_ptr<const CNameSpaceView> view = current();
+    if (!view)
+    {
+        return 0;
+    }
+
+    size_t found = 0;
+    for (size_t i = view->lowerBound(prefix); i < view->count() && view->startsWith(i, prefix); ++i)
+    {
+        if (limit && found == limit)
+        {
+            break;
+        }
+        itemIds.emplace_back(view->item(i), view->length(i));
+        ++found;
+    } // for
+
+    return found;
+
+} // COPCNameSpaceIndex::findPrefix
+
+size_t COPCNameSpaceIndex::findGlob(const std::wstring &pattern, std::vector<std::wstring> &itemIds,
+                                    size_t limit) const
+{
+    std::shared_ptr<const CNameSpaceView> view = current();
+    if (!view)
+    {
+        return 0;
+    }
+
+    std::wstring prefix = pattern.substr(0, pattern.find_first_of(L"*?"));
+    size_t found = 0;
+    for (size_t i = view->lowerBound(prefix); i < view->count() && view->startsWith(i, prefix); ++i)
+    {
+        if (limit && found == limit)
+        {
+            break;
+        }
+        if (COPCServer::matchPattern(pattern.c_str(), view->item(i)))
+        {
+            itemIds.emplace_back(view->item(i), view->length(i));
+            ++found;
+        } // if
+    }     // for
+
+    return found;
+
+} // COPCNameSpaceIndex::findGlob
+
+size_t COPCNameSpaceIndex::findRegex(const std::wstring &expression, std::vector<std::wstring> &itemIds,
+                                     size_t limit) const
+{
+    std::wregex regex;
+    try
+    {
+        regex.assign(expression, std::regex::ECMAScript | std::regex::optimize);
+    }
+    catch (const std::regex_error &)
+    {
+        throw OPCException(L"COPCNameSpaceIndex::findRegex: malformed expression");
+    }
+
+    std::shared_ptr<const CNameSpaceView> view = current();
+    if (!view)
+    {
+        return 0;
+    }
+
+    std::wstring prefix = LiteralPrefix(expression);
+    size_t found = 0;
+    for (size_t i = view->lowerBound(prefix); i < view->count() && view->startsWith(i, prefix); ++i)
+    {
+        if (limit && found == limit)
+        {
+            break;
+        }
+        if (std::regex_match(view->item(i), view->item(i) + view->length(i), regex))
+        {
+            itemIds.emplace_back(view->item(i), view->length(i));
+            ++found;
+        } // if
+    }     // for
+
+    return found;
+
+} // COPCNameSpaceIndex::findRegex
+
+void COPCNameSpaceIndex::refresh(std::wstring serverId, BrowseFunction browse, unsigned long interval_ms,
+                                 ChangeFunction changed)
+{
+    bool initialised = false;
+    try
+    {
+        initialised = COPCClient::init(MULTITHREADED);
+    }
+    catch (OPCException &e)
+    {
+        printf("COPCNameSpaceIndex::refresh: %ws\n", e.reasonString().c_str());
+    }
+
+    // an empty index is filled right away
+    bool due = !current();
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(RefreshLock);
+            if (!due &&
+                RefreshWake.wait_for(lock, std::chrono::milliseconds(interval_ms), [this] { return StopRefresh; }))
+            {
+                break;
+            }
+            if (StopRefresh)
+            {
+                break;
+            }
+        }
+        due = false;
+
+        try
+        {
+            std::vector<std::wstring> itemIds;
+            std::vector<std::wstring> added;
+            std::vector<std::wstring> removed;
+            if (browse(itemIds) && update(serverId, std::move(itemIds), &added, &removed) && changed)
+            {
+                changed(added, removed);
+            }
+        }
+        catch (OPCException &e)
+        {
+            printf("COPCNameSpaceIndex::refresh: %ws\n", e.reasonString().c_str());
+        }
+    } // for
+
+    if (initialised)
+    {
+        COPCClient::stop();
+    }
+
+} // COPCNameSpaceIndex::refresh
+
+void COPCNameSpaceIndex::startRefresh(const std::wstring &serverId, BrowseFunction browse, unsigned long interval_ms,
+                                      ChangeFunction changed)
+{
+    stopRefresh();
+    StopRefresh = false;
+    Refresher = std::thread(&COPCNameSpaceIndex::refresh, this, serverId, browse, interval_ms, changed);
+
+} // COPCNameSpaceIndex::startRefresh
+
+void COPCNameSpaceIndex::stopRefresh()
+{
+    {
+        std::lock_guard<std::mutex> lock(RefreshLock);
+        StopRefresh = true;
+    }
+    RefreshWake.notify_all();
+    if (Refresher.joinable())
+    {
+        Refresher.join();
+    }
+
+} // COPCNameSpaceIndex::stopRefresh
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+} // namespace opcda_client
+#endif
@@ -0,0 +1,153 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#pragma once
+
+#pragma warning(disable : 4251) // can be ignored if deriving from a type in the Standard C++ Library..
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OPCClient.h"
+#include "OPCClientToolKitDLL.h"
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+namespace opcda_client
+{
+#endif
+
+class CNameSpaceView;
+
+/**
+ * Persistent snapshot of a server's namespace: the sorted item ids, the identity of the server and the time of the
+ * browse, kept in a file that is memory mapped when opened. Prefix, wildcard and regex queries are answered from the
+ * sorted ids without calling the server. A refresh thread may browse the server periodically; the file is only
+ * rewritten when items were added or removed.
+ * Queries may run on any thread, also while the index is refreshed.
+ */
+class OPCDACLIENT_API COPCNameSpaceIndex
+{
+  public:
+    /**
+     * fills the item ids of the server, called on the refresh thread after COPCClient::init(MULTITHREADED)
+     */
+    typedef std::function<bool(std::vector<std::wstring> &itemIds)> BrowseFunction;
+
+    /**
+     * told about the item ids a refresh added and removed, both sorted
+     */
+    typedef std::function<void(const std::vector<std::wstring> &added, const std::vector<std::wstring> &removed)>
+        ChangeFunction;
+
+  private:
+    std::string FileName;
+
+    /// views still mapped, an update replaces the file once only its own view is left
+    size_t MappedViews;
+    std::mutex ReleaseLock;
+    std::condition_variable ViewReleased;
+
+    std::shared_ptr<const CNameSpaceView> View;
+    mutable std::mutex ViewLock;
+
+    /// serialises updates of the file
+    std::mutex UpdateLock;
+
+    std::thread Refresher;
+    std::mutex RefreshLock;
+    std::condition_variable RefreshWake;
+    bool StopRefresh;
+
+    std::shared_ptr<const CNameSpaceView> current() const;
+
+    /**
+     * map and check an index file, null if it is missing or malformed
+     */
+    std::shared_ptr<const CNameSpaceView> map(const std::string &fileName);
+
+    void refresh(std::wstring serverId, BrowseFunction browse, unsigned long interval_ms, ChangeFunction changed);
+
+  public:
+    explicit COPCNameSpaceIndex(const std::string &fileName);
+
+    virtual ~COPCNameSpaceIndex();
+
+    COPCNameSpaceIndex(const COPCNameSpaceIndex &) = delete;
+
+    COPCNameSpaceIndex &operator=(const COPCNameSpaceIndex &) = delete;
+
+    /**
+     * map the index file. returns false if it is missing or malformed, the index is empty then
+     */
+    bool open();
+
+    /**
+     * replace the snapshot by itemIds of the server serverId, stamped with the current time. The items added and
+     * removed since the previous snapshot are stored in added and removed when given.
+     * returns false if nothing changed, the file is not rewritten then.
+     */
+    bool update(const std::wstring &serverId, std::vector<std::wstring> itemIds,
+                std::vector<std::wstring> *added = nullptr, std::vector<std::wstring> *removed = nullptr);
+
+    std::wstring getServerId() const;
+
+    /**
+     * UTC time of the browse the snapshot was taken from
+     */
+    FILETIME getTimestamp() const;
+
+    size_t size() const;
+
+    /**
+     * append the ids starting with prefix, at most limit of them unless limit is 0. returns the number appended
+     */
+    size_t findPrefix(const std::wstring &prefix, std::vector<std::wstring> &itemIds, size_t limit = 0) const;
+
+    /**
+     * append the ids matching a pattern where '*' matches any run of characters and '?' one character.
+     * Only the ids starting with the characters before the first wildcard are looked at
+     */
+    size_t findGlob(const std::wstring &pattern, std::vector<std::wstring> &itemIds, size_t limit = 0) const;
+
+    /**
+     * append the ids matching an ECMAScript regular expression as a whole. A literal prefix of the expression narrows
+     * the ids looked at. throws OPCException if the expression is malformed
+     */
+    size_t findRegex(const std::wstring &expression, std::vector<std::wstring> &itemIds, size_t limit = 0) const;
+
+    /**
+     * browse the server every interval_ms on a thread of its own and update the snapshot. changed is called after
+     * each refresh that added or removed items
+     */
+    void startRefresh(const std::wstring &serverId, BrowseFunction browse, unsigned long interval_ms,
+                      ChangeFunction changed = ChangeFunction());
+
+    void stopRefresh();
+
+}; // COPCNameSpaceIndex
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+} // namespace opcda_client
+#endif
@@ -0,0 +1,253 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#include <algorithm>
+#include <fstream>
+
+#include "OPCHost.h"
+#include "OPCNameSpaceSnapshot.h"
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+namespace opcda_client
+{
+#endif
+
+/**
+ * FNV-1a over the id and the type, mixed so that sums of item hashes do not cancel out easily
+ */
+static uint64_t ItemHash(const NameSpaceItem &item)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (wchar_t c : item.itemId)
+    {
+        hash = (hash ^ static_cast<uint64_t>(c)) * 1099511628211ULL;
+    }
+    hash = (hash ^ item.type) * 1099511628211ULL;
+
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+
+} // ItemHash
+
+static bool IdLess(const NameSpaceItem &a, const NameSpaceItem &b)
+{
+    return a.itemId < b.itemId;
+
+} // IdLess
+
+COPCNameSpaceSnapshot::COPCNameSpaceSnapshot() : Sums(1, 0)
+{
+} // COPCNameSpaceSnapshot::COPCNameSpaceSnapshot
+
+COPCNameSpaceSnapshot::COPCNameSpaceSnapshot(std::vector<NameSpaceItem> items) : Items(std::move(items))
+{
+    index();
+
+} // COPCNameSpaceSnapshot::COPCNameSpaceSnapshot
+
+void COPCNameSpaceSnapshot::index()
+{
+    std::sort(Items.begin(), Items.end(), IdLess);
+    Items.erase(std::unique(Items.begin(), Items.end(),
+                            [](const NameSpaceItem &a, const NameSpaceItem &b) { return a.itemId == b.itemId; }),
+                Items.end());
+
+    Sums.assign(Items.size() + 1, 0);
+    for (size_t i = 0; i < Items.size(); ++i)
+    {
+        Sums[i + 1] = Sums[i] + ItemHash(Items[i]);
+    }
+
+} // COPCNameSpaceSnapshot::index
+
+size_t COPCNameSpaceSnapshot::prefixEnd(const std::wstring &prefix, size_t first, size_t last) const
+{
+    // the first id after all those starting with prefix starts with the prefix whose last character is incremented,
+    // prefixes end with a separator so the increment does not overflow
+    NameSpaceItem bound;
+    bound.itemId = prefix;
+    ++bound.itemId.back();
+    bound.type = VT_EMPTY;
+    return std::lower_bound(Items.begin() + first, Items.begin() + last, bound, IdLess) - Items.begin();
+
+} // COPCNameSpaceSnapshot::prefixEnd
+
+bool COPCNameSpaceSnapshot::capture(COPCServer &server, const BrowseOptions &options)
+{
+    BrowseOptions typed(options);
+    typed.properties.assign(1, OPC_PROPERTY_DATATYPE);
+    std::vector<BrowseElement> elements;
+    if (!server.browseElements(elements, typed))
+    {
+        return false;
+    }
+
+    std::vector<NameSpaceItem> items;
+    items.reserve(elements.size());
+    for (BrowseElement &element : elements)
+    {
+        if (element.itemId.empty())
+        {
+            continue;
+        }
+
+        NameSpaceItem item;
+        item.itemId = std::move(element.itemId);
+        item.type = VT_EMPTY;
+        ATL::CComVariant type;
+        if (!element.properties.empty() && SUCCEEDED(type.ChangeType(VT_I2, &element.properties.front())))
+        {
+            item.type = static_cast<VARTYPE>(type.iVal);
+        }
+        items.push_back(std::move(item));
+    } // for
+
+    Items.swap(items);
+    index();
+    return true;
+
+} // COPCNameSpaceSnapshot::capture
+
+bool COPCNameSpaceSnapshot::load(const std::string &fileName)
+{
+    std::ifstream ifs(fileName, std::ios::binary);
+    if (!ifs)
+    {
+        return false;
+    }
+
+    std::vector<NameSpaceItem> items;
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (line.empty())
+        {
+            continue;
+        }
+
+        NameSpaceItem item;
+        item.type = VT_EMPTY;
+        size_t tab = line.rfind('\t');
+        if (tab != std::string::npos && tab + 1 < line.size() &&
+            std::all_of(line.begin() + tab + 1, line.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        {
+            item.type = static_cast<VARTYPE>(std::stoul(line.substr(tab + 1)));
+            line.resize(tab);
+        } // if
+
+        item.itemId = COPCHost::S2WS(line);
+        items.push_back(std::move(item));
+    } // while
+
+    Items.swap(items);
+    index();
+    return true;
+
+} // COPCNameSpaceSnapshot::load
+
+bool COPCNameSpaceSnapshot::save(const std::string &fileName) const
+{
+    std::ofstream ofs(fileName, std::ios::binary | std::ios::trunc);
+    if (!ofs)
+    {
+        return false;
+    }
+
+    for (const NameSpaceItem &item : Items)
+    {
+        ofs << COPCHost::WS2S(item.itemId) << '\t' << item.type << '\n';
+    }
+
+    ofs.close();
+    return !ofs.fail();
+
+} // COPCNameSpaceSnapshot::save
+
+void COPCNameSpaceSnapshot::diffBranch(const COPCNameSpaceSnapshot &older, size_t olderFirst, size_t olderLast,
+                                       const COPCNameSpaceSnapshot &newer, size_t newerFirst, size_t newerLast,
+                                       size_t prefixLength, const std::wstring &separators, NameSpaceDiff &result)
+{
+    if (olderLast - olderFirst == newerLast - newerFirst &&
+        older.rangeHash(olderFirst, olderLast) == newer.rangeHash(newerFirst, newerLast))
+    {
+        result.skipped += olderLast - olderFirst;
+        return;
+    } // if
+
+    // walk the children of the branch in id order, leaves are compared and sub branches descended
+    size_t i = olderFirst;
+    size_t j = newerFirst;
+    while (i < olderLast || j < newerLast)
+    {
+        bool olderFirstInOrder = j >= newerLast || (i < olderLast && older.Items[i].itemId < newer.Items[j].itemId);
+        const std::wstring &id = olderFirstInOrder ? older.Items[i].itemId : newer.Items[j].itemId;
+        size_t cut = id.find_first_of(separators, prefixLength);
+        if (cut == std::wstring::npos)
+        {
+            bool inOlder = i < olderLast && older.Items[i].itemId == id;
+            bool inNewer = j < newerLast && newer.Items[j].itemId == id;
+            if (inOlder && inNewer)
+            {
+                VARTYPE oldType = older.Items[i].type;
+                VARTYPE newType = newer.Items[j].type;
+                if (oldType != newType && oldType != VT_EMPTY && newType != VT_EMPTY)
+                {
+                    result.typeChanged.push_back(NameSpaceTypeChange{id, oldType, newType});
+                }
+                ++i;
+                ++j;
+            } // if
+            else if (inOlder)
+            {
+                result.removed.push_back(older.Items[i++]);
+            }
+            else
+            {
+                result.added.push_back(newer.Items[j++]);
+            }
+            continue;
+        } // if
+
+        std::wstring branch = id.substr(0, cut + 1);
+        size_t olderEnd = older.prefixEnd(branch, i, olderLast);
+        size_t newerEnd = newer.prefixEnd(branch, j, newerLast);
+        diffBranch(older, i, olderEnd, newer, j, newerEnd, branch.size(), separators, result);
+        i = olderEnd;
+        j = newerEnd;
+    } // while
+
+} // COPCNameSpaceSnapshot::diffBranch
+
+void COPCNameSpaceSnapshot::diff(const COPCNameSpaceSnapshot &older, const COPCNameSpaceSnapshot &newer,
+                                 NameSpaceDiff &result, const std::wstring &separators)
+{
+    result = NameSpaceDiff();
+    diffBranch(older, 0, older.Items.size(), newer, 0, newer.Items.size(), 0, separators, result);
+
+} // COPCNameSpaceSnapshot::diff
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+} // namespace opcda_client
+#endif
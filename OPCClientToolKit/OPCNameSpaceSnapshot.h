@@ -0,0 +1,163 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#pragma once
+
+#pragma warning(disable : 4251) // can be ignored if deriving from a type in the Standard C++ Library..
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "OPCClient.h"
+#include "OPCClientToolKitDLL.h"
+#include "OPCServer.h"
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+namespace opcda_client
+{
+#endif
+
+/**
+ * an item of a namespace snapshot and its canonical data type, VT_EMPTY if not known
+ */
+struct NameSpaceItem
+{
+    std::wstring itemId;
+    VARTYPE type;
+
+}; // NameSpaceItem
+
+/**
+ * an item whose canonical data type differs between two snapshots
+ */
+struct NameSpaceTypeChange
+{
+    std::wstring itemId;
+    VARTYPE oldType;
+    VARTYPE newType;
+
+}; // NameSpaceTypeChange
+
+/**
+ * Differences between two namespace snapshots, each list sorted by item id
+ */
+struct NameSpaceDiff
+{
+    std::vector<NameSpaceItem> added;
+    std::vector<NameSpaceItem> removed;
+    std::vector<NameSpaceTypeChange> typeChanged;
+
+    /**
+     * items of branches found identical by their hash, these were not compared one by one
+     */
+    size_t skipped;
+
+    NameSpaceDiff() : skipped(0)
+    {
+    }
+
+    bool empty() const
+    {
+        return added.empty() && removed.empty() && typeChanged.empty();
+    }
+
+}; // NameSpaceDiff
+
+/**
+ * Item ids and canonical data types of a server's namespace at one point in time. Items are kept sorted by id, so the
+ * items of a branch, the ids sharing a prefix that ends with a separator, are contiguous. A hash of every range is
+ * available in constant time, which lets diff skip the branches two snapshots have in common without comparing their
+ * items.
+ */
+class OPCDACLIENT_API COPCNameSpaceSnapshot
+{
+  private:
+    std::vector<NameSpaceItem> Items;
+
+    /**
+     * Sums[i] is the sum of the hashes of Items[0, i), the hash of a range is the difference of two sums
+     */
+    std::vector<uint64_t> Sums;
+
+    /**
+     * sort the items, drop duplicate ids and compute the sums
+     */
+    void index();
+
+    uint64_t rangeHash(size_t first, size_t last) const
+    {
+        return Sums[last] - Sums[first];
+    }
+
+    /**
+     * end of the items in [first, last) starting with prefix, which must not sort before Items[first]
+     */
+    size_t prefixEnd(const std::wstring &prefix, size_t first, size_t last) const;
+
+    static void diffBranch(const COPCNameSpaceSnapshot &older, size_t olderFirst, size_t olderLast,
+                           const COPCNameSpaceSnapshot &newer, size_t newerFirst, size_t newerLast, size_t prefixLength,
+                           const std::wstring &separators, NameSpaceDiff &result);
+
+  public:
+    COPCNameSpaceSnapshot();
+
+    explicit COPCNameSpaceSnapshot(std::vector<NameSpaceItem> items);
+
+    /**
+     * Browse the namespace of the server together with the canonical data type of each item, replacing the items
+     * held. returns false if the server does not support browsing, the snapshot is left unchanged then.
+     */
+    bool capture(COPCServer &server, const BrowseOptions &options = BrowseOptions());
+
+    /**
+     * read a snapshot written by save. Files of item ids only, one per line like those of recordNameSpace, load with
+     * unknown types. returns false if the file cannot be read
+     */
+    bool load(const std::string &fileName);
+
+    /**
+     * write one item per line, the id in UTF-8 followed by a tab and the data type in decimal
+     */
+    bool save(const std::string &fileName) const;
+
+    const std::vector<NameSpaceItem> &getItems() const
+    {
+        return Items;
+    }
+
+    size_t size() const
+    {
+        return Items.size();
+    }
+
+    /**
+     * Compare two snapshots of a server. Branches are the id prefixes ending with one of separators; a branch whose
+     * items hash the same in both snapshots is skipped, the others are descended. A type is only compared if both
+     * snapshots know it.
+     */
+    static void diff(const COPCNameSpaceSnapshot &older, const COPCNameSpaceSnapshot &newer, NameSpaceDiff &result,
+                     const std::wstring &separators = L"./\\");
+
+}; // COPCNameSpaceSnapshot
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+} // namespace opcda_client
+#endif
@@ -0,0 +1,261 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <thread>
+
+#include "OPCItem.h"
+#include "OPCPropertyService.h"
+#include "OPCServer.h"
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+namespace opcda_client
+{
+#endif
+
+/**
+ * items per fetch, DA 3.0 servers take a batch in one IOPCBrowse::GetProperties call, others one call per item
+ */
+static const size_t BATCH_SIZE_BROWSE3 = 256;
+static const size_t BATCH_SIZE_ITEMS = 16;
+
+COPCPropertyService::COPCPropertyService(COPCServer &server, size_t threads, unsigned long timeToLive_ms)
+    : Server(server), Threads(threads ? threads : 1), TimeToLive_ms(timeToLive_ms)
+{
+} // COPCPropertyService::COPCPropertyService
+
+bool COPCPropertyService::getSupportedProperties(const std::wstring &itemId, VARTYPE type,
+                                                 std::vector<CPropertyDescription> &desc)
+{
+    if (type != VT_EMPTY)
+    {
+        std::lock_guard<std::mutex> lock(CacheLock);
+        auto cached = Descriptions.find(type);
+        if (cached != Descriptions.end())
+        {
+            desc.insert(desc.end(), cached->second.begin(), cached->second.end());
+            return true;
+        } // if
+    }     // if
+
+    std::vector<CPropertyDescription> queried;
+    if (!Server.queryAvailableProperties(itemId, queried))
+    {
+        return false;
+    }
+
+    if (type != VT_EMPTY)
+    {
+        std::lock_guard<std::mutex> lock(CacheLock);
+        Descriptions.emplace(type, queried);
+    }
+
+    desc.insert(desc.end(), queried.begin(), queried.end());
+    return true;
+
+} // COPCPropertyService::getSupportedProperties
+
+bool COPCPropertyService::getSupportedProperties(const COPCItem &item, std::vector<CPropertyDescription> &desc)
+{
+    return getSupportedProperties(item.getName(), item.getDataType(), desc);
+
+} // COPCPropertyService::getSupportedProperties
+
+void COPCPropertyService::getProperties(const std::vector<std::wstring> &itemIds, const std::vector<DWORD> &propertyIds,
+                                        std::vector<std::vector<ATL::CComVariant>> &values)
+{
+    values.assign(itemIds.size(), std::vector<ATL::CComVariant>(propertyIds.size()));
+    if (itemIds.empty() || propertyIds.empty())
+    {
+        return;
+    }
+
+    // an item is fetched again if any of the properties asked for is not cached or has expired
+    std::vector<size_t> missing;
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(CacheLock);
+        for (size_t i = 0; i < itemIds.size(); ++i)
+        {
+            auto item = Values.find(itemIds[i]);
+            bool cached = item != Values.end();
+            for (size_t p = 0; cached && p < propertyIds.size(); ++p)
+            {
+                auto value = item->second.find(propertyIds[p]);
+                cached = value != item->second.end() && value->second.expires > now;
+                if (cached)
+                {
+                    values[i][p] = value->second.value;
+                }
+            } // for
+
+            if (!cached)
+            {
+                missing.push_back(i);
+            }
+        } // for
+    }
+
+    if (missing.empty())
+    {
+        return;
+    }
+
+    std::vector<std::wstring> fetchIds;
+    fetchIds.reserve(missing.size());
+    for (size_t i : missing)
+    {
+        fetchIds.push_back(itemIds[i]);
+    }
+
+    std::vector<std::vector<ATL::CComVariant>> fetched;
+    fetch(fetchIds, propertyIds, fetched);
+
+    unsigned long timeToLive_ms = TimeToLive_ms;
+    auto now = std::chrono::steady_clock::now();
+    auto expires = now + std::chrono::milliseconds(timeToLive_ms);
+    std::lock_guard<std::mutex> lock(CacheLock);
+    if (now >= NextPrune)
+    {
+        prune(now);
+        NextPrune = expires;
+    } // if
+
+    for (size_t k = 0; k < missing.size(); ++k)
+    {
+        if (timeToLive_ms)
+        {
+            std::unordered_map<DWORD, CachedValue> &cache = Values[fetchIds[k]];
+            for (size_t p = 0; p < propertyIds.size(); ++p)
+            {
+                cache[propertyIds[p]] = CachedValue{fetched[k][p], expires};
+            }
+        } // if
+
+        values[missing[k]].swap(fetched[k]);
+    } // for
+
+} // COPCPropertyService::getProperties
+
+void COPCPropertyService::prune(std::chrono::steady_clock::time_point now)
+{
+    for (auto item = Values.begin(); item != Values.end();)
+    {
+        for (auto value = item->second.begin(); value != item->second.end();)
+        {
+            value = value->second.expires > now ? std::next(value) : item->second.erase(value);
+        }
+        item = item->second.empty() ? Values.erase(item) : std::next(item);
+    } // for
+
+} // COPCPropertyService::prune
+
+void COPCPropertyService::fetch(const std::vector<std::wstring> &itemIds, const std::vector<DWORD> &propertyIds,
+                                std::vector<std::vector<ATL::CComVariant>> &values)
+{
+    values.resize(itemIds.size());
+    size_t batchSize = Server.hasBrowse3() ? BATCH_SIZE_BROWSE3 : BATCH_SIZE_ITEMS;
+    size_t batches = (itemIds.size() + batchSize - 1) / batchSize;
+    auto fetchBatch = [&](size_t batch) {
+        size_t first = batch * batchSize;
+        size_t last = (std::min)(first + batchSize, itemIds.size());
+        std::vector<std::wstring> batchIds(itemIds.begin() + first, itemIds.begin() + last);
+        std::vector<std::vector<ATL::CComVariant>> batchValues;
+        Server.getItemProperties(batchIds, propertyIds, batchValues);
+        for (size_t k = 0; k < batchValues.size(); ++k)
+        {
+            values[first + k].swap(batchValues[k]);
+        }
+    };
+
+    // the interfaces of the server may only be shared with other threads of the multithreaded apartment
+    APTTYPE type = APTTYPE_CURRENT;
+    APTTYPEQUALIFIER qualifier = APTTYPEQUALIFIER_NONE;
+    size_t threads = (std::min)(Threads, batches);
+    if (threads <= 1 || FAILED(CoGetApartmentType(&type, &qualifier)) || type != APTTYPE_MTA)
+    {
+        for (size_t batch = 0; batch < batches; ++batch)
+        {
+            fetchBatch(batch);
+        }
+        return;
+    } // if
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr failure;
+    std::mutex failureLock;
+    auto work = [&](bool joined) {
+        bool initialised = false;
+        try
+        {
+            initialised = joined && COPCClient::init(MULTITHREADED);
+            for (size_t batch = next++; batch < batches; batch = next++)
+            {
+                fetchBatch(batch);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(failureLock);
+            if (!failure)
+            {
+                failure = std::current_exception();
+            }
+            next = batches;
+        } // catch
+
+        if (initialised)
+        {
+            COPCClient::stop();
+        }
+    };
+
+    // the calling thread fetches too
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; ++i)
+    {
+        workers.emplace_back(work, true);
+    }
+    work(false);
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+
+} // COPCPropertyService::fetch
+
+void COPCPropertyService::clear()
+{
+    std::lock_guard<std::mutex> lock(CacheLock);
+    Descriptions.clear();
+    Values.clear();
+
+} // COPCPropertyService::clear
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+} // namespace opcda_client
+#endif
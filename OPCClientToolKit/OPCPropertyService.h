@@ -0,0 +1,128 @@
+/*
+OPCClientToolKit
+Copyright (C) 2005 Mark C. Beharrell
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+Boston, MA  02111-1307, USA.
+*/
+
+#pragma once
+
+#pragma warning(disable : 4251) // can be ignored if deriving from a type in the Standard C++ Library..
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "OPCClient.h"
+#include "OPCClientToolKitDLL.h"
+#include "OPCProperties.h"
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+namespace opcda_client
+{
+#endif
+
+class COPCItem;
+class COPCServer;
+
+/**
+ * Item properties of one server, fetched in batches and kept in memory. Property descriptions are cached per
+ * canonical data type, assuming items of one type offer the same properties. Property values are cached per item for
+ * a time to live. Items missing from the cache are fetched in batches, several batches at once when the calling
+ * thread is in the multithreaded apartment.
+ * All members may be called from several threads at once.
+ */
+class OPCDACLIENT_API COPCPropertyService
+{
+  private:
+    struct CachedValue
+    {
+        ATL::CComVariant value;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    /**
+     * NOT OWNED.
+     */
+    COPCServer &Server;
+
+    size_t Threads;
+
+    std::atomic<unsigned long> TimeToLive_ms;
+
+    std::mutex CacheLock;
+
+    std::unordered_map<VARTYPE, std::vector<CPropertyDescription>> Descriptions;
+
+    std::unordered_map<std::wstring, std::unordered_map<DWORD, CachedValue>> Values;
+
+    /// the cache is swept for expired values once per time to live, when values are added after this point
+    std::chrono::steady_clock::time_point NextPrune;
+
+    /**
+     * drop the values expired at now and the items left without any, called with CacheLock held
+     */
+    void prune(std::chrono::steady_clock::time_point now);
+
+    /**
+     * ask the server for the properties of itemIds, batches run concurrently when that is safe
+     */
+    void fetch(const std::vector<std::wstring> &itemIds, const std::vector<DWORD> &propertyIds,
+               std::vector<std::vector<ATL::CComVariant>> &values);
+
+  public:
+    COPCPropertyService(COPCServer &server, size_t threads = 4, unsigned long timeToLive_ms = 60000);
+
+    COPCPropertyService(const COPCPropertyService &) = delete;
+
+    COPCPropertyService &operator=(const COPCPropertyService &) = delete;
+
+    /**
+     * how long property values are served from memory, 0 turns the value cache off
+     */
+    void setTimeToLive(unsigned long timeToLive_ms)
+    {
+        TimeToLive_ms = timeToLive_ms;
+    }
+
+    /**
+     * descriptions of the properties of itemId, queried from the server once per canonical data type. Items of
+     * unknown type (VT_EMPTY) are always queried
+     */
+    bool getSupportedProperties(const std::wstring &itemId, VARTYPE type, std::vector<CPropertyDescription> &desc);
+
+    bool getSupportedProperties(const COPCItem &item, std::vector<CPropertyDescription> &desc);
+
+    /**
+     * values of the properties propertyIds of every item, values[i][p] for itemIds[i] and propertyIds[p]. VT_EMPTY
+     * where the server has no value. Values cached within their time to live are not asked for again
+     */
+    void getProperties(const std::vector<std::wstring> &itemIds, const std::vector<DWORD> &propertyIds,
+                       std::vector<std::vector<ATL::CComVariant>> &values);
+
+    /**
+     * forget all cached descriptions and values, e.g. after the namespace of the server changed
+     */
+    void clear();
+
+}; // COPCPropertyService
+
+#ifdef OPCDA_CLIENT_NAMESPACE
+} // namespace opcda_client
+#endif
@@ -18,6 +18,13 @@ Free Software Foundation, Inc., 59 Temple Place - Suite 330,
 Boston, MA  02111-1307, USA.
 */
 
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+
+#include "OPCItem.h"
+#include "OPCPropertyService.h"
 #include "OPCServer.h"
 
 #ifdef OPCDA_CLIENT_NAMESPACE
@@ -25,12 +32,234 @@ namespace opcda_client
 {
 #endif
 
+/**
+ * items kept in the scratch group of a server without IOPCItemIO
+ */
+static const size_t SCRATCH_ITEMS = 256;
+
+/**
+ * Inactive group of the items last read or written by id, the least recently used items are removed once it holds
+ * more than its capacity.
+ */
+class CScratchGroup
+{
+  private:
+    std::unique_ptr<COPCGroup> Group;
+
+    size_t Capacity;
+
+    /// most recently used first
+    std::list<COPCItem *> Recent;
+
+    std::unordered_map<std::wstring, std::list<COPCItem *>::iterator> Items;
+
+  public:
+    CScratchGroup(COPCServer &server, size_t capacity) : Capacity(capacity)
+    {
+        unsigned long revisedUpdateRate_ms = 0;
+        Group.reset(server.makeGroup(std::wstring(), false, 0, revisedUpdateRate_ms, 0.0f));
+
+    } // CScratchGroup
+
+    ~CScratchGroup()
+    {
+        // the group removes its items with one call, deleting them afterwards makes no COM call
+        Group.reset();
+        for (COPCItem *item : Recent)
+        {
+            delete item;
+        }
+
+    } // ~CScratchGroup
+
+    COPCGroup &group()
+    {
+        return *Group;
+    }
+
+    /**
+     * the items of itemIds, added to the group if missing. items[i] is null if the server refused itemIds[i], the
+     * reason is in errors[i]
+     */
+    void acquire(const std::vector<std::wstring> &itemIds, std::vector<COPCItem *> &items,
+                 std::vector<HRESULT> &errors)
+    {
+        items.assign(itemIds.size(), nullptr);
+        errors.assign(itemIds.size(), S_OK);
+        std::vector<std::wstring> missing;
+        for (size_t i = 0; i < itemIds.size(); ++i)
+        {
+            auto found = Items.find(itemIds[i]);
+            if (found != Items.end())
+            {
+                Recent.splice(Recent.begin(), Recent, found->second);
+                items[i] = *found->second;
+            }
+            else if (std::find(missing.begin(), missing.end(), itemIds[i]) == missing.end())
+            {
+                missing.push_back(itemIds[i]);
+            }
+        } // for
+
+        if (!missing.empty())
+        {
+            std::vector<COPCItem *> added;
+            std::vector<HRESULT> addErrors;
+            Group->addItems(missing, added, addErrors, false);
+            for (size_t k = 0; k < missing.size(); ++k)
+            {
+                if (added[k])
+                {
+                    Recent.push_front(added[k]);
+                    Items[missing[k]] = Recent.begin();
+                }
+            } // for
+
+            for (size_t i = 0; i < itemIds.size(); ++i)
+            {
+                if (items[i])
+                {
+                    continue;
+                }
+                size_t k = std::find(missing.begin(), missing.end(), itemIds[i]) - missing.begin();
+                items[i] = added[k];
+                errors[i] = added[k] ? S_OK : addErrors[k];
+            } // for
+        }     // if
+
+        // the items of this call are at the front and stay, even if there are more of them than the capacity
+        size_t keep = (std::max)(Capacity, itemIds.size());
+        std::vector<COPCItem *> evicted;
+        while (Recent.size() > keep)
+        {
+            evicted.push_back(Recent.back());
+            Items.erase(Recent.back()->getName());
+            Recent.pop_back();
+        } // while
+
+        // housekeeping only: the items are out of the LRU and deleted even if the call fails, the read or write
+        // of the caller goes on
+        if (!evicted.empty())
+        {
+            try
+            {
+                std::vector<HRESULT> removeErrors;
+                Group->removeItems(evicted, removeErrors);
+            }
+            catch (OPCException &e)
+            {
+                printf("CScratchGroup::acquire: %ws\n", e.reasonString().c_str());
+            }
+        } // if
+
+    } // acquire
+
+}; // CScratchGroup
+
+/**
+ * Handles the IOPCShutdown callback of a server.
+ * This is a fake COM object.
+ */
+class CShutdownCallback : public IOPCShutdown
+{
+  private:
+    // the server may call from any RPC thread
+    LONG ReferenceCount;
+
+    /**
+     * server this is a callback for
+     */
+    COPCServer &CallbacksServer;
+
+  public:
+    CShutdownCallback(COPCServer &server) : ReferenceCount(0), CallbacksServer(server)
+    {
+    } // CShutdownCallback
+
+    virtual ~CShutdownCallback()
+    {
+    } // ~CShutdownCallback
+
+    /**
+     * Functions associated with IUNKNOWN
+     */
+    STDMETHODIMP QueryInterface(REFIID iid, LPVOID *ppInterface)
+    {
+        if (!ppInterface)
+        {
+            return E_INVALIDARG;
+        }
+
+        if (iid == IID_IUnknown)
+        {
+            *ppInterface = (IUnknown *)this;
+        }
+        else if (iid == IID_IOPCShutdown)
+        {
+            *ppInterface = (IOPCShutdown *)this;
+        }
+        else
+        {
+            *ppInterface = nullptr;
+            return E_NOINTERFACE;
+        } // else
+
+        AddRef();
+        return S_OK;
+
+    } // QueryInterface
+
+    STDMETHODIMP_(ULONG)
+
+    AddRef()
+    {
+        return InterlockedIncrement(&ReferenceCount);
+
+    } // AddRef
+
+    STDMETHODIMP_(ULONG)
+
+    Release()
+    {
+        LONG count = InterlockedDecrement(&ReferenceCount);
+
+        if (!count)
+        {
+            delete this;
+        }
+
+        return count;
+
+    } // Release
+
+    /**
+     * Functions associated with IOPCShutdown
+     */
+    STDMETHODIMP ShutdownRequest(LPCWSTR reason)
+    {
+        IShutdownCallback *usrHandler = CallbacksServer.getUsrShutdownHandler();
+        if (usrHandler)
+        {
+            usrHandler->OnShutdown(CallbacksServer, reason ? std::wstring(reason) : std::wstring());
+        }
+
+        return S_OK;
+
+    } // ShutdownRequest
+
+}; // CShutdownCallback
+
 COPCServer::COPCServer(ATL::CComPtr<IOPCServer> &opcServerInterface)
+    : ShutdownCallbackHandle(0), UserShutdownHandler(nullptr)
 {
     iOpcServer = opcServerInterface;
 
-    HRESULT result = opcServerInterface->QueryInterface(IID_IOPCBrowseServerAddressSpace, (void **)&iOpcNameSpace);
-    if (FAILED(result))
+    // DA 3.0 servers may offer IOPCBrowse only
+    HRESULT result = opcServerInterface->QueryInterface(IID_IOPCBrowse, (void **)&iOpcBrowse);
+    (void)result; // mutes clang complaints..
+
+    result = opcServerInterface->QueryInterface(IID_IOPCBrowseServerAddressSpace, (void **)&iOpcNameSpace);
+    if (FAILED(result) && !iOpcBrowse)
     {
         throw OPCException(L"COPCServer::COPCServer: FAILED to obtain IID_IOPCBrowseServerAddressSpace interface",
                            result);
@@ -42,10 +271,22 @@ COPCServer::COPCServer(ATL::CComPtr<IOPCServer> &opcServerInterface)
         throw OPCException(L"COPCServer::COPCServer: FAILED to obtain IID_IOPCItemProperties interface", result);
     }
 
+    // DA 3.0 only, group-less I/O falls back to a scratch group without it
+    result = opcServerInterface->QueryInterface(IID_IOPCItemIO, (void **)&iOpcItemIO);
+
+    PropertyService.reset(new COPCPropertyService(*this));
+
 } // COPCServer::COPCServer
 
 COPCServer::~COPCServer()
 {
+    Scratch.reset();
+
+    if (ShutdownCallBackHandler)
+    {
+        iShutdownConnectionPoint->Unadvise(ShutdownCallbackHandle);
+    }
+
 } // COPCServer::~COPCServer
 
 COPCGroup *COPCServer::makeGroup(const std::wstring &groupName, bool active, unsigned long reqUpdateRate_ms,
@@ -55,8 +296,425 @@ COPCGroup *COPCServer::makeGroup(const std::wstring &groupName, bool active, uns
 
 } // COPCServer::makeGroup
 
-bool COPCServer::getItemNames(std::vector<std::wstring> &opcItemNames)
+bool COPCServer::matchPattern(const wchar_t *pattern, const wchar_t *text)
+{
+    const wchar_t *star = nullptr;
+    const wchar_t *resume = nullptr;
+    while (*text)
+    {
+        if (*pattern == L'*')
+        {
+            star = pattern++;
+            resume = text;
+        }
+        else if (*pattern == L'?' || *pattern == *text)
+        {
+            ++pattern;
+            ++text;
+        }
+        else if (star)
+        {
+            // let the last star swallow one more character
+            pattern = star + 1;
+            text = ++resume;
+        }
+        else
+        {
+            return false;
+        }
+    } // while
+
+    while (*pattern == L'*')
+    {
+        ++pattern;
+    }
+    return !*pattern;
+
+} // COPCServer::matchPattern
+
+bool COPCServer::BrowseSink::flush(bool last)
+{
+    if (stopped)
+    {
+        return false;
+    }
+    if (!chunkReady || itemIds.empty() || (!last && itemIds.size() < chunkSize))
+    {
+        return true;
+    }
+
+    if (itemIds.size() <= chunkSize)
+    {
+        stopped = !(*chunkReady)(itemIds);
+        itemIds.clear();
+        return !stopped;
+    } // if
+
+    // a page of the server may overfill the chunk, the ids beyond the last full chunk wait for the next page
+    std::vector<std::wstring> chunk;
+    size_t handed = 0;
+    while (!stopped && (itemIds.size() - handed >= chunkSize || (last && handed < itemIds.size())))
+    {
+        const size_t count = (std::min)(chunkSize, itemIds.size() - handed);
+        chunk.assign(std::make_move_iterator(itemIds.begin() + handed),
+                     std::make_move_iterator(itemIds.begin() + handed + count));
+        handed += count;
+        stopped = !(*chunkReady)(chunk);
+        chunk.clear();
+    } // while
+
+    itemIds.erase(itemIds.begin(), itemIds.begin() + handed);
+    return !stopped;
+
+} // COPCServer::BrowseSink::flush
+
+void COPCServer::readNames(IEnumString *iEnum, ULONG blockSize,
+                           const std::function<bool(std::vector<std::wstring> &)> &handle)
+{
+    std::vector<LPWSTR> block(blockSize ? blockSize : 1);
+    std::vector<std::wstring> names;
+    HRESULT result = S_OK;
+    bool more = true;
+    while (result == S_OK && more)
+    {
+        ULONG fetched = 0;
+        result = iEnum->Next(static_cast<ULONG>(block.size()), block.data(), &fetched);
+        if (FAILED(result))
+        {
+            break;
+        }
+
+        names.clear();
+        for (ULONG i = 0; i < fetched; ++i)
+        {
+            names.push_back(block[i]);
+            COPCClient::comFree(block[i]);
+        } // for
+
+        more = handle(names);
+    } // while
+
+} // COPCServer::readNames
+
+void COPCServer::readNames(IEnumString *iEnum, ULONG blockSize, std::vector<std::wstring> &names)
+{
+    readNames(iEnum, blockSize, [&names](std::vector<std::wstring> &block) {
+        names.insert(names.end(), std::make_move_iterator(block.begin()), std::make_move_iterator(block.end()));
+        return true;
+    });
+
+} // COPCServer::readNames
+
+std::wstring COPCServer::queryItemId(const std::wstring &name)
+{
+    std::wstring id;
+    LPWSTR fullName = nullptr;
+    if (SUCCEEDED(iOpcNameSpace->GetItemID(const_cast<LPWSTR>(name.c_str()), &fullName)))
+    {
+        id = fullName;
+        COPCClient::comFree(fullName);
+    } // if
+
+    return id;
+
+} // COPCServer::queryItemId
+
+bool COPCServer::browseBranch(const std::wstring &branchId, unsigned depth, const BrowseOptions &options,
+                              BrowseSink &sink, std::vector<std::wstring> *subBranches)
 {
+    WCHAR emptyString[] = {0};
+    ATL::CComPtr<IEnumString> iEnum;
+    HRESULT result = iOpcNameSpace->BrowseOPCItemIDs(OPC_LEAF, options.leafFilter.c_str(), VT_EMPTY, 0, &iEnum);
+    if (SUCCEEDED(result) && iEnum)
+    {
+        // the first leaf suggests how the ids of its siblings are built. Once a second leaf, the last of the block,
+        // confirms it, the others need no GetItemID round trip. Leaves that disagree keep every id queried
+        ItemIdRule rule = ITEMID_QUERY;
+        ItemIdRule candidate = ITEMID_QUERY;
+        std::wstring prefix;
+        bool guessing = true;
+        auto ruleOf = [&branchId](const std::wstring &leaf, const std::wstring &id, std::wstring &idPrefix) {
+            if (id == leaf)
+            {
+                return ITEMID_NAME;
+            }
+            if (!branchId.empty() && id.size() > branchId.size() + leaf.size() &&
+                id.compare(0, branchId.size(), branchId) == 0 &&
+                id.compare(id.size() - leaf.size(), leaf.size(), leaf) == 0)
+            {
+                idPrefix = id.substr(0, id.size() - leaf.size());
+                return ITEMID_BRANCH_PREFIX;
+            } // if
+            return ITEMID_QUERY;
+        };
+        auto learn = [&](const std::wstring &leaf, const std::wstring &id) {
+            if (id.empty())
+            {
+                return;
+            }
+            std::wstring idPrefix;
+            ItemIdRule seen = ruleOf(leaf, id, idPrefix);
+            if (candidate == ITEMID_QUERY)
+            {
+                candidate = seen;
+                prefix = idPrefix;
+                guessing = seen != ITEMID_QUERY;
+            }
+            else
+            {
+                rule = (seen == candidate && idPrefix == prefix) ? candidate : ITEMID_QUERY;
+                guessing = false;
+            } // else
+        };
+        readNames(iEnum, options.blockSize, [&](std::vector<std::wstring> &names) {
+            std::wstring lastId;
+            bool lastQueried = false;
+            for (size_t i = 0; i < names.size(); ++i)
+            {
+                const std::wstring &leaf = names[i];
+                if (rule == ITEMID_NAME)
+                {
+                    sink.itemIds.push_back(leaf);
+                    continue;
+                }
+                if (rule == ITEMID_BRANCH_PREFIX)
+                {
+                    sink.itemIds.push_back(prefix + leaf);
+                    continue;
+                }
+
+                std::wstring id = (lastQueried && i + 1 == names.size()) ? lastId : queryItemId(leaf);
+                if (guessing)
+                {
+                    learn(leaf, id);
+                    if (guessing && candidate != ITEMID_QUERY && !lastQueried && i + 1 < names.size())
+                    {
+                        lastId = queryItemId(names.back());
+                        lastQueried = true;
+                        learn(names.back(), lastId);
+                    } // if
+                }     // if
+
+                if (!id.empty())
+                {
+                    sink.itemIds.push_back(id);
+                }
+            } // for
+
+            return sink.flush();
+        });
+        iEnum.Release();
+
+        if (sink.stopped)
+        {
+            return false;
+        }
+    } // if
+
+    if (options.maxDepth && depth >= options.maxDepth)
+    {
+        return true;
+    }
+
+    std::vector<std::wstring> names;
+    result = iOpcNameSpace->BrowseOPCItemIDs(OPC_BRANCH, emptyString, VT_EMPTY, 0, &iEnum);
+    if (FAILED(result) || !iEnum)
+    {
+        return true;
+    }
+    readNames(iEnum, options.blockSize, names);
+    iEnum.Release();
+
+    for (const std::wstring &branch : names)
+    {
+        if (!options.branchFilter.empty() && !matchPattern(options.branchFilter.c_str(), branch.c_str()))
+        {
+            continue;
+        }
+
+        std::wstring id = queryItemId(branch);
+        if (subBranches)
+        {
+            if (!id.empty())
+            {
+                subBranches->push_back(id);
+            }
+            continue;
+        } // if
+
+        if (FAILED(iOpcNameSpace->ChangeBrowsePosition(OPC_BROWSE_DOWN, branch.c_str())))
+        {
+            continue;
+        }
+
+        // a stopped browse leaves the position to the caller
+        if (!browseBranch(id, depth + 1, options, sink))
+        {
+            return false;
+        }
+
+        if (FAILED(iOpcNameSpace->ChangeBrowsePosition(OPC_BROWSE_UP, emptyString)) &&
+            FAILED(iOpcNameSpace->ChangeBrowsePosition(OPC_BROWSE_TO, branchId.c_str())))
+        {
+            throw OPCException(L"COPCServer::browseBranch: FAILED to return to the parent branch");
+        }
+    } // for
+
+    return true;
+
+} // COPCServer::browseBranch
+
+/**
+ * free what the server allocated for the properties of a browse element
+ */
+static void FreeItemProperties(OPCITEMPROPERTIES &properties)
+{
+    for (DWORD i = 0; i < properties.dwNumProperties; ++i)
+    {
+        OPCITEMPROPERTY &property = properties.pItemProperties[i];
+        COPCClient::comFree(property.szItemID);
+        COPCClient::comFree(property.szDescription);
+        VariantClear(&property.vValue);
+    } // for
+
+    COPCClient::comFree(properties.pItemProperties);
+
+} // FreeItemProperties
+
+COPCServer::BrowseResult COPCServer::browseBranch3(const std::wstring &branchId, unsigned depth,
+                                                   const BrowseOptions &options, const ElementsFunction &pageReady,
+                                                   std::vector<std::wstring> *subBranches)
+{
+    WCHAR emptyString[] = {0};
+    std::vector<DWORD> propertyIds(options.properties);
+    bool enterBranches = !options.maxDepth || depth < options.maxDepth;
+    std::vector<std::wstring> branches;
+    std::vector<BrowseElement> elements;
+    bool stopped = false;
+
+    // the continuation point is an in/out string owned by COM, the first page is asked for with an empty one
+    LPWSTR continuation = static_cast<LPWSTR>(CoTaskMemAlloc(sizeof(WCHAR)));
+    if (!continuation)
+    {
+        throw OPCException(L"COPCServer::browseBranch3: out of memory");
+    }
+    continuation[0] = 0;
+
+    BOOL more = FALSE;
+    do
+    {
+        more = FALSE;
+        DWORD count = 0;
+        OPCBROWSEELEMENT *page = nullptr;
+        HRESULT result = iOpcBrowse->Browse(
+            const_cast<LPWSTR>(branchId.c_str()), &continuation, options.blockSize,
+            enterBranches ? OPC_BROWSE_FILTER_ALL : OPC_BROWSE_FILTER_ITEMS, emptyString, emptyString, FALSE,
+            propertyIds.empty() ? FALSE : TRUE, static_cast<DWORD>(propertyIds.size()),
+            propertyIds.empty() ? nullptr : propertyIds.data(), &more, &count, &page);
+        if (FAILED(result))
+        {
+            COPCClient::comFree(continuation);
+            return BROWSE_REFUSED;
+        } // if
+
+        for (DWORD i = 0; i < count; ++i)
+        {
+            OPCBROWSEELEMENT &element = page[i];
+            std::wstring name = element.szName ? element.szName : L"";
+            std::wstring itemId = element.szItemID ? element.szItemID : L"";
+            if ((element.dwFlagValue & OPC_BROWSE_ISITEM) &&
+                (options.leafFilter.empty() || matchPattern(options.leafFilter.c_str(), name.c_str())))
+            {
+                BrowseElement item;
+                item.name = name;
+                item.itemId = itemId;
+                item.properties.resize(propertyIds.size());
+                for (DWORD p = 0; p < element.ItemProperties.dwNumProperties; ++p)
+                {
+                    OPCITEMPROPERTY &property = element.ItemProperties.pItemProperties[p];
+                    auto slot = std::find(propertyIds.begin(), propertyIds.end(), property.dwPropertyID);
+                    if (SUCCEEDED(property.hrErrorID) && slot != propertyIds.end())
+                    {
+                        item.properties[slot - propertyIds.begin()] = property.vValue;
+                    }
+                } // for
+
+                elements.push_back(std::move(item));
+            } // if
+
+            if (enterBranches && (element.dwFlagValue & OPC_BROWSE_HASCHILDREN) &&
+                (options.branchFilter.empty() || matchPattern(options.branchFilter.c_str(), name.c_str())))
+            {
+                branches.push_back(itemId);
+            }
+
+            COPCClient::comFree(element.szName);
+            COPCClient::comFree(element.szItemID);
+            FreeItemProperties(element.ItemProperties);
+        } // for
+
+        COPCClient::comFree(page);
+
+        // each page is handed on before the next is asked for
+        stopped = !pageReady(elements);
+        elements.clear();
+
+        // servers without continuation points flag the elements they left out with more, asking again would return
+        // the same page
+    } while (!stopped && continuation && *continuation);
+
+    COPCClient::comFree(continuation);
+    if (stopped)
+    {
+        return BROWSE_STOPPED;
+    }
+
+    if (more)
+    {
+        printf("COPCServer::browseBranch3: %ws truncated by the server, elements left out\n", branchId.c_str());
+    }
+
+    if (subBranches)
+    {
+        subBranches->insert(subBranches->end(), branches.begin(), branches.end());
+        return BROWSE_DONE;
+    } // if
+
+    for (const std::wstring &branch : branches)
+    {
+        if (browseBranch3(branch, depth + 1, options, pageReady) == BROWSE_STOPPED)
+        {
+            return BROWSE_STOPPED;
+        }
+    } // for
+    return BROWSE_DONE;
+
+} // COPCServer::browseBranch3
+
+bool COPCServer::browseNames(BrowseSink &sink, const BrowseOptions &options)
+{
+    if (iOpcBrowse && options.useBrowse3)
+    {
+        BrowseOptions names(options);
+        names.properties.clear();
+        bool handed = false;
+        BrowseResult browsed =
+            browseBranch3(options.startBranch, 1, names, [&sink, &handed](std::vector<BrowseElement> &page) {
+                for (BrowseElement &element : page)
+                {
+                    sink.itemIds.push_back(std::move(element.itemId));
+                }
+                handed = handed || !page.empty();
+                return sink.flush();
+            });
+
+        // a server that refuses part way through cannot be browsed again without repeating ids
+        if (browsed != BROWSE_REFUSED || handed)
+        {
+            return browsed != BROWSE_REFUSED;
+        }
+    } // if
+
     if (!iOpcNameSpace)
     {
         return false;
@@ -66,36 +724,428 @@ bool COPCServer::getItemNames(std::vector<std::wstring> &opcItemNames)
     HRESULT result = iOpcNameSpace->QueryOrganization(&nameSpaceType);
     (void)result; // mutes clang complaints..
 
-    USES_CONVERSION;
     WCHAR emptyString[] = {0};
-    // result = iOpcNameSpace->ChangeBrowsePosition ( OPC_BROWSE_TO, emptyString );
+    if (nameSpaceType == OPC_NS_HIERARCHIAL)
+    {
+        if (SUCCEEDED(iOpcNameSpace->ChangeBrowsePosition(OPC_BROWSE_TO, options.startBranch.c_str())))
+        {
+            browseBranch(options.startBranch, 1, options, sink);
+            iOpcNameSpace->ChangeBrowsePosition(OPC_BROWSE_TO, emptyString);
+            return true;
+        } // if
 
+        if (!options.startBranch.empty())
+        {
+            return false;
+        }
+    } // if
+
+    // servers without browse positions are browsed flat
     ATL::CComPtr<IEnumString> iEnum;
-    result = iOpcNameSpace->BrowseOPCItemIDs(OPC_FLAT, emptyString, VT_EMPTY, 0, &iEnum);
+    result = iOpcNameSpace->BrowseOPCItemIDs(OPC_FLAT, options.leafFilter.c_str(), VT_EMPTY, 0, &iEnum);
     if (FAILED(result))
     {
         return false;
     }
+    if (!iEnum)
+    {
+        return true;
+    }
+
+    // names of a flat namespace are the item ids
+    bool flat = nameSpaceType == OPC_NS_FLAT;
+    readNames(iEnum, options.blockSize, [&](std::vector<std::wstring> &names) {
+        for (std::wstring &name : names)
+        {
+            std::wstring id = flat ? std::move(name) : queryItemId(name);
+            if (!id.empty())
+            {
+                sink.itemIds.push_back(std::move(id));
+            }
+        } // for
+        return sink.flush();
+    });
+
+    return true;
+
+} // COPCServer::browseNames
+
+bool COPCServer::getItemNames(std::vector<std::wstring> &opcItemNames)
+{
+    return browseItemNames(opcItemNames, BrowseOptions());
+
+} // COPCServer::getItemNames
+
+bool COPCServer::browseItemNames(std::vector<std::wstring> &opcItemNames, const BrowseOptions &options)
+{
+    BrowseSink sink = {opcItemNames, nullptr, 0, false};
+    return browseNames(sink, options);
+
+} // COPCServer::browseItemNames
+
+bool COPCServer::streamItemNames(const BrowseChunkFunction &chunkReady, const BrowseOptions &options)
+{
+    std::vector<std::wstring> chunk;
+    BrowseSink sink = {chunk, &chunkReady, options.blockSize ? options.blockSize : 1, false};
+    if (!browseNames(sink, options))
+    {
+        return false;
+    }
 
-    LPWSTR name = nullptr;
-    ULONG nameSize = 0;
-    while ((result = iEnum->Next(1, &name, &nameSize)) == S_OK)
+    sink.flush(true);
+    return true;
+
+} // COPCServer::streamItemNames
+
+bool COPCServer::browseLevel(const std::wstring &branchId, unsigned depth, const BrowseOptions &options,
+                             std::vector<std::wstring> &itemIds, std::vector<std::wstring> &branchIds)
+{
+    if (iOpcBrowse && options.useBrowse3)
     {
-        (void)result; // mutes clang complaints..
-        LPWSTR fullName = nullptr;
-        result = iOpcNameSpace->GetItemID(name, &fullName);
-        if (SUCCEEDED(result))
+        BrowseOptions names(options);
+        names.properties.clear();
+        // no fall back to the browse position of IOPCBrowseServerAddressSpace, other threads may share the session
+        return browseBranch3(branchId, depth, names,
+                             [&itemIds](std::vector<BrowseElement> &page) {
+                                 for (BrowseElement &element : page)
+                                 {
+                                     itemIds.push_back(std::move(element.itemId));
+                                 }
+                                 return true;
+                             },
+                             &branchIds) == BROWSE_DONE;
+    } // if
+
+    if (!iOpcNameSpace)
+    {
+        return false;
+    }
+
+    OPCNAMESPACETYPE nameSpaceType = OPC_NS_FLAT;
+    HRESULT result = iOpcNameSpace->QueryOrganization(&nameSpaceType);
+    (void)result; // mutes clang complaints..
+
+    if (nameSpaceType == OPC_NS_HIERARCHIAL &&
+        SUCCEEDED(iOpcNameSpace->ChangeBrowsePosition(OPC_BROWSE_TO, branchId.c_str())))
+    {
+        BrowseSink sink = {itemIds, nullptr, 0, false};
+        browseBranch(branchId, depth, options, sink, &branchIds);
+        return true;
+    } // if
+
+    // a flat namespace is a single branch
+    if (!branchId.empty())
+    {
+        return false;
+    }
+
+    BrowseOptions flat(options);
+    flat.useBrowse3 = false;
+    return browseItemNames(itemIds, flat);
+
+} // COPCServer::browseLevel
+
+bool COPCServer::browseElements(std::vector<BrowseElement> &elements, const BrowseOptions &options)
+{
+    size_t found = elements.size();
+    if (iOpcBrowse && options.useBrowse3)
+    {
+        auto pageReady = [&elements](std::vector<BrowseElement> &page) {
+            elements.insert(elements.end(), std::make_move_iterator(page.begin()), std::make_move_iterator(page.end()));
+            return true;
+        };
+        BrowseResult browsed = browseBranch3(options.startBranch, 1, options, pageReady);
+        if (browsed != BROWSE_REFUSED)
         {
-            opcItemNames.push_back(fullName);
-            COPCClient::comFree(fullName);
-        } // if
+            return true;
+        }
+        elements.resize(found);
+    } // if
 
-        COPCClient::comFree(name);
-    } // while
+    std::vector<std::wstring> itemIds;
+    BrowseOptions browse2(options);
+    browse2.useBrowse3 = false;
+    if (!browseItemNames(itemIds, browse2))
+    {
+        return false;
+    }
+
+    std::vector<std::vector<ATL::CComVariant>> values;
+    getItemProperties(itemIds, options.properties, values);
+    elements.reserve(found + itemIds.size());
+    for (size_t i = 0; i < itemIds.size(); ++i)
+    {
+        BrowseElement element;
+        element.name = itemIds[i];
+        element.itemId = itemIds[i];
+        element.properties.swap(values[i]);
+        elements.push_back(std::move(element));
+    } // for
 
     return true;
 
-} // COPCServer::getItemNames
+} // COPCServer::browseElements
+
+bool COPCServer::queryAvailableProperties(const std::wstring &itemId, std::vector<CPropertyDescription> &desc)
+{
+    DWORD nbrProperties = 0;
+    DWORD *pPropertyIDs = nullptr;
+    LPWSTR *pDescriptions = nullptr;
+    VARTYPE *pvtDataTypes = nullptr;
+    HRESULT result = iOpcProperties->QueryAvailableProperties(const_cast<LPWSTR>(itemId.c_str()), &nbrProperties,
+                                                              &pPropertyIDs, &pDescriptions, &pvtDataTypes);
+    if (FAILED(result))
+    {
+        throw OPCException(L"COPCServer::queryAvailableProperties: FAILED to retrieve properties", result);
+    }
+
+    for (DWORD i = 0; i < nbrProperties; ++i)
+    {
+        desc.push_back(CPropertyDescription(pPropertyIDs[i], pDescriptions[i] ? pDescriptions[i] : L"",
+                                            pvtDataTypes[i]));
+        COPCClient::comFree(pDescriptions[i]);
+    } // for
+
+    COPCClient::comFree(pPropertyIDs);
+    COPCClient::comFree(pDescriptions);
+    COPCClient::comFree(pvtDataTypes);
+    return true;
+
+} // COPCServer::queryAvailableProperties
+
+void COPCServer::getItemProperties(const std::vector<std::wstring> &itemIds, const std::vector<DWORD> &propertyIds,
+                                   std::vector<std::vector<ATL::CComVariant>> &values)
+{
+    values.assign(itemIds.size(), std::vector<ATL::CComVariant>(propertyIds.size()));
+    if (itemIds.empty() || propertyIds.empty())
+    {
+        return;
+    }
+
+    std::vector<DWORD> ids(propertyIds);
+    DWORD propertyCount = static_cast<DWORD>(ids.size());
+    if (iOpcBrowse)
+    {
+        std::vector<LPWSTR> names;
+        names.reserve(itemIds.size());
+        for (const std::wstring &itemId : itemIds)
+        {
+            names.push_back(const_cast<LPWSTR>(itemId.c_str()));
+        }
+
+        OPCITEMPROPERTIES *properties = nullptr;
+        HRESULT result = iOpcBrowse->GetProperties(static_cast<DWORD>(names.size()), names.data(), TRUE,
+                                                   propertyCount, ids.data(), &properties);
+        if (SUCCEEDED(result) && properties)
+        {
+            for (size_t i = 0; i < itemIds.size(); ++i)
+            {
+                OPCITEMPROPERTIES &item = properties[i];
+                for (DWORD p = 0; p < item.dwNumProperties; ++p)
+                {
+                    OPCITEMPROPERTY &property = item.pItemProperties[p];
+                    auto slot = std::find(ids.begin(), ids.end(), property.dwPropertyID);
+                    if (SUCCEEDED(property.hrErrorID) && slot != ids.end())
+                    {
+                        values[i][slot - ids.begin()] = property.vValue;
+                    }
+                } // for
+
+                FreeItemProperties(item);
+            } // for
+
+            COPCClient::comFree(properties);
+            return;
+        } // if
+    }     // if
+
+    // one round trip per item
+    for (size_t i = 0; i < itemIds.size(); ++i)
+    {
+        VARIANT *itemValues = nullptr;
+        HRESULT *errors = nullptr;
+        if (FAILED(iOpcProperties->GetItemProperties(const_cast<LPWSTR>(itemIds[i].c_str()), propertyCount,
+                                                     ids.data(), &itemValues, &errors)))
+        {
+            continue;
+        }
+
+        for (DWORD p = 0; p < propertyCount; ++p)
+        {
+            if (SUCCEEDED(errors[p]))
+            {
+                values[i][p] = itemValues[p];
+            }
+        } // for
+
+        COPCClient::comFreeVariant(itemValues, propertyCount);
+        COPCClient::comFree(errors);
+    } // for
+
+} // COPCServer::getItemProperties
+
+void COPCServer::readItems(const std::vector<std::wstring> &itemIds, std::vector<OPCItemData> &values, DWORD maxAge_ms)
+{
+    values.assign(itemIds.size(), OPCItemData());
+    if (itemIds.empty())
+    {
+        return;
+    }
+
+    DWORD nbrItems = static_cast<DWORD>(itemIds.size());
+    if (iOpcItemIO)
+    {
+        std::vector<LPCWSTR> ids;
+        ids.reserve(nbrItems);
+        for (const std::wstring &itemId : itemIds)
+        {
+            ids.push_back(itemId.c_str());
+        }
+        std::vector<DWORD> maxAges(nbrItems, maxAge_ms);
+
+        VARIANT *itemValues = nullptr;
+        WORD *qualities = nullptr;
+        FILETIME *times = nullptr;
+        HRESULT *errors = nullptr;
+        HRESULT result =
+            iOpcItemIO->Read(nbrItems, ids.data(), maxAges.data(), &itemValues, &qualities, &times, &errors);
+        if (FAILED(result))
+        {
+            throw OPCException(L"COPCServer::readItems: IOPCItemIO::Read FAILED", result);
+        }
+
+        for (DWORD i = 0; i < nbrItems; ++i)
+        {
+            if (FAILED(errors[i]))
+            {
+                values[i] = OPCItemData(nullptr, errors[i]);
+            }
+            else
+            {
+                values[i] = OPCItemData(nullptr, itemValues[i], qualities[i], times[i], errors[i]);
+            }
+        } // for
+
+        COPCClient::comFreeVariant(itemValues, nbrItems);
+        COPCClient::comFree(qualities);
+        COPCClient::comFree(times);
+        COPCClient::comFree(errors);
+        return;
+    } // if
+
+    std::lock_guard<std::mutex> lock(ScratchLock);
+    if (!Scratch)
+    {
+        Scratch.reset(new CScratchGroup(*this, SCRATCH_ITEMS));
+    }
+
+    std::vector<COPCItem *> items;
+    std::vector<HRESULT> errors;
+    Scratch->acquire(itemIds, items, errors);
+
+    std::vector<COPCItem *> known;
+    std::copy_if(items.begin(), items.end(), std::back_inserter(known), [](COPCItem *item) { return item; });
+    COPCItemDataMap data;
+    if (!known.empty())
+    {
+        // cache reads of inactive items return OPC_QUALITY_OUT_OF_SERVICE, any maxAge is met by the device
+        Scratch->group().readSync(known, data, OPC_DS_DEVICE);
+    }
+
+    // the scratch items may be removed by a later call, the values do not refer to them
+    for (size_t i = 0; i < itemIds.size(); ++i)
+    {
+        COPCItemDataMap::CPair *pair = items[i] ? data.Lookup(COPCGroup::getOpcHandle(items[i])) : nullptr;
+        if (pair && pair->m_value)
+        {
+            values[i] = *pair->m_value;
+            values[i].Item = nullptr;
+        }
+        else
+        {
+            values[i] = OPCItemData(nullptr, FAILED(errors[i]) ? errors[i] : E_FAIL);
+        }
+    } // for
+
+} // COPCServer::readItems
+
+int COPCServer::writeItems(const std::vector<std::wstring> &itemIds, const std::vector<ATL::CComVariant> &values,
+                           std::vector<HRESULT> &errors)
+{
+    if (itemIds.size() != values.size())
+    {
+        throw OPCException(L"COPCServer::writeItems: one value per item expected");
+    }
+    errors.assign(itemIds.size(), S_OK);
+    if (itemIds.empty())
+    {
+        return 0;
+    }
+
+    HRESULT *results = nullptr;
+    std::vector<size_t> written;
+    if (iOpcItemIO)
+    {
+        std::vector<LPCWSTR> ids;
+        std::vector<OPCITEMVQT> vqts(itemIds.size());
+        for (size_t i = 0; i < itemIds.size(); ++i)
+        {
+            ids.push_back(itemIds[i].c_str());
+            // the value is only read by the server, no copy needed..
+            memset(&vqts[i], 0, sizeof(OPCITEMVQT));
+            vqts[i].vDataValue = values[i];
+            written.push_back(i);
+        } // for
+
+        HRESULT result = iOpcItemIO->WriteVQT(static_cast<DWORD>(ids.size()), ids.data(), vqts.data(), &results);
+        if (FAILED(result))
+        {
+            throw OPCException(L"COPCServer::writeItems: IOPCItemIO::WriteVQT FAILED", result);
+        }
+    } // if
+    else
+    {
+        std::lock_guard<std::mutex> lock(ScratchLock);
+        if (!Scratch)
+        {
+            Scratch.reset(new CScratchGroup(*this, SCRATCH_ITEMS));
+        }
+
+        std::vector<COPCItem *> items;
+        Scratch->acquire(itemIds, items, errors);
+
+        std::vector<OPCHANDLE> handles;
+        std::vector<VARIANT> itemValues;
+        for (size_t i = 0; i < itemIds.size(); ++i)
+        {
+            if (items[i])
+            {
+                handles.push_back(items[i]->getHandle());
+                itemValues.push_back(values[i]);
+                written.push_back(i);
+            }
+        } // for
+
+        if (!written.empty())
+        {
+            HRESULT result = Scratch->group().getSyncIOInterface()->Write(
+                static_cast<DWORD>(handles.size()), handles.data(), itemValues.data(), &results);
+            if (FAILED(result))
+            {
+                throw OPCException(L"COPCServer::writeItems: sync write FAILED", result);
+            }
+        } // if
+    }     // else
+
+    for (size_t k = 0; k < written.size(); ++k)
+    {
+        errors[written[k]] = results[k];
+    }
+    COPCClient::comFree(results);
+
+    return static_cast<int>(std::count_if(errors.begin(), errors.end(), [](HRESULT error) { return FAILED(error); }));
+
+} // COPCServer::writeItems
 
 bool COPCServer::getStatus(ServerStatus &status)
 {
@@ -127,6 +1177,70 @@ bool COPCServer::getStatus(ServerStatus &status)
 
 } // COPCServer::getStatus
 
+bool COPCServer::enableShutdownNotification(IShutdownCallback *handler)
+{
+    if (ShutdownCallBackHandler)
+    {
+        throw OPCException(L"COPCServer::enableShutdownNotification: shutdown notification already enabled");
+    }
+
+    ATL::CComPtr<IConnectionPointContainer> iConnectionPointContainer = 0;
+    HRESULT result = iOpcServer->QueryInterface(IID_IConnectionPointContainer, (void **)&iConnectionPointContainer);
+    if (FAILED(result))
+    {
+        throw OPCException(L"COPCServer::enableShutdownNotification: could not get IID_IConnectionPointContainer",
+                           result);
+    }
+
+    result = iConnectionPointContainer->FindConnectionPoint(IID_IOPCShutdown, &iShutdownConnectionPoint);
+    if (FAILED(result))
+    {
+        throw OPCException(L"COPCServer::enableShutdownNotification: could not get IID_IOPCShutdown", result);
+    }
+
+    // set before Advise, the server may call back right away
+    UserShutdownHandler = handler;
+    ShutdownCallBackHandler = new CShutdownCallback(*this);
+    result = iShutdownConnectionPoint->Advise(ShutdownCallBackHandler, &ShutdownCallbackHandle);
+    if (FAILED(result))
+    {
+        iShutdownConnectionPoint = nullptr;
+        ShutdownCallBackHandler = nullptr;
+        UserShutdownHandler = nullptr;
+        throw OPCException(L"COPCServer::enableShutdownNotification: FAILED to set ShutdownConnectionPoint", result);
+    } // if
+
+    return true;
+
+} // COPCServer::enableShutdownNotification
+
+bool COPCServer::disableShutdownNotification()
+{
+    if (!ShutdownCallBackHandler)
+    {
+        throw OPCException(L"COPCServer::disableShutdownNotification: shutdown notification is not enabled");
+    }
+
+    iShutdownConnectionPoint->Unadvise(ShutdownCallbackHandle);
+    iShutdownConnectionPoint = nullptr;
+    ShutdownCallBackHandler = nullptr; // the COM ref counting deletes the sink
+    UserShutdownHandler = nullptr;
+    return true;
+
+} // COPCServer::disableShutdownNotification
+
+void COPCServer::abandon()
+{
+    if (ShutdownCallBackHandler)
+    {
+        // local call, drops the references the server holds on the sink
+        CoDisconnectObject(ShutdownCallBackHandler, 0);
+        ShutdownCallBackHandler = nullptr;
+    }
+    UserShutdownHandler = nullptr;
+
+} // COPCServer::abandon
+
 #ifdef OPCDA_CLIENT_NAMESPACE
 } // namespace opcda_client
 #endif
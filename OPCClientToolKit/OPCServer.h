@@ -22,15 +22,25 @@ Boston, MA  02111-1307, USA.
 
 #pragma warning(disable : 4251) // can be ignored if deriving from a type in the Standard C++ Library..
 
+#include <functional>
+#include <memory>
+#include <mutex>
+
 #include "OPCClient.h"
 #include "OPCClientToolKitDLL.h"
 #include "OPCGroup.h"
+#include "OPCProperties.h"
+#include "opccomn.h"
 
 #ifdef OPCDA_CLIENT_NAMESPACE
 namespace opcda_client
 {
 #endif
 
+class CShutdownCallback;
+class COPCPropertyService;
+class CScratchGroup;
+
 /**
  * Holds status information about the server
  */
@@ -49,11 +59,87 @@ struct ServerStatus
 
 }; // ServerStatus
 
+/**
+ * Options of a namespace browse
+ */
+struct BrowseOptions
+{
+    /**
+     * names fetched per IEnumString::Next call
+     */
+    ULONG blockSize;
+
+    /**
+     * number of branch levels entered below the start branch, 0 is unlimited. With 1 only the leaves of the start
+     * branch are returned
+     */
+    unsigned maxDepth;
+
+    /**
+     * only branches whose name matches this pattern are entered, '*' matches any run of characters and '?' one
+     * character. Empty enters all branches
+     */
+    std::wstring branchFilter;
+
+    /**
+     * leaf filter passed to the server, in the server's own filter syntax. Empty returns all leaves
+     */
+    std::wstring leafFilter;
+
+    /**
+     * fully qualified id of the branch to start from, empty starts at the root
+     */
+    std::wstring startBranch;
+
+    /**
+     * ids of the item properties returned with each element by browseElements, e.g. OPC_PROPERTY_DATATYPE and
+     * OPC_PROPERTY_ACCESS_RIGHTS. DA 3.0 servers return them with the browse pages
+     */
+    std::vector<DWORD> properties;
+
+    /**
+     * browse through the DA 3.0 IOPCBrowse interface when the server has it. The server returns the item ids with
+     * the names and pages through large branches with continuation points. Its leaves are matched against leafFilter
+     * with the wildcards of branchFilter
+     */
+    bool useBrowse3;
+
+    BrowseOptions() : blockSize(1000), maxDepth(0), useBrowse3(true)
+    {
+    }
+
+}; // BrowseOptions
+
+/**
+ * An item found by browseElements
+ */
+struct BrowseElement
+{
+    /**
+     * browse name and fully qualified id
+     */
+    std::wstring name;
+    std::wstring itemId;
+
+    /**
+     * values of BrowseOptions::properties, in the same order. VT_EMPTY if the item has no such property
+     */
+    std::vector<ATL::CComVariant> properties;
+
+}; // BrowseElement
+
 /**
  * Local representation of a local or remote OPC server. Wrapper for the COM interfaces to the server.
  */
 class OPCDACLIENT_API COPCServer
 {
+  public:
+    /**
+     * handed each chunk of item ids of a streamed browse. The ids may be moved out, the vector is cleared afterwards.
+     * Return false to stop the browse
+     */
+    typedef std::function<bool(std::vector<std::wstring> &itemIds)> BrowseChunkFunction;
+
   private:
     /**
      * IUnknown interface to the OPC server
@@ -65,11 +151,121 @@ class OPCDACLIENT_API COPCServer
      */
     ATL::CComPtr<IOPCBrowseServerAddressSpace> iOpcNameSpace;
 
+    /**
+     * DA 3.0 browse interface, null if the server does not support it
+     */
+    ATL::CComPtr<IOPCBrowse> iOpcBrowse;
+
+    /**
+     * DA 3.0 group-less I/O by item id, null if the server does not support it
+     */
+    ATL::CComPtr<IOPCItemIO> iOpcItemIO;
+
     /**
      * interface to the properties maintained for each item in the server namespace
      */
     ATL::CComPtr<IOPCItemProperties> iOpcProperties;
 
+    /**
+     * IOPCShutdown connection point of the server and the sink advised to it
+     */
+    ATL::CComPtr<IConnectionPoint> iShutdownConnectionPoint;
+    ATL::CComPtr<CShutdownCallback> ShutdownCallBackHandler;
+    DWORD ShutdownCallbackHandle;
+
+    /**
+     * Users handler of shutdown requests
+     * NOT OWNED.
+     */
+    IShutdownCallback *UserShutdownHandler;
+
+    /**
+     * batched and cached item properties of this server
+     */
+    std::unique_ptr<COPCPropertyService> PropertyService;
+
+    /**
+     * inactive group holding the recently used items of readItems and writeItems for servers without IOPCItemIO,
+     * made on first use
+     */
+    std::unique_ptr<CScratchGroup> Scratch;
+    std::mutex ScratchLock;
+
+    /**
+     * how fully qualified item ids follow from browse names: not known, the name itself, or the branch id followed by
+     * a separator and the name
+     */
+    enum ItemIdRule
+    {
+        ITEMID_QUERY,
+        ITEMID_NAME,
+        ITEMID_BRANCH_PREFIX
+    };
+
+    /**
+     * collects the item ids of a browse and hands them to chunkReady, if set, in chunks of chunkSize
+     */
+    struct BrowseSink
+    {
+        std::vector<std::wstring> &itemIds;
+        const BrowseChunkFunction *chunkReady;
+        size_t chunkSize;
+        bool stopped;
+
+        /**
+         * hand on the ids held if a chunk is full, or any are held and last is set. returns false once stopped
+         */
+        bool flush(bool last = false);
+    };
+
+    enum BrowseResult
+    {
+        BROWSE_DONE,
+        BROWSE_REFUSED,
+        BROWSE_STOPPED
+    };
+
+    /**
+     * handed each page of browse elements, return false to stop the browse
+     */
+    typedef std::function<bool(std::vector<BrowseElement> &elements)> ElementsFunction;
+
+    /**
+     * hand up to blockSize names per round trip to handle until the enumeration ends or handle returns false
+     */
+    static void readNames(IEnumString *iEnum, ULONG blockSize,
+                          const std::function<bool(std::vector<std::wstring> &)> &handle);
+
+    /**
+     * append up to blockSize names per round trip until the enumeration ends
+     */
+    static void readNames(IEnumString *iEnum, ULONG blockSize, std::vector<std::wstring> &names);
+
+    /**
+     * fully qualified id of a name at the current browse position, empty if the server does not know it
+     */
+    std::wstring queryItemId(const std::wstring &name);
+
+    /**
+     * walk the branch at the current browse position. If subBranches is set, the ids of the sub branches to enter
+     * are appended to it instead of being walked. The sink is flushed after each block of names.
+     * returns false if the sink was stopped
+     */
+    bool browseBranch(const std::wstring &branchId, unsigned depth, const BrowseOptions &options, BrowseSink &sink,
+                      std::vector<std::wstring> *subBranches = nullptr);
+
+    /**
+     * walk a branch through IOPCBrowse::Browse, each page is handed to pageReady before the next is asked for.
+     * If subBranches is set, the ids of the sub branches to enter are appended to it instead of being walked
+     */
+    BrowseResult browseBranch3(const std::wstring &branchId, unsigned depth, const BrowseOptions &options,
+                               const ElementsFunction &pageReady, std::vector<std::wstring> *subBranches = nullptr);
+
+    /**
+     * browse the item ids into sink, see browseItemNames
+     */
+    bool browseNames(BrowseSink &sink, const BrowseOptions &options);
+
     /**
      * Used by group object.
      */
@@ -96,13 +292,109 @@ class OPCDACLIENT_API COPCServer
 
     virtual ~COPCServer();
 
+    COPCServer(const COPCServer &) = delete;
+
+    COPCServer &operator=(const COPCServer &) = delete;
+
     /**
-     * Browse the OPC server's namespace.
-     * This is currently done FLAT mode
-     * TODO implement browsing of structured namespace
+     * Browse all item ids of the OPC server's namespace.
      */
     bool getItemNames(std::vector<std::wstring> &opcItemNames);
 
+    /**
+     * Browse the item ids of the OPC server's namespace, names are fetched in blocks of options.blockSize.
+     * Hierarchical namespaces are walked branch by branch; the server is asked for the fully qualified id once per
+     * branch and the ids of the other leaves are derived from it when it is the name itself or the branch id followed
+     * by a separator and the name.
+     * The browse position of the server is shared: do not browse one server from several threads at once.
+     * returns false if the server does not support browsing.
+     */
+    bool browseItemNames(std::vector<std::wstring> &opcItemNames, const BrowseOptions &options);
+
+    /**
+     * Browse like browseItemNames, but hand the item ids to chunkReady in chunks of options.blockSize as they are
+     * enumerated, the last chunk may be smaller. At most one chunk and one page of the server are held, whatever the
+     * size of the namespace.
+     * Browsing stops when chunkReady returns false.
+     * returns false if the server does not support browsing.
+     */
+    bool streamItemNames(const BrowseChunkFunction &chunkReady, const BrowseOptions &options = BrowseOptions());
+
+    /**
+     * Browse one branch without descending: the item ids of its leaves are appended to itemIds and the ids of the
+     * sub branches to enter to branchIds. depth is the level of the branch, 1 for options.startBranch.
+     * Branches are addressed by id, so a call does not depend on the browse position left by an earlier one. Servers
+     * with IOPCBrowse are browsed through it alone, so with options.useBrowse3 threads may share a session.
+     * returns false if the branch cannot be browsed.
+     */
+    bool browseLevel(const std::wstring &branchId, unsigned depth, const BrowseOptions &options,
+                     std::vector<std::wstring> &itemIds, std::vector<std::wstring> &branchIds);
+
+    /**
+     * Browse the items of the OPC server's namespace together with the values of options.properties.
+     * DA 3.0 servers return the properties with the browse pages; others are asked for them item by item.
+     * returns false if the server does not support browsing.
+     */
+    bool browseElements(std::vector<BrowseElement> &elements, const BrowseOptions &options);
+
+    /**
+     * descriptions of the properties available for an item
+     */
+    bool queryAvailableProperties(const std::wstring &itemId, std::vector<CPropertyDescription> &desc);
+
+    /**
+     * values of the properties propertyIds of a batch of items, values[i][p] for itemIds[i] and propertyIds[p],
+     * VT_EMPTY where the server has no value. DA 3.0 servers are asked once through IOPCBrowse::GetProperties, others
+     * once per item through IOPCItemProperties. Cached and concurrent access is provided by getPropertyService.
+     */
+    void getItemProperties(const std::vector<std::wstring> &itemIds, const std::vector<DWORD> &propertyIds,
+                           std::vector<std::vector<ATL::CComVariant>> &values);
+
+    /**
+     * properties of many items, batched and cached. Owned by the server
+     */
+    COPCPropertyService &getPropertyService()
+    {
+        return *PropertyService;
+    }
+
+    /**
+     * Read items by id without a group of the caller. values[i] holds the value of itemIds[i] or its error, the item
+     * of the values is null. DA 3.0 servers take one IOPCItemIO::Read call with maxAge_ms for each item. Other
+     * servers are read through a scratch group of the recently used items, one call if all items are in it. Its
+     * items are inactive, which the server reports out of service from its cache, so they are always read from the
+     * device whatever maxAge_ms is.
+     */
+    void readItems(const std::vector<std::wstring> &itemIds, std::vector<OPCItemData> &values, DWORD maxAge_ms = 0);
+
+    /**
+     * Write items by id without a group of the caller, through IOPCItemIO::WriteVQT or the scratch group.
+     * returns the number of failed items, errors[i] holds the result for itemIds[i]
+     */
+    int writeItems(const std::vector<std::wstring> &itemIds, const std::vector<ATL::CComVariant> &values,
+                   std::vector<HRESULT> &errors);
+
+    /**
+     * true if the server supports the DA 3.0 IOPCItemIO interface
+     */
+    bool hasItemIO() const
+    {
+        return iOpcItemIO != nullptr;
+    }
+
+    /**
+     * match text against a browse filter pattern where '*' matches any run of characters and '?' one character
+     */
+    static bool matchPattern(const wchar_t *pattern, const wchar_t *text);
+
+    /**
+     * true if the server supports the DA 3.0 IOPCBrowse interface
+     */
+    bool hasBrowse3() const
+    {
+        return iOpcBrowse != nullptr;
+    }
+
     /**
      * Get an OPC group. Caller owns
      */
@@ -114,6 +406,28 @@ class OPCDACLIENT_API COPCServer
      */
     bool getStatus(ServerStatus &status);
 
+    /**
+     * advise an IOPCShutdown sink, shutdown requests of the server are passed to handler.
+     * throws if the server does not support IOPCShutdown
+     */
+    bool enableShutdownNotification(IShutdownCallback *handler);
+
+    /**
+     * unadvise the IOPCShutdown sink
+     */
+    bool disableShutdownNotification();
+
+    /**
+     * the server is gone: disconnect the shutdown sink locally, so that destroying the server object makes no call
+     * to it
+     */
+    void abandon();
+
+    IShutdownCallback *getUsrShutdownHandler()
+    {
+        return UserShutdownHandler;
+    }
+
 }; // COPCServer
 
 #ifdef OPCDA_CLIENT_NAMESPACE
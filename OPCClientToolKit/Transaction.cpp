@@ -27,12 +27,12 @@ namespace opcda_client
 #endif
 
 CTransaction::CTransaction(ITransactionComplete *completeCB)
-    : Completed(false), CancelID(0xffffffff), CompleteCallBack(completeCB)
+    : Completed(false), CancelID(0xffffffff), ChangesOnly(false), CompleteCallBack(completeCB)
 {
 } // CTransaction::CTransaction
 
 CTransaction::CTransaction(std::vector<COPCItem *> &items, ITransactionComplete *completeCB)
-    : Completed(false), CancelID(0xffffffff), CompleteCallBack(completeCB)
+    : Completed(false), CancelID(0xffffffff), ChangesOnly(false), CompleteCallBack(completeCB)
 {
     for (unsigned i = 0; i < items.size(); ++i)
     {
@@ -42,7 +42,7 @@ CTransaction::CTransaction(std::vector<COPCItem *> &items, ITransactionComplete
 } // CTransaction::CTransaction
 
 CTransaction::CTransaction(COPCItemDataMap &itemDataMap, ITransactionComplete *completeCB)
-    : Completed(false), CancelID(0xffffffff), CompleteCallBack(completeCB)
+    : Completed(false), CancelID(0xffffffff), ChangesOnly(false), CompleteCallBack(completeCB)
 {
     ItemDataMap = itemDataMap;
 
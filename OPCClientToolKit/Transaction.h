@@ -62,6 +62,9 @@ class CTransaction
 
     DWORD CancelID;
 
+    // true when only items that changed against the group's last known values are reported
+    bool ChangesOnly;
+
     /**
      * keyed on OPCitem address (not owned)
      * OPCitem data is owned by the transaction - may be nullptr
@@ -112,6 +115,16 @@ class CTransaction
         return CancelID;
     }
 
+    void setChangesOnly(bool changesOnly)
+    {
+        ChangesOnly = changesOnly;
+    }
+
+    bool isChangesOnly() const
+    {
+        return ChangesOnly;
+    }
+
 }; // CTransaction
 
 #ifdef OPCDA_CLIENT_NAMESPACE
@@ -26,10 +26,12 @@ Boston, MA  02111-1307, USA.
 #include <sys/timeb.h>
 #include <sys/types.h>
 
+#include "OPCBrowseCrawler.h"
 #include "OPCClient.h"
 #include "OPCGroup.h"
 #include "OPCHost.h"
 #include "OPCItem.h"
+#include "OPCNameSpaceSnapshot.h"
 #include "OPCServer.h"
 #include "opcda.h"
 
@@ -85,11 +87,20 @@ class CMyCallback : public IAsyncDataCallback
 
 }; // CMyCallback
 
-void recordNameSpace(COPCServer &opcServer, const char *fileName)
+void recordNameSpace(COPCHost &host, const std::wstring &serverName, const char *fileName)
 {
+    // every crawling thread browses through a session of its own
     std::vector<std::wstring> opcItemNames;
-    opcServer.getItemNames(opcItemNames);
-    printf("namespace holds %d items\n", static_cast<int>(opcItemNames.size()));
+    COPCBrowseCrawler crawler;
+    if (!crawler.crawl([&host, &serverName] { return host.connectDAServer(serverName); }, BrowseOptions(),
+                       opcItemNames))
+    {
+        printf("FAILED to browse the namespace\n");
+        return;
+    } // if
+
+    printf("namespace holds %d items, browsed at %.0f items/s\n", static_cast<int>(opcItemNames.size()),
+           crawler.getItemsPerSecond());
     Sleep(1000);
 
     fstream itemListFile(fileName, ios::out);
@@ -106,6 +117,49 @@ void recordNameSpace(COPCServer &opcServer, const char *fileName)
 
 } // recordNameSpace
 
+void diffNameSpace(COPCServer &opcServer, const char *fileName)
+{
+    COPCNameSpaceSnapshot previous;
+    bool known = previous.load(fileName);
+
+    COPCNameSpaceSnapshot current;
+    if (!current.capture(opcServer))
+    {
+        printf("FAILED to browse the namespace\n");
+        return;
+    } // if
+
+    if (known)
+    {
+        NameSpaceDiff diff;
+        COPCNameSpaceSnapshot::diff(previous, current, diff);
+        for (const NameSpaceItem &item : diff.added)
+        {
+            printf("+ %ws\n", item.itemId.c_str());
+        }
+        for (const NameSpaceItem &item : diff.removed)
+        {
+            printf("- %ws\n", item.itemId.c_str());
+        }
+        for (const NameSpaceTypeChange &change : diff.typeChanged)
+        {
+            printf("~ %ws (type %d -> %d)\n", change.itemId.c_str(), change.oldType, change.newType);
+        }
+        printf("%d items added, %d removed, %d changed type, %d in unchanged branches\n",
+               static_cast<int>(diff.added.size()), static_cast<int>(diff.removed.size()),
+               static_cast<int>(diff.typeChanged.size()), static_cast<int>(diff.skipped));
+    } // if
+
+    if (!current.save(fileName))
+    {
+        printf("FAILED to write %s\n", fileName);
+        return;
+    } // if
+
+    printf("wrote snapshot of %d items to %s\n", static_cast<int>(current.size()), fileName);
+
+} // diffNameSpace
+
 void runRefreshTest(COPCServer &opcServer, const char *fileName, unsigned nbrRefreshs)
 {
     std::vector<std::wstring> itemNames;
@@ -187,6 +241,9 @@ int main(int argc, char *argv[])
              << endl;
         cout << "To store the namespace in the supplied file use\nOPCPerformance.exe <OPCItemList> <Host> <OPCServer>"
              << endl;
+        cout << "To compare the namespace with the snapshot in the supplied file and update it use\nOPCPerformance.exe "
+                "<Snapshot> <Host> <OPCServer> diff"
+             << endl;
         return 1;
     } // if
 
@@ -201,7 +258,11 @@ int main(int argc, char *argv[])
 
     if (saveNameSpace)
     {
-        recordNameSpace(*opcServer, argv[1]);
+        recordNameSpace(*host, COPCHost::LPCSTR2WS(argv[3]), argv[1]);
+    }
+    else if (strcmp(argv[4], "diff") == 0)
+    {
+        diffNameSpace(*opcServer, argv[1]);
     }
     else
     {